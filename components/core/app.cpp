@@ -14,17 +14,6 @@
 
 static const char* TAG = "CoreApp";
 
-// --- Вбудовування default_config.json ---
-// Припускаємо, що файл config/default_config.json існує
-// і в головному CMakeLists.txt проєкту додано:
-// idf_component_get_property(main_comp main SRCS)
-// target_add_binary_data(${main_comp} "config/default_config.json" TEXT)
-//
-// Це створить символи _binary_config_default_config_json_start та _binary_config_default_config_json_end
-extern const char default_config_json_start[] asm("_binary_config_default_config_json_start");
-// extern const char default_config_json_end[]   asm("_binary_config_default_config_json_end");
-// Кінець не потрібен, бо рядок null-terminated при вбудовуванні як TEXT
-
 namespace CoreApp {
 
 esp_err_t init() {
@@ -66,15 +55,15 @@ esp_err_t init() {
     }
 
     ESP_LOGI(TAG, "Ініціалізація ConfigLoader...");
-    // Передаємо вбудований JSON як рядок C-style
-    err = ConfigLoader::init(default_config_json_start);
+    // Дефолти вкомпільовано (config_defaults.h), з файлу читаються лише зміни користувача
+    err = ConfigLoader::init();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Помилка ініціалізації ConfigLoader: %s", esp_err_to_name(err));
         return err; // Критично, якщо конфігурація потрібна далі
     }
 
     ESP_LOGI(TAG, "Ініціалізація EventBus...");
-    err = EventBus::init(); // Використовуємо дефолтні розміри черги/стеку
+    err = EventBus::init(); // Дефолтна конфігурація смуг (черги, пріоритети, ядра)
      if (err != ESP_OK) {
         ESP_LOGE(TAG, "Помилка ініціалізації EventBus: %s", esp_err_to_name(err));
         return err;
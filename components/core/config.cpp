@@ -1,21 +1,135 @@
 #include "config.h"
+#include "config_codec.h"
+#include "config_defaults.h" // Генерується з default_config.json під час збірки
 #include "esp_log.h"
+#include "cJSON_Utils.h"
 #include <stdio.h>
 #include <string.h>
 #include "esp_vfs.h"
 #include "esp_littlefs.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <mutex>
+#include <unistd.h>
 
 // Визначення статичних членів класу
 const char* ConfigLoader::TAG = "ConfigLoader";
-cJSON* ConfigLoader::config_json_root = nullptr;
 SemaphoreHandle_t ConfigLoader::config_mutex_handle = nullptr;
 
-#define USER_CONFIG_PATH "/littlefs/user_config.json"
+// Каталог користувацької конфігурації; хост-тести підставляють свій
+#ifndef USER_CONFIG_DIR
+#define USER_CONFIG_DIR "/littlefs"
+#endif
+#define USER_CONFIG_PATH USER_CONFIG_DIR "/user_config.bin"
+#define USER_CONFIG_TMP_PATH USER_CONFIG_DIR "/user_config.bin.tmp"
+// Попередній текстовий формат: читається, якщо бінарного файлу ще немає
+#define USER_CONFIG_JSON_PATH USER_CONFIG_DIR "/user_config.json"
+
+namespace {
+    // Максимальна довжина одного сегмента шляху ("set_temp" тощо)
+    constexpr size_t PATH_SEGMENT_MAX = 48;
+
+    // Зареєстровані шляхи; хендл ConfigPath - позиція у векторі, записи не видаляються.
+    // Змінюється лише під м'ютексом писачів
+    std::vector<std::string> registered_paths;
+
+    // Поточний знімок (RCU): читачі беруть посилання, писачі заміняють атомарно
+    std::shared_ptr<const ConfigSnapshot> current_snapshot;
+    std::atomic<uint32_t> snapshot_version{0};
+    // Версія знімка, останньою записана у файл (під flush_mutex)
+    uint32_t flushed_version = 0;
+
+    std::shared_ptr<cJSON> make_tree(cJSON* root) {
+        return std::shared_ptr<cJSON>(root, [](cJSON* node) { cJSON_Delete(node); });
+    }
+    // Серіалізує flush(): старіший знімок не може перезаписати новіший
+    SemaphoreHandle_t flush_mutex_handle = nullptr;
+    TaskHandle_t flush_task_handle = nullptr;
+
+    struct ConfigSubscriber {
+        ConfigSubscriptionHandle handle = 0;
+        std::string prefix;
+        ConfigCallback callback;
+        // Тримається на час виклику callback; unsubscribe() чекає на нього й
+        // скидає active. Рекурсивний: callback може відписатися сам
+        std::recursive_mutex call_mutex;
+        bool active = true;
+    };
+    std::vector<std::shared_ptr<ConfigSubscriber>> subscribers;
+    std::mutex subs_mutex;
+    ConfigSubscriptionHandle next_subscription = 1;
+
+    // Доставка змін послідовна: в кожен момент її веде один потік, який
+    // порівнює останній доставлений знімок з останнім опублікованим. Писач, що
+    // застав доставку, лише залишає їй новий знімок - старіша різниця ніколи
+    // не прийде після новішої. Обидва поля - під notify_mutex.
+    std::mutex notify_mutex;
+    ConfigSnapshotPtr delivered_snapshot;
+    bool notify_active = false;
+
+    // Змінене піддерево: шлях і нове значення (nullptr - видалено)
+    struct ConfigChange {
+        std::string path;
+        const cJSON* value;
+    };
+
+    // Різниця двох дерев: об'єкти порівнюються по ключах, решта - цілком
+    void diff_trees(const cJSON* before, const cJSON* after, std::string& path, std::vector<ConfigChange>& out) {
+        if (cJSON_IsObject(before) && cJSON_IsObject(after)) {
+            for (const cJSON* child = after->child; child; child = child->next) {
+                size_t len = path.size();
+                path += '/';
+                path += child->string;
+                diff_trees(cJSON_GetObjectItemCaseSensitive(before, child->string), child, path, out);
+                path.resize(len);
+            }
+            for (const cJSON* child = before->child; child; child = child->next) {
+                if (!cJSON_GetObjectItemCaseSensitive(after, child->string)) {
+                    out.push_back({path + '/' + child->string, nullptr});
+                }
+            }
+            return;
+        }
+        if (!before || !after || !cJSON_Compare(before, after, true)) {
+            out.push_back({path.empty() ? "/" : path, after});
+        }
+    }
+
+    // prefix охоплює path: "/control" охоплює "/control/set_temp", але не "/controls"
+    bool path_covers(const std::string& prefix, const std::string& path) {
+        if (prefix == "/") {
+            return true;
+        }
+        return path.compare(0, prefix.size(), prefix) == 0 &&
+               (path.size() == prefix.size() || path[prefix.size()] == '/');
+    }
+
+    // Файл попереднього формату видаляється після першого бінарного запису
+    bool legacy_json_present = false;
+    // Збережено повне дерево (JSON або бінарний формат v1), а не лише зміни -
+    // після завантаження файл переписується як merge patch
+    bool stored_full_tree = false;
+
+    // Останнє завантаження (init/reload): тривалість і пікове використання купи
+    std::atomic<uint32_t> stat_load_time_us{0};
+    std::atomic<uint32_t> stat_load_heap_peak{0};
+    std::atomic<bool> stat_load_binary{false};
+
+    std::atomic<uint32_t> stat_writes{0};
+    std::atomic<uint32_t> stat_flushes{0};
+    std::atomic<uint32_t> stat_bytes_written{0};
+    std::atomic<uint32_t> stat_errors{0};
+    std::atomic<uint32_t> stat_lock_hold_max_us{0};
+    std::atomic<uint64_t> stat_lock_hold_total_us{0};
+    std::atomic<uint32_t> stat_lock_holds{0};
+}
 
 
 // --- Реалізація статичних методів ---
 
-esp_err_t ConfigLoader::init(const char* default_config_json_str) {
+esp_err_t ConfigLoader::init() {
     if (config_mutex_handle == nullptr) {
         config_mutex_handle = xSemaphoreCreateMutex();
         if (config_mutex_handle == nullptr) {
@@ -23,43 +137,160 @@ esp_err_t ConfigLoader::init(const char* default_config_json_str) {
             return ESP_FAIL;
         }
     }
+    if (flush_mutex_handle == nullptr) {
+        flush_mutex_handle = xSemaphoreCreateMutex();
+        if (flush_mutex_handle == nullptr) {
+            ESP_LOGE(TAG, "Не вдалося створити м'ютекс збереження!");
+            return ESP_FAIL;
+        }
+    }
+    if (flush_task_handle == nullptr &&
+        xTaskCreate(flush_task, "config_flush", FLUSH_TASK_STACK_SIZE, nullptr,
+                    FLUSH_TASK_PRIORITY, &flush_task_handle) != pdPASS) {
+        // Без задачі зміни пишуться синхронно в кінці кожного Edit
+        ESP_LOGW(TAG, "Не вдалося створити задачу збереження конфігурації");
+        flush_task_handle = nullptr;
+    }
 
-    if (xSemaphoreTake(config_mutex_handle, portMAX_DELAY) != pdTRUE) {
-         ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для init!");
-         return ESP_FAIL;
+    // Шляхи таблиці дефолтів займають перші позиції індексу: ConfigField::index
+    // згенеровано як позицію в ENTRIES і використовується як ConfigPath
+    if (xSemaphoreTake(config_mutex_handle, portMAX_DELAY) == pdTRUE) {
+        if (registered_paths.empty()) {
+            registered_paths.reserve(sizeof(config_defaults::ENTRIES) / sizeof(config_defaults::ENTRIES[0]));
+            for (const auto& entry : config_defaults::ENTRIES) {
+                registered_paths.push_back(entry.path);
+            }
+        }
+        xSemaphoreGive(config_mutex_handle);
     }
 
     ESP_LOGI(TAG, "Ініціалізація конфігурації...");
+    esp_err_t err = reload();
+    if (err != ESP_OK) {
+        return err;
+    }
 
-    // Спочатку видаляємо стару конфігурацію, якщо вона є
-    if (config_json_root) {
-        cJSON_Delete(config_json_root);
-        config_json_root = nullptr;
+    ESP_LOGI(TAG, "ConfigLoader ініціалізовано успішно.");
+    return ESP_OK;
+}
+
+esp_err_t ConfigLoader::reload() {
+    if (config_mutex_handle == nullptr || flush_mutex_handle == nullptr) {
+        ESP_LOGE(TAG, "ConfigLoader не ініціалізовано для reload");
+        return ESP_ERR_INVALID_STATE;
+    }
+    // flush_mutex - першим: запис старішого знімка не має перезаписати щойно прочитаний файл
+    if (xSemaphoreTake(flush_mutex_handle, portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс збереження для reload!");
+        return ESP_FAIL;
+    }
+    if (xSemaphoreTake(config_mutex_handle, portMAX_DELAY) != pdTRUE) {
+        xSemaphoreGive(flush_mutex_handle);
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для reload!");
+        return ESP_FAIL;
     }
 
-    // 1. Парсимо дефолтну конфігурацію
-    cJSON* default_json = nullptr;
-    if (default_config_json_str && strlen(default_config_json_str) > 0) {
-        default_json = cJSON_Parse(default_config_json_str);
-        if (!default_json) {
-            ESP_LOGE(TAG, "Помилка парсингу default_config_json: %s", cJSON_GetErrorPtr());
-             xSemaphoreGive(config_mutex_handle);
-            return ESP_FAIL;
+    // Мінімум вільної купи - локальний, з цього моменту: різниця дає пік завантаження
+    int64_t load_started_us = esp_timer_get_time();
+    size_t free_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    heap_caps_monitor_local_minimum_free_size_start();
+    cJSON* merged = load_merged_tree();
+    size_t free_min = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+    heap_caps_monitor_local_minimum_free_size_stop();
+    stat_load_time_us.store(static_cast<uint32_t>(esp_timer_get_time() - load_started_us), std::memory_order_relaxed);
+    stat_load_heap_peak.store(free_before > free_min ? free_before - free_min : 0, std::memory_order_relaxed);
+    ESP_LOGI(TAG, "Конфігурацію завантажено за %u мкс, пік купи %u байт",
+             (unsigned)stat_load_time_us.load(), (unsigned)stat_load_heap_peak.load());
+
+    if (!merged) {
+        xSemaphoreGive(config_mutex_handle);
+        xSemaphoreGive(flush_mutex_handle);
+        return ESP_FAIL;
+    }
+    // Попередній знімок звільниться з останнім читачем. Прочитаний з файлу
+    // стан вважаємо вже збереженим; незбережені зміни відкидаються.
+    // Повне дерево попереднього формату переписуємо як merge patch
+    uint32_t version = snapshot_version.fetch_add(1, std::memory_order_relaxed) + 1;
+    publish_snapshot(make_tree(merged), version);
+    bool rewrite = stored_full_tree;
+    flushed_version = rewrite ? 0 : version;
+
+    xSemaphoreGive(config_mutex_handle);
+    xSemaphoreGive(flush_mutex_handle);
+
+    if (rewrite) {
+        schedule_flush();
+    }
+    notify_changes();
+    return ESP_OK;
+}
+
+cJSON* ConfigLoader::load_defaults() {
+    // Дефолти - зі згенерованої constexpr-таблиці: без розбору JSON, рядки
+    // не копіюються (посилання на дані у flash)
+    cJSON* root = cJSON_CreateObject();
+    if (!root) {
+        ESP_LOGE(TAG, "Не вдалося створити дерево дефолтів");
+        return nullptr;
+    }
+    const char* base = reinterpret_cast<const char*>(&config_defaults::DEFAULTS);
+    for (const auto& entry : config_defaults::ENTRIES) {
+        const char* field = base + entry.offset;
+        cJSON* item = nullptr;
+        switch (entry.type) {
+            case ConfigValueType::BOOL:
+                item = cJSON_CreateBool(*reinterpret_cast<const bool*>(field));
+                break;
+            case ConfigValueType::INT:
+                item = cJSON_CreateNumber(*reinterpret_cast<const int*>(field));
+                break;
+            case ConfigValueType::FLOAT:
+                item = cJSON_CreateNumber(*reinterpret_cast<const float*>(field));
+                break;
+            case ConfigValueType::STRING:
+                item = cJSON_CreateStringReference(*reinterpret_cast<const char* const*>(field));
+                break;
+        }
+        if (!apply_set(root, entry.path, item)) {
+            ESP_LOGE(TAG, "Не вдалося додати дефолт %s", entry.path);
+            cJSON_Delete(root);
+            return nullptr;
         }
-    } else {
-        ESP_LOGI(TAG, "Дефолтна конфігурація не надана, створюємо порожній об'єкт.");
-        default_json = cJSON_CreateObject(); // Створюємо порожній об'єкт, якщо дефолтної немає
     }
-     if (!cJSON_IsObject(default_json)) {
-         ESP_LOGE(TAG, "Дефолтна конфігурація не є JSON об'єктом!");
-         cJSON_Delete(default_json);
-         xSemaphoreGive(config_mutex_handle);
-         return ESP_FAIL;
-     }
+    return root;
+}
 
+cJSON* ConfigLoader::load_merged_tree() {
+    // 1. Дефолтна конфігурація
+    cJSON* default_json = load_defaults();
+    if (!default_json) {
+        return nullptr;
+    }
 
-     // 2. Читаємо користувацьку конфігурацію з файлу
-    char* user_config_str = read_file_to_string(USER_CONFIG_PATH); // Використовуємо приватний статичний метод
+    // 2. Бінарний файл накладається прямо на дефолти - без розбору тексту і проміжного дерева
+    size_t user_config_size = 0;
+    char* user_config_data = read_file_to_string(USER_CONFIG_PATH, &user_config_size);
+    if (user_config_data) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(user_config_data);
+        bool decoded = config_codec::decode_merge(data, user_config_size, default_json);
+        stored_full_tree = decoded && config_codec::format_version(data, user_config_size) < 2;
+        free(user_config_data);
+        stat_load_binary.store(decoded, std::memory_order_relaxed);
+        if (decoded) {
+            ESP_LOGI(TAG, "Зчитано %s (%u байт)", USER_CONFIG_PATH, (unsigned)user_config_size);
+            return default_json;
+        }
+        // Дефолти могли бути змінені частково - розбираємо їх заново
+        ESP_LOGW(TAG, "Пошкоджений %s. Буде використана дефолтна.", USER_CONFIG_PATH);
+        cJSON_Delete(default_json);
+        return load_defaults();
+    }
+    stat_load_binary.store(false, std::memory_order_relaxed);
+
+    // 3. Інакше - JSON попереднього формату (імпорт; наступний запис буде бінарним)
+    char* user_config_str = read_file_to_string(USER_CONFIG_JSON_PATH);
+    legacy_json_present = user_config_str != nullptr;
+    stored_full_tree = legacy_json_present;
     cJSON* user_json = nullptr;
     if (user_config_str) {
         user_json = cJSON_Parse(user_config_str);
@@ -75,86 +306,384 @@ esp_err_t ConfigLoader::init(const char* default_config_json_str) {
         }
     }
 
-    // 3. Мерджимо конфігурації (якщо є валідна користувацька)
+    // 4. Мерджимо конфігурації (якщо є валідна користувацька)
     if (user_json) {
         ESP_LOGI(TAG, "Мерджимо користувацьку конфігурацію поверх дефолтної...");
-        // cJSON_MergePatch перезаписує default_json!
-        if (!cJSON_MergePatch(default_json, user_json)) {
+        // cJSONUtils_MergePatch змінює default_json на місці і повертає його
+        cJSON* merged = cJSONUtils_MergePatch(default_json, user_json);
+        if (!merged) {
              ESP_LOGE(TAG, "Помилка злиття конфігурацій!");
              // Продовжуємо з тим, що є в default_json
+        } else {
+             default_json = merged;
         }
         cJSON_Delete(user_json); // Видаляємо тимчасовий об'єкт
-        set_config_root(default_json); // Тепер default_json містить змерджену версію
-    } else {
-        // Якщо користувацького JSON немає або він невалідний, просто використовуємо дефолтний
-        set_config_root(default_json);
+        // Тепер default_json містить змерджену версію
     }
+    return default_json;
+}
 
-    xSemaphoreGive(config_mutex_handle);
+ConfigSubscriptionHandle ConfigLoader::subscribe(const char* path_prefix, ConfigCallback callback) {
+    if (!path_prefix || path_prefix[0] != '/' || !callback) {
+        ESP_LOGE(TAG, "Некоректна підписка на %s", path_prefix ? path_prefix : "NULL");
+        return 0;
+    }
+    auto sub = std::make_shared<ConfigSubscriber>();
+    sub->prefix = path_prefix;
+    // "/control/" і "/control" - той самий префікс
+    while (sub->prefix.size() > 1 && sub->prefix.back() == '/') {
+        sub->prefix.pop_back();
+    }
+    sub->callback = std::move(callback);
 
-    if (!config_json_root) {
-        ESP_LOGE(TAG, "Фінальна конфігурація порожня після ініціалізації!");
-        return ESP_FAIL;
+    std::lock_guard<std::mutex> lock(subs_mutex);
+    sub->handle = next_subscription++;
+    subscribers.push_back(sub);
+    ESP_LOGD(TAG, "Підписка #%u на зміни %s", (unsigned)sub->handle, sub->prefix.c_str());
+    return sub->handle;
+}
+
+void ConfigLoader::unsubscribe(ConfigSubscriptionHandle handle) {
+    std::shared_ptr<ConfigSubscriber> removed;
+    {
+        std::lock_guard<std::mutex> lock(subs_mutex);
+        for (auto it = subscribers.begin(); it != subscribers.end(); ++it) {
+            if ((*it)->handle == handle) {
+                removed = *it;
+                subscribers.erase(it);
+                break;
+            }
+        }
+    }
+    if (!removed) {
+        return;
+    }
+    // Доставка могла вже скопіювати список: чекаємо поточний виклик і
+    // забороняємо наступні - після повернення callback більше не виконується
+    std::lock_guard<std::recursive_mutex> call_lock(removed->call_mutex);
+    removed->active = false;
+}
+
+void ConfigLoader::notify_changes() {
+    {
+        std::lock_guard<std::mutex> lock(notify_mutex);
+        if (notify_active) {
+            return; // Активна доставка дійде і до нашого знімка
+        }
+        notify_active = true;
     }
 
-    ESP_LOGI(TAG, "ConfigLoader ініціалізовано успішно.");
-    return ESP_OK;
+    while (true) {
+        ConfigSnapshotPtr previous;
+        ConfigSnapshotPtr current;
+        {
+            // Знімок читаємо під notify_mutex: писач, що опублікував новіший після
+            // цієї перевірки, застане notify_active == false і доставить його сам
+            std::lock_guard<std::mutex> lock(notify_mutex);
+            current = snapshot();
+            if (!current || (delivered_snapshot && delivered_snapshot->version_ == current->version_)) {
+                notify_active = false;
+                return;
+            }
+            previous = std::move(delivered_snapshot);
+            delivered_snapshot = current;
+        }
+
+        std::vector<std::shared_ptr<ConfigSubscriber>> subs;
+        {
+            std::lock_guard<std::mutex> lock(subs_mutex);
+            subs = subscribers;
+        }
+        if (subs.empty()) {
+            continue;
+        }
+
+        std::vector<ConfigChange> changes;
+        std::string path;
+        diff_trees(previous ? previous->tree_.get() : nullptr, current->tree_.get(), path, changes);
+
+        // Вузли належать current, який живе до кінця доставки. set() з callback
+        // лише публікує знімок - його зміни прийдуть наступним проходом циклу
+        for (const auto& sub : subs) {
+            std::lock_guard<std::recursive_mutex> call_lock(sub->call_mutex);
+            for (const auto& change : changes) {
+                if (!sub->active) {
+                    break; // Відписався (можливо, з власного callback)
+                }
+                if (path_covers(sub->prefix, change.path)) {
+                    sub->callback(change.path.c_str(), change.value);
+                } else if (path_covers(change.path, sub->prefix)) {
+                    // Замінено предка префікса цілком - віддаємо піддерево підписника
+                    sub->callback(sub->prefix.c_str(), find_node(current->tree_.get(), sub->prefix.c_str()));
+                }
+            }
+        }
+    }
+}
+
+ConfigPath ConfigLoader::path(const char* path) {
+    ConfigPath handle;
+    if (!path || path[0] != '/') {
+        ESP_LOGE(TAG, "Некоректний шлях для path(): %s", path ? path : "NULL");
+        return handle;
+    }
+    if (config_mutex_handle == nullptr || xSemaphoreTake(config_mutex_handle, portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для path(%s)", path);
+        return handle;
+    }
+
+    // Реєстрація рідкісна (раз на шлях), тож лінійного пошуку досить
+    for (size_t i = 0; i < registered_paths.size(); ++i) {
+        if (registered_paths[i] == path) {
+            handle.index = static_cast<uint16_t>(i);
+            break;
+        }
+    }
+    if (!handle.valid() && registered_paths.size() < ConfigPath::INVALID) {
+        handle.index = static_cast<uint16_t>(registered_paths.size());
+        registered_paths.push_back(path);
+        // Той самий стан, але з розширеним індексом - версія не змінюється
+        ConfigSnapshotPtr current = snapshot();
+        if (current) {
+            publish_snapshot(current->tree_, current->version_);
+        }
+    }
+
+    xSemaphoreGive(config_mutex_handle);
+    return handle;
+}
+
+ConfigSnapshotPtr ConfigLoader::snapshot() {
+    return std::atomic_load(&current_snapshot);
 }
 
 cJSON* ConfigLoader::getConfigJson() {
-    // М'ютекс береться всередині get_mutex(), якщо реалізовано так,
-    // але для безпеки краще брати його явно тут.
-    if (xSemaphoreTake(config_mutex_handle, portMAX_DELAY) != pdTRUE) return nullptr;
-    cJSON* root = get_config_root();
-    cJSON* duplicate = nullptr;
-    if (root) {
-         duplicate = cJSON_Duplicate(root, true /* recurse */);
+    ConfigSnapshotPtr current = snapshot();
+    if (!current) return nullptr;
+    return cJSON_Duplicate(current->tree_.get(), true /* recurse */); // Викликаюча сторона має викликати cJSON_Delete()
+}
+
+
+// --- Пакетна зміна і збереження ---
+
+ConfigLoader::Edit::Edit() {
+    if (config_mutex_handle == nullptr || xSemaphoreTake(config_mutex_handle, portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для Edit");
+        ok_ = false;
+        return;
+    }
+    locked_ = true;
+    locked_at_us_ = esp_timer_get_time();
+}
+
+ConfigLoader::Edit::~Edit() {
+    if (!locked_) {
+        return;
+    }
+    if (changes_ > 0) {
+        // Новий знімок з новим індексом; старий живе, доки його тримають читачі
+        uint32_t version = snapshot_version.fetch_add(1, std::memory_order_relaxed) + 1;
+        publish_snapshot(make_tree(tree_), version);
+        stat_writes.fetch_add(changes_, std::memory_order_relaxed);
+    } else if (tree_) {
+        cJSON_Delete(tree_);
     }
+    record_lock_hold(locked_at_us_);
     xSemaphoreGive(config_mutex_handle);
-    return duplicate; // Викликаюча сторона має викликати cJSON_Delete()
+
+    if (changes_ > 0) {
+        schedule_flush();
+        // Підписники - поза м'ютексом: callback може сам викликати set()
+        notify_changes();
+    }
 }
 
+cJSON* ConfigLoader::Edit::working_tree() {
+    if (!tree_) {
+        ConfigSnapshotPtr current = snapshot();
+        if (current) {
+            tree_ = cJSON_Duplicate(current->tree_.get(), true /* recurse */);
+        }
+    }
+    return tree_;
+}
 
-// --- Реалізація приватних статичних допоміжних методів ---
+bool ConfigLoader::apply_set(cJSON* root_node, const char* path, cJSON* new_item) {
+    // Викликається з Edit::set над копією дерева (м'ютекс писачів захоплено) і з load_defaults
+    if (!new_item) {
+        ESP_LOGE(TAG, "Не вдалося створити cJSON елемент для %s", path ? path : "NULL");
+        return false;
+    }
+    std::vector<std::string> parts = split_path(path);
+    if (parts.empty() || !root_node) {
+        ESP_LOGE(TAG, "Некоректний шлях або конфігурація не ініціалізована для %s", path ? path : "NULL");
+        cJSON_Delete(new_item);
+        return false;
+    }
 
-esp_err_t ConfigLoader::save_config_to_file() {
-    // Примітка: цей метод викликається з set<T>, де м'ютекс вже захоплено
-    cJSON* root = get_config_root();
-    if (!root) {
-        ESP_LOGE(TAG, "Конфігурація не ініціалізована для збереження.");
-        return ESP_FAIL;
+    std::string leaf_name = parts.back();
+    parts.pop_back(); // Шлях до батьківського вузла
+
+    cJSON* parent = parts.empty() ? root_node : find_or_create_node_by_path(root_node, parts);
+    if (!parent || !cJSON_IsObject(parent)) {
+        ESP_LOGE(TAG, "Не вдалося знайти/створити батьківський вузол для %s", path);
+        cJSON_Delete(new_item);
+        return false;
     }
 
-    char* json_str = cJSON_PrintUnformatted(root);
-    if (!json_str) {
-        ESP_LOGE(TAG, "Помилка серіалізації JSON.");
-        return ESP_FAIL;
+    if (cJSON_HasObjectItem(parent, leaf_name.c_str())) {
+        cJSON_ReplaceItemInObjectCaseSensitive(parent, leaf_name.c_str(), new_item);
+    } else {
+        cJSON_AddItemToObject(parent, leaf_name.c_str(), new_item);
+    }
+    return true;
+}
+
+esp_err_t ConfigLoader::flush() {
+    if (flush_mutex_handle == nullptr || xSemaphoreTake(flush_mutex_handle, portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс збереження");
+        return ESP_ERR_TIMEOUT;
+    }
+    // Знімок незмінний: серіалізація і запис у LittleFS - без м'ютекса конфігурації
+    ConfigSnapshotPtr current = snapshot();
+    if (!current || current->version_ == flushed_version) {
+        xSemaphoreGive(flush_mutex_handle);
+        return ESP_OK;
     }
 
-    FILE* f = fopen(USER_CONFIG_PATH, "w");
+    // Зберігаємо лише відмінності від вкомпільованих дефолтів: запис - кілька
+    // байтів замість усього дерева, а нові дефолти прошивки набувають чинності
+    esp_err_t err = ESP_FAIL;
+    std::vector<uint8_t> encoded;
+    cJSON* defaults = load_defaults();
+    cJSON* patch = defaults ? config_codec::make_merge_patch(defaults, current->tree_.get()) : nullptr;
+    if (defaults && !patch) {
+        patch = cJSON_CreateObject(); // Збігається з дефолтами - порожній патч
+    }
+    cJSON_Delete(defaults);
+    bool encoded_ok = patch && config_codec::encode(patch, encoded);
+    cJSON_Delete(patch);
+    if (encoded_ok) {
+        err = write_file_atomic(USER_CONFIG_PATH, encoded.data(), encoded.size());
+        if (err == ESP_OK) {
+            flushed_version = current->version_;
+            stat_flushes.fetch_add(1, std::memory_order_relaxed);
+            stat_bytes_written.fetch_add(encoded.size(), std::memory_order_relaxed);
+            ESP_LOGD(TAG, "Конфігурацію збережено у %s (%u байт)", USER_CONFIG_PATH, (unsigned)encoded.size());
+            stored_full_tree = false;
+            if (legacy_json_present) {
+                unlink(USER_CONFIG_JSON_PATH); // Замінено бінарним файлом
+                legacy_json_present = false;
+            }
+        }
+    } else {
+        ESP_LOGE(TAG, "Помилка кодування конфігурації.");
+    }
+
+    if (err != ESP_OK) {
+        // Зміни не втрачено: версія не збережена, наступна спроба запише їх знову
+        stat_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    xSemaphoreGive(flush_mutex_handle);
+    return err;
+}
+
+ConfigPersistStats ConfigLoader::get_persist_stats() {
+    ConfigPersistStats stats;
+    stats.writes = stat_writes.load(std::memory_order_relaxed);
+    stats.flushes = stat_flushes.load(std::memory_order_relaxed);
+    stats.bytes_written = stat_bytes_written.load(std::memory_order_relaxed);
+    stats.errors = stat_errors.load(std::memory_order_relaxed);
+    stats.lock_hold_max_us = stat_lock_hold_max_us.load(std::memory_order_relaxed);
+    stats.lock_hold_total_us = stat_lock_hold_total_us.load(std::memory_order_relaxed);
+    stats.lock_holds = stat_lock_holds.load(std::memory_order_relaxed);
+    stats.load_time_us = stat_load_time_us.load(std::memory_order_relaxed);
+    stats.load_heap_peak = stat_load_heap_peak.load(std::memory_order_relaxed);
+    stats.load_binary = stat_load_binary.load(std::memory_order_relaxed);
+    return stats;
+}
+
+cJSON* ConfigLoader::stats_to_json() {
+    ConfigPersistStats stats = get_persist_stats();
+    cJSON* root = cJSON_CreateObject();
+    if (!root) return nullptr;
+
+    cJSON_AddNumberToObject(root, "writes", stats.writes);
+    cJSON_AddNumberToObject(root, "flushes", stats.flushes);
+    cJSON_AddNumberToObject(root, "bytesWritten", stats.bytes_written);
+    cJSON_AddNumberToObject(root, "errors", stats.errors);
+    // Write amplification: байт у файл на одну логічну зміну
+    cJSON_AddNumberToObject(root, "bytesPerWrite",
+                            stats.writes ? (double)stats.bytes_written / stats.writes : 0.0);
+    cJSON_AddNumberToObject(root, "lockHoldMaxUs", stats.lock_hold_max_us);
+    cJSON_AddNumberToObject(root, "lockHoldAvgUs",
+                            stats.lock_holds ? (double)stats.lock_hold_total_us / stats.lock_holds : 0.0);
+    cJSON_AddNumberToObject(root, "loadTimeUs", stats.load_time_us);
+    cJSON_AddNumberToObject(root, "loadHeapPeak", stats.load_heap_peak);
+    cJSON_AddStringToObject(root, "loadFormat", stats.load_binary ? "binary" : "json");
+    return root;
+}
+
+void ConfigLoader::flush_task(void* /*arg*/) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // Debounce: чекаємо паузи між змінами, але не довше FLUSH_MAX_DELAY_MS
+        int64_t first_change_us = esp_timer_get_time();
+        while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FLUSH_DEBOUNCE_MS)) > 0 &&
+               esp_timer_get_time() - first_change_us < static_cast<int64_t>(FLUSH_MAX_DELAY_MS) * 1000) {
+        }
+        flush();
+    }
+}
+
+void ConfigLoader::schedule_flush() {
+    if (flush_task_handle) {
+        xTaskNotifyGive(flush_task_handle);
+    } else {
+        flush();
+    }
+}
+
+void ConfigLoader::record_lock_hold(int64_t locked_at_us) {
+    uint32_t held_us = static_cast<uint32_t>(esp_timer_get_time() - locked_at_us);
+    stat_lock_hold_total_us.fetch_add(held_us, std::memory_order_relaxed);
+    stat_lock_holds.fetch_add(1, std::memory_order_relaxed);
+    uint32_t max_us = stat_lock_hold_max_us.load(std::memory_order_relaxed);
+    while (held_us > max_us &&
+           !stat_lock_hold_max_us.compare_exchange_weak(max_us, held_us, std::memory_order_relaxed)) {
+    }
+}
+
+// --- Реалізація приватних статичних допоміжних методів ---
+
+esp_err_t ConfigLoader::write_file_atomic(const char* path, const uint8_t* data, size_t len) {
+    // Пишемо поруч і перейменовуємо: збій живлення лишає або старий, або новий файл
+    FILE* f = fopen(USER_CONFIG_TMP_PATH, "wb");
     if (f == nullptr) {
-        ESP_LOGE(TAG, "Не вдалося відкрити %s для запису", USER_CONFIG_PATH);
-        cJSON_free(json_str);
+        ESP_LOGE(TAG, "Не вдалося відкрити %s для запису", USER_CONFIG_TMP_PATH);
         return ESP_FAIL;
     }
 
-    ESP_LOGD(TAG, "Збереження конфігурації у %s", USER_CONFIG_PATH); // Змінено на Debug рівень
-    size_t len = strlen(json_str);
-    size_t written = fwrite(json_str, 1, len, f);
+    size_t written = fwrite(data, 1, len, f);
+    bool synced = fflush(f) == 0 && fsync(fileno(f)) == 0;
     fclose(f);
-    cJSON_free(json_str);
 
-    if (written != len) {
-         ESP_LOGE(TAG, "Помилка запису у файл конфігурації (записано %d з %d)", written, len);
-         return ESP_FAIL;
+    if (written != len || !synced) {
+        ESP_LOGE(TAG, "Помилка запису у файл конфігурації (записано %u з %u)", (unsigned)written, (unsigned)len);
+        unlink(USER_CONFIG_TMP_PATH);
+        return ESP_FAIL;
+    }
+    if (rename(USER_CONFIG_TMP_PATH, path) != 0) {
+        ESP_LOGE(TAG, "Не вдалося перейменувати %s у %s", USER_CONFIG_TMP_PATH, path);
+        unlink(USER_CONFIG_TMP_PATH);
+        return ESP_FAIL;
     }
-
     return ESP_OK;
 }
 
-char* ConfigLoader::read_file_to_string(const char* path) {
-    // Цей метод може викликатись лише з init, де м'ютекс вже захоплено
-    FILE* f = fopen(path, "r");
+char* ConfigLoader::read_file_to_string(const char* path, size_t* out_size) {
+    // Цей метод може викликатись лише з init/reload, де м'ютекс вже захоплено
+    FILE* f = fopen(path, "rb");
     if (f == nullptr) {
         ESP_LOGI(TAG, "Файл %s не знайдено.", path);
         return nullptr;
@@ -188,17 +717,20 @@ char* ConfigLoader::read_file_to_string(const char* path) {
     fclose(f);
 
     if(bytes_read != (size_t)size){
-        ESP_LOGE(TAG, "Помилка читання файлу %s (прочитано %d з %ld)", path, bytes_read, size);
+        ESP_LOGE(TAG, "Помилка читання файлу %s (прочитано %u з %ld)", path, (unsigned)bytes_read, size);
         free(buffer);
         return nullptr;
     }
 
     buffer[size] = '\0'; // Null-terminate
+    if (out_size) {
+        *out_size = static_cast<size_t>(size);
+    }
     return buffer;
 }
 
 std::vector<std::string> ConfigLoader::split_path(const char* path) {
-    // Може викликатись з get/set, де м'ютекс захоплено
+    // Може викликатись з Edit::set, де м'ютекс писачів захоплено
     std::vector<std::string> parts;
     if (!path || path[0] != '/') return parts; // Повинен починатися з '/'
     if (strlen(path) == 1) return parts; // Тільки "/"
@@ -213,7 +745,7 @@ std::vector<std::string> ConfigLoader::split_path(const char* path) {
 }
 
 cJSON* ConfigLoader::find_or_create_node_by_path(cJSON* root, const std::vector<std::string>& parts) {
-     // Може викликатись з set, де м'ютекс захоплено
+     // Може викликатись з Edit::set над копією дерева
     cJSON* current = root;
     for (const auto& part : parts) {
         if (!current) return nullptr; // Помилка на попередньому кроці
@@ -234,13 +766,38 @@ cJSON* ConfigLoader::find_or_create_node_by_path(cJSON* root, const std::vector<
     return current; // Повертає батьківський вузол для останнього елемента шляху
 }
 
-cJSON* ConfigLoader::find_node_by_path(cJSON* root, const std::vector<std::string>& parts) {
-     // Може викликатись з get, де м'ютекс захоплено
+cJSON* ConfigLoader::find_node(cJSON* root, const char* path) {
+    // Лише читає дерево: викликається зі знімка без м'ютекса
+    if (!root || !path || path[0] != '/') return nullptr; // Повинен починатися з '/'
+
+    char segment[PATH_SEGMENT_MAX];
     cJSON* current = root;
-    for (const auto& part : parts) {
-        if (!current || !cJSON_IsObject(current)) return nullptr; // Перевірка перед пошуком
-        current = cJSON_GetObjectItemCaseSensitive(current, part.c_str());
-        if (!current) return nullptr; // Не знайдено
+    const char* p = path + 1;
+    while (*p) {
+        const char* end = strchr(p, '/');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len > 0) { // Порожні сегменти ("//") пропускаємо, як і раніше
+            if (len >= sizeof(segment) || !cJSON_IsObject(current)) return nullptr;
+            memcpy(segment, p, len);
+            segment[len] = '\0';
+            current = cJSON_GetObjectItemCaseSensitive(current, segment);
+            if (!current) return nullptr; // Не знайдено
+        }
+        p += len + (end ? 1 : 0);
     }
     return current;
-}
\ No newline at end of file
+}
+
+ConfigSnapshotPtr ConfigLoader::publish_snapshot(std::shared_ptr<cJSON> tree, uint32_t version) {
+    // Викликається під м'ютексом писачів
+    auto next = std::make_shared<ConfigSnapshot>();
+    next->nodes_.reserve(registered_paths.size());
+    for (const auto& path : registered_paths) {
+        next->nodes_.push_back(find_node(tree.get(), path.c_str()));
+    }
+    next->tree_ = std::move(tree);
+    next->version_ = version;
+    ConfigSnapshotPtr published(std::move(next));
+    std::atomic_store(&current_snapshot, published);
+    return published;
+}
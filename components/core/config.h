@@ -9,6 +9,10 @@
 #include "esp_log.h" // Для логування в get/set
 #include "freertos/FreeRTOS.h" // Для доступу до примітивів синхронізації
 #include "freertos/semphr.h" // Для доступу до примітивів синхронізації
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include "inplace_function.h"
 
 // Оголошення допоміжних функцій та змінних з .cpp, які потрібні шаблонам
 // Або перенесення їх у приватну секцію класу, якщо робимо НЕ статичний клас
@@ -16,46 +20,190 @@
 // зробити їх статичними приватними членами класу ConfigLoader.
 // Щоб зберегти статичність, зробимо їх статичними приватними.
 
+/**
+ * @brief Попередньо розв'язаний шлях конфігурації.
+ *
+ * Отримується з ConfigLoader::path() один раз (напр. в init модуля).
+ * Читання через нього - O(1): без розбору шляху, пошуку по дереву й алокацій.
+ */
+struct ConfigPath {
+    static constexpr uint16_t INVALID = 0xFFFF;
+    uint16_t index = INVALID;
+
+    bool valid() const { return index != INVALID; }
+};
+
+// Обробник зміни конфігурації: path - шлях зміненого піддерева, value - його
+// нове значення (nullptr - видалено). value дійсне лише на час виклику
+using ConfigCallback = InplaceFunction<void(const char* path, const cJSON* value)>;
+using ConfigSubscriptionHandle = uint32_t;
+
+// Тип значення в таблиці дефолтів config_defaults::ENTRIES
+enum class ConfigValueType : uint8_t {
+    BOOL,
+    INT,
+    FLOAT,
+    STRING,
+};
+
+// Запис таблиці дефолтів: шлях і зміщення поля в config_defaults::Defaults
+struct ConfigDefaultEntry {
+    const char* path;
+    ConfigValueType type;
+    size_t offset;
+};
+
+/**
+ * @brief Типізоване поле конфігурації.
+ *
+ * Екземпляри генеруються в config_defaults.h з default_config.json
+ * (config_defaults::CONTROL_SET_TEMP тощо): помилка в шляху - помилка
+ * компіляції, а тип і дефолт задані разом з полем.
+ * index - позиція поля в config_defaults::ENTRIES. ConfigLoader::init()
+ * реєструє шляхи таблиці першими і в тому ж порядку, тож index - це вже
+ * готовий ConfigPath: читання поля не розбирає шлях і не обходить дерево.
+ */
+template <typename T>
+struct ConfigField {
+    // Рядки повертаються копією: знімок може змінитись після читання
+    using value_type = std::conditional_t<std::is_same_v<T, const char*>, std::string, T>;
+
+    const char* path;
+    uint16_t index;
+    T default_value;
+
+    constexpr ConfigPath handle() const { return ConfigPath{index}; }
+};
+
+/**
+ * @brief Незмінний знімок конфігурації.
+ *
+ * Писачі будують нове дерево і публікують новий знімок атомарно (RCU):
+ * читач, що тримає ConfigSnapshotPtr, бачить узгоджений стан на весь час
+ * кількох читань і ніколи не чекає на м'ютекс конфігурації чи запис у файл.
+ */
+class ConfigSnapshot {
+public:
+    template <typename T>
+    T get(const char* path, T default_value) const;
+
+    template <typename T>
+    T get(ConfigPath path, T default_value) const;
+
+    template <typename T>
+    typename ConfigField<T>::value_type get(const ConfigField<T>& field) const {
+        return get(field.handle(), typename ConfigField<T>::value_type(field.default_value));
+    }
+
+    // Дерево лише для читання: змінювати його не можна
+    const cJSON* root() const { return tree_.get(); }
+    uint32_t version() const { return version_; }
+
+private:
+    friend class ConfigLoader;
+
+    std::shared_ptr<cJSON> tree_;
+    // Плоский індекс: вузли зареєстрованих шляхів у цьому дереві
+    std::vector<cJSON*> nodes_;
+    uint32_t version_ = 0;
+};
+
+using ConfigSnapshotPtr = std::shared_ptr<const ConfigSnapshot>;
+
+/**
+ * @brief Лічильники збереження конфігурації.
+ */
+struct ConfigPersistStats {
+    uint32_t writes;             // Логічні зміни (set у межах Edit)
+    uint32_t flushes;            // Записи файлу
+    uint32_t bytes_written;
+    uint32_t errors;
+    uint32_t lock_hold_max_us;   // Найдовше утримання м'ютекса конфігурації
+    uint64_t lock_hold_total_us;
+    uint32_t lock_holds;
+    uint32_t load_time_us;       // Останнє завантаження (init/reload)
+    uint32_t load_heap_peak;     // Пікове використання купи під час нього
+    bool load_binary;            // Користувацька конфігурація - з бінарного файлу
+};
+
 class ConfigLoader {
 public:
+    // Пауза після останньої зміни перед записом у файл і верхня межа затримки
+    static constexpr uint32_t FLUSH_DEBOUNCE_MS = 1000;
+    static constexpr uint32_t FLUSH_MAX_DELAY_MS = 5000;
+    static constexpr uint32_t FLUSH_TASK_STACK_SIZE = 4096;
+    static constexpr UBaseType_t FLUSH_TASK_PRIORITY = 2;
+
     // Ініціалізація залишається статичною
-    static esp_err_t init(const char* default_config_json);
+    // Дефолти - зі згенерованого config_defaults.h, поверх них - user_config
+    static esp_err_t init();
+
+    /**
+     * @brief Реєструє шлях у плоскому індексі і повертає його хендл.
+     *
+     * Повторний виклик з тим самим шляхом повертає той самий хендл. Шлях
+     * може ще не існувати в конфігурації - тоді get() повертає default,
+     * доки значення не з'явиться. Індекс перебудовується при зміні конфігурації.
+     */
+    static ConfigPath path(const char* path);
+
+    /**
+     * @brief Поточний знімок конфігурації.
+     *
+     * Без м'ютекса; для кількох узгоджених читань тримайте знімок локально.
+     */
+    static ConfigSnapshotPtr snapshot();
+
+    /**
+     * @brief Підписка на зміни під префіксом шляху ("/control", "/control/set_temp").
+     *
+     * Після set()/Edit і reload() новий знімок порівнюється з останнім
+     * доставленим, і callback отримує кожне змінене піддерево під префіксом.
+     * Доставка послідовна, у порядку версій; виклик - поза м'ютексом, у потоці
+     * писача або писача, що вже веде доставку. Модуль може тримати значення
+     * в полях класу замість get() на кожному такті.
+     * @return Хендл підписки (0 - помилка).
+     */
+    static ConfigSubscriptionHandle subscribe(const char* path_prefix, ConfigCallback callback);
+
+    /**
+     * @brief Скасовує підписку.
+     *
+     * Якщо callback саме виконується в іншому потоці, чекає його завершення:
+     * після повернення callback більше не викликається, і захоплені ним
+     * об'єкти можна знищувати. Можна викликати з власного callback.
+     */
+    static void unsubscribe(ConfigSubscriptionHandle handle);
+
+    /**
+     * @brief Перечитує user_config поверх дефолтів і сповіщає підписників.
+     *
+     * Незбережені у файл зміни відкидаються.
+     */
+    static esp_err_t reload();
 
     // --- Шаблонні Getters ---
     template <typename T>
     static T get(const char* path, T default_value) {
-        if (xSemaphoreTake(get_mutex(), portMAX_DELAY) != pdTRUE) {
-            ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для get(%s)", path ? path : "NULL");
+        ConfigSnapshotPtr current = snapshot();
+        if (!current) {
+            ESP_LOGE(TAG, "Конфігурація не ініціалізована для get(%s)", path ? path : "NULL");
             return default_value;
         }
+        return current->get(path, default_value);
+    }
 
-        T result = default_value;
-        cJSON* root_node = get_config_root(); // Отримуємо доступ до root JSON
-        if (root_node) {
-            std::vector<std::string> parts = split_path(path);
-            cJSON* node = find_node_by_path(root_node, parts);
-
-            // Спеціалізація логіки для різних типів T
-            if (node) {
-                if constexpr (std::is_same_v<T, int>) {
-                    if (cJSON_IsNumber(node)) result = (int)node->valuedouble;
-                } else if constexpr (std::is_same_v<T, float>) {
-                    if (cJSON_IsNumber(node)) result = (float)node->valuedouble;
-                } else if constexpr (std::is_same_v<T, double>) {
-                    if (cJSON_IsNumber(node)) result = node->valuedouble;
-                } else if constexpr (std::is_same_v<T, bool>) {
-                    if (cJSON_IsBool(node)) result = cJSON_IsTrue(node);
-                } else if constexpr (std::is_same_v<T, std::string>) {
-                    if (cJSON_IsString(node) && node->valuestring) result = node->valuestring;
-                }
-                // Додайте інші типи за потреби
-            }
-        } else {
-             ESP_LOGE(TAG, "Конфігурація не ініціалізована для get(%s)", path ? path : "NULL");
-        }
+    // Типізоване поле: config_defaults::CONTROL_HYSTERESIS тощо - читання через індекс знімка
+    template <typename T>
+    static typename ConfigField<T>::value_type get(const ConfigField<T>& field) {
+        return get(field.handle(), typename ConfigField<T>::value_type(field.default_value));
+    }
 
-        xSemaphoreGive(get_mutex());
-        return result;
+    // Читання через хендл: вузол вже знайдено в індексі знімка
+    template <typename T>
+    static T get(ConfigPath path, T default_value) {
+        ConfigSnapshotPtr current = snapshot();
+        return current ? current->get(path, default_value) : default_value;
     }
 
      // Окремий get для const char*, щоб уникнути проблем з управлінням пам'яттю
@@ -63,86 +211,136 @@ public:
      // Залишимо повернення std::string як основний варіант для рядків.
 
 
-    // --- Шаблонні Setters ---
-     template <typename T>
-     static bool set(const char* path, T value) {
-        if (xSemaphoreTake(get_mutex(), portMAX_DELAY) != pdTRUE) {
-             ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для set(%s)", path ? path : "NULL");
-             return false;
-        }
+    /**
+     * @brief Пакетна зміна конфігурації.
+     *
+     * Тримає м'ютекс писачів на час своєї області видимості: set() змінюють
+     * копію дерева, а новий знімок публікується і запис у файл планується
+     * один раз - у деструкторі. Читачі тим часом бачать попередній знімок. Файл пише фонова задача після
+     * паузи FLUSH_DEBOUNCE_MS, тож серія змін дає один запис.
+     * Усередині Edit не можна викликати інші методи ConfigLoader.
+     */
+    class Edit {
+    public:
+        Edit();
+        ~Edit();
 
-        bool success = false;
-        cJSON* root_node = get_config_root();
-        std::vector<std::string> parts = split_path(path);
-
-        if (!parts.empty() && root_node) {
-            std::string leaf_name = parts.back();
-            parts.pop_back(); // Шлях до батьківського вузла
-
-            cJSON* parent = parts.empty() ? root_node : find_or_create_node_by_path(root_node, parts);
-
-            if (parent && cJSON_IsObject(parent)) {
-                 cJSON* new_item = nullptr;
-                 // Спеціалізація створення cJSON для різних типів T
-                 if constexpr (std::is_same_v<T, int> || std::is_same_v<T, float> || std::is_same_v<T, double>) {
-                     new_item = cJSON_CreateNumber(static_cast<double>(value));
-                 } else if constexpr (std::is_same_v<T, bool>) {
-                     new_item = cJSON_CreateBool(value);
-                 } else if constexpr (std::is_same_v<T, std::string>) {
-                     new_item = cJSON_CreateString(value.c_str());
-                 } else if constexpr (std::is_same_v<T, const char*>) {
-                      new_item = cJSON_CreateString(value);
-                 }
-                 // Додайте інші типи за потреби
-
-                if (new_item) {
-                    if (cJSON_HasObjectItem(parent, leaf_name.c_str())) {
-                        cJSON_ReplaceItemInObjectCaseSensitive(parent, leaf_name.c_str(), new_item);
-                    } else {
-                        cJSON_AddItemToObject(parent, leaf_name.c_str(), new_item);
-                    }
-                    // Збереження у файл
-                    if (save_config_to_file() == ESP_OK) {
-                        success = true;
-                    } else {
-                        ESP_LOGE(TAG, "Помилка збереження конфігурації після set для %s", path);
-                        // TODO: Відкат зміни в пам'яті?
-                    }
-                } else {
-                    ESP_LOGE(TAG, "Не вдалося створити cJSON елемент для %s", path);
-                }
+        template <typename T>
+        Edit& set(const char* path, T value) {
+            if (!locked_ || !apply_set(working_tree(), path, make_item(value))) {
+                ok_ = false;
             } else {
-                ESP_LOGE(TAG, "Не вдалося знайти/створити батьківський вузол для %s", path);
+                ++changes_;
             }
-        } else {
-            ESP_LOGE(TAG, "Некоректний шлях або конфігурація не ініціалізована для %s", path);
+            return *this;
         }
 
-        xSemaphoreGive(get_mutex());
-        return success;
-     }
+        // true - усі set() застосовано (запис у файл відбудеться пізніше)
+        bool ok() const { return ok_; }
+
+        Edit(const Edit&) = delete;
+        Edit& operator=(const Edit&) = delete;
+
+    private:
+        // Копія дерева поточного знімка, створюється при першому set()
+        cJSON* working_tree();
 
+        cJSON* tree_ = nullptr;
+        bool locked_ = false;
+        bool ok_ = true;
+        uint16_t changes_ = 0;
+        int64_t locked_at_us_ = 0;
+    };
+
+    // --- Шаблонні Setters ---
+    // Одиночна зміна - Edit з одного запису
+    template <typename T>
+    static bool set(const char* path, T value) {
+        Edit edit;
+        return edit.set(path, value).ok();
+    }
+
+    /**
+     * @brief Негайно записує незбережені зміни у файл.
+     *
+     * Для випадків, коли далі може бути перезавантаження. У файл іде лише
+     * merge patch відносно дефолтів; запис атомарний: тимчасовий файл і rename.
+     */
+    static esp_err_t flush();
+
+    // Статистика збереження: write amplification і час утримання м'ютекса
+    static ConfigPersistStats get_persist_stats();
+    static cJSON* stats_to_json();
 
     // Отримання копії всього JSON
     static cJSON* getConfigJson();
 
 private:
+    friend class ConfigSnapshot;
+
     // Приватні статичні члени для зберігання стану та синхронізації
-    static cJSON* config_json_root;
+    // (м'ютекс лише серіалізує писачів; читачі працюють зі знімком)
     static SemaphoreHandle_t config_mutex_handle;
     static const char* TAG; // Тег для логування
 
     // Приватні статичні допоміжні методи
-    static esp_err_t save_config_to_file();
-    static char* read_file_to_string(const char* path);
+    static esp_err_t write_file_atomic(const char* path, const uint8_t* data, size_t len);
+    static void flush_task(void* arg);
+    static void schedule_flush();
+    static void record_lock_hold(int64_t locked_at_us);
+    static bool apply_set(cJSON* root, const char* path, cJSON* new_item);
+    // Будує знімок для дерева (індекс - по всіх зареєстрованих шляхах) і публікує його
+    static ConfigSnapshotPtr publish_snapshot(std::shared_ptr<cJSON> tree, uint32_t version);
+    // Дефолти + user_config (бінарний або JSON); nullptr - невалідні дефолти
+    static cJSON* load_merged_tree();
+    static cJSON* load_defaults();
+    // Доставляє підписникам різницю між останнім доставленим і поточним знімком
+    static void notify_changes();
+    static char* read_file_to_string(const char* path, size_t* out_size = nullptr);
     static std::vector<std::string> split_path(const char* path);
     static cJSON* find_or_create_node_by_path(cJSON* root, const std::vector<std::string>& parts);
-    static cJSON* find_node_by_path(cJSON* root, const std::vector<std::string>& parts);
+    // Пошук вузла без алокацій: сегменти копіюються в буфер на стеку
+    static cJSON* find_node(cJSON* root, const char* path);
+
+    // Створення cJSON елемента для значення типу T
+    template <typename T>
+    static cJSON* make_item(T value) {
+        if constexpr (std::is_same_v<T, int> || std::is_same_v<T, float> || std::is_same_v<T, double>) {
+            return cJSON_CreateNumber(static_cast<double>(value));
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return cJSON_CreateBool(value);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            return cJSON_CreateString(value.c_str());
+        } else if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>) {
+            return cJSON_CreateString(value);
+        }
+        // Додайте інші типи за потреби
+        return nullptr;
+    }
+
+    // Перетворення вузла в значення типу T; default - якщо вузла немає або тип інший
+    template <typename T>
+    static T read_node(const cJSON* node, T default_value) {
+        if (!node) {
+            return default_value;
+        }
+        if constexpr (std::is_same_v<T, int>) {
+            if (cJSON_IsNumber(node)) return (int)node->valuedouble;
+        } else if constexpr (std::is_same_v<T, float>) {
+            if (cJSON_IsNumber(node)) return (float)node->valuedouble;
+        } else if constexpr (std::is_same_v<T, double>) {
+            if (cJSON_IsNumber(node)) return node->valuedouble;
+        } else if constexpr (std::is_same_v<T, bool>) {
+            if (cJSON_IsBool(node)) return cJSON_IsTrue(node);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            if (cJSON_IsString(node) && node->valuestring) return node->valuestring;
+        }
+        // Додайте інші типи за потреби
+        return default_value;
+    }
 
     // Доступ до приватних членів (безпечно, оскільки методи статичні)
     static SemaphoreHandle_t get_mutex() { return config_mutex_handle; }
-    static cJSON* get_config_root() { return config_json_root; }
-    static void set_config_root(cJSON* root) { config_json_root = root; }
 
     // Забороняємо створення екземплярів
     ConfigLoader() = delete;
@@ -152,4 +350,14 @@ private:
 
 };
 
+template <typename T>
+T ConfigSnapshot::get(const char* path, T default_value) const {
+    return ConfigLoader::read_node(ConfigLoader::find_node(tree_.get(), path), default_value);
+}
+
+template <typename T>
+T ConfigSnapshot::get(ConfigPath path, T default_value) const {
+    return ConfigLoader::read_node(path.index < nodes_.size() ? nodes_[path.index] : nullptr, default_value);
+}
+
 #endif // CORE_CONFIG_H
\ No newline at end of file
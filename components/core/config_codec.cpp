@@ -0,0 +1,279 @@
+#include "config_codec.h"
+#include <cmath>
+#include <cstring>
+#include <string>
+
+namespace config_codec {
+
+namespace {
+    constexpr uint8_t MAGIC[4] = {'M', 'C', 'F', 'G'};
+    constexpr size_t HEADER_SIZE = sizeof(MAGIC) + 1;
+
+    enum Tag : uint8_t {
+        TAG_NULL = 0,
+        TAG_FALSE = 1,
+        TAG_TRUE = 2,
+        TAG_INT32 = 3,
+        TAG_DOUBLE = 4,
+        TAG_STRING = 5,
+        TAG_OBJECT = 6,
+        TAG_ARRAY = 7,
+    };
+
+    void put_u16(std::vector<uint8_t>& out, uint16_t value) {
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    void put_bytes(std::vector<uint8_t>& out, const void* data, size_t len) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        out.insert(out.end(), bytes, bytes + len);
+    }
+
+    bool encode_value(const cJSON* node, std::vector<uint8_t>& out, int depth) {
+        if (depth > MAX_DEPTH) {
+            return false;
+        }
+        if (cJSON_IsNull(node)) {
+            out.push_back(TAG_NULL);
+        } else if (cJSON_IsFalse(node)) {
+            out.push_back(TAG_FALSE);
+        } else if (cJSON_IsTrue(node)) {
+            out.push_back(TAG_TRUE);
+        } else if (cJSON_IsNumber(node)) {
+            double value = node->valuedouble;
+            // Цілі (піни, інтервали, порти) - 4 байти замість 8
+            if (value >= INT32_MIN && value <= INT32_MAX && std::floor(value) == value) {
+                int32_t integer = static_cast<int32_t>(value);
+                out.push_back(TAG_INT32);
+                put_bytes(out, &integer, sizeof(integer));
+            } else {
+                out.push_back(TAG_DOUBLE);
+                put_bytes(out, &value, sizeof(value));
+            }
+        } else if (cJSON_IsString(node) && node->valuestring) {
+            size_t len = strlen(node->valuestring);
+            if (len > UINT16_MAX) {
+                return false;
+            }
+            out.push_back(TAG_STRING);
+            put_u16(out, static_cast<uint16_t>(len));
+            put_bytes(out, node->valuestring, len);
+        } else if (cJSON_IsObject(node) || cJSON_IsArray(node)) {
+            bool object = cJSON_IsObject(node);
+            int count = cJSON_GetArraySize(node);
+            if (count > UINT16_MAX) {
+                return false;
+            }
+            out.push_back(object ? TAG_OBJECT : TAG_ARRAY);
+            put_u16(out, static_cast<uint16_t>(count));
+            for (const cJSON* child = node->child; child; child = child->next) {
+                if (object) {
+                    size_t key_len = child->string ? strlen(child->string) : 0;
+                    if (key_len == 0 || key_len > UINT8_MAX) {
+                        return false;
+                    }
+                    out.push_back(static_cast<uint8_t>(key_len));
+                    put_bytes(out, child->string, key_len);
+                }
+                if (!encode_value(child, out, depth + 1)) {
+                    return false;
+                }
+            }
+        } else {
+            return false; // cJSON_Raw і невалідні вузли
+        }
+        return true;
+    }
+
+    // Послідовне читання з перевіркою меж: після першої помилки ok() == false
+    class Reader {
+    public:
+        Reader(const uint8_t* data, size_t len) : pos_(data), end_(data + len) {}
+
+        bool ok() const { return ok_; }
+        bool at_end() const { return pos_ == end_; }
+
+        const uint8_t* take(size_t len) {
+            if (!ok_ || static_cast<size_t>(end_ - pos_) < len) {
+                ok_ = false;
+                return nullptr;
+            }
+            const uint8_t* start = pos_;
+            pos_ += len;
+            return start;
+        }
+
+        uint8_t u8() {
+            const uint8_t* p = take(1);
+            return p ? p[0] : 0;
+        }
+
+        uint16_t u16() {
+            const uint8_t* p = take(2);
+            return p ? static_cast<uint16_t>(p[0] | (p[1] << 8)) : 0;
+        }
+
+    private:
+        const uint8_t* pos_;
+        const uint8_t* end_;
+        bool ok_ = true;
+    };
+
+    bool merge_object(Reader& reader, cJSON* target, int depth);
+
+    // Створює новий вузол для значення з тегом tag
+    cJSON* decode_value(Reader& reader, uint8_t tag, int depth) {
+        if (depth > MAX_DEPTH) {
+            return nullptr;
+        }
+        switch (tag) {
+            case TAG_NULL:
+                return cJSON_CreateNull();
+            case TAG_FALSE:
+                return cJSON_CreateFalse();
+            case TAG_TRUE:
+                return cJSON_CreateTrue();
+            case TAG_INT32: {
+                const uint8_t* p = reader.take(sizeof(int32_t));
+                if (!p) return nullptr;
+                int32_t value;
+                memcpy(&value, p, sizeof(value));
+                return cJSON_CreateNumber(value);
+            }
+            case TAG_DOUBLE: {
+                const uint8_t* p = reader.take(sizeof(double));
+                if (!p) return nullptr;
+                double value;
+                memcpy(&value, p, sizeof(value));
+                return cJSON_CreateNumber(value);
+            }
+            case TAG_STRING: {
+                uint16_t len = reader.u16();
+                const uint8_t* p = reader.take(len);
+                if (!p) return nullptr;
+                std::string value(reinterpret_cast<const char*>(p), len);
+                return cJSON_CreateString(value.c_str());
+            }
+            case TAG_OBJECT: {
+                // Рівень той самий, що в encode_value: об'єкт уже на depth
+                cJSON* object = cJSON_CreateObject();
+                if (object && !merge_object(reader, object, depth)) {
+                    cJSON_Delete(object);
+                    return nullptr;
+                }
+                return object;
+            }
+            case TAG_ARRAY: {
+                uint16_t count = reader.u16();
+                cJSON* array = cJSON_CreateArray();
+                for (uint16_t i = 0; array && i < count; ++i) {
+                    cJSON* item = decode_value(reader, reader.u8(), depth + 1);
+                    if (!item || !reader.ok()) {
+                        cJSON_Delete(item);
+                        cJSON_Delete(array);
+                        return nullptr;
+                    }
+                    cJSON_AddItemToArray(array, item);
+                }
+                return array;
+            }
+            default:
+                return nullptr;
+        }
+    }
+
+    // Читає пари об'єкта (після тегу) і накладає їх на target
+    bool merge_object(Reader& reader, cJSON* target, int depth) {
+        if (depth > MAX_DEPTH) {
+            return false;
+        }
+        uint16_t count = reader.u16();
+        for (uint16_t i = 0; i < count; ++i) {
+            uint8_t key_len = reader.u8();
+            const uint8_t* key_data = reader.take(key_len);
+            if (!key_data || key_len == 0) {
+                return false;
+            }
+            // Ключі короткі - вміщаються в std::string без купи
+            std::string key(reinterpret_cast<const char*>(key_data), key_len);
+            uint8_t tag = reader.u8();
+            if (!reader.ok()) {
+                return false; // Обрізано після ключа: не видаляти його як null
+            }
+            cJSON* existing = cJSON_GetObjectItemCaseSensitive(target, key.c_str());
+
+            if (tag == TAG_NULL) {
+                cJSON_DeleteItemFromObjectCaseSensitive(target, key.c_str());
+                continue;
+            }
+            if (tag == TAG_OBJECT && cJSON_IsObject(existing)) {
+                if (!merge_object(reader, existing, depth + 1)) {
+                    return false;
+                }
+                continue;
+            }
+            cJSON* item = decode_value(reader, tag, depth + 1);
+            if (!item) {
+                return false;
+            }
+            if (existing) {
+                cJSON_ReplaceItemInObjectCaseSensitive(target, key.c_str(), item);
+            } else {
+                cJSON_AddItemToObject(target, key.c_str(), item);
+            }
+        }
+        return reader.ok();
+    }
+}
+
+bool encode(const cJSON* root, std::vector<uint8_t>& out) {
+    out.clear();
+    put_bytes(out, MAGIC, sizeof(MAGIC));
+    out.push_back(FORMAT_VERSION);
+    return cJSON_IsObject(root) && encode_value(root, out, 0);
+}
+
+bool is_binary(const uint8_t* data, size_t len) {
+    return data && len >= HEADER_SIZE && memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+uint8_t format_version(const uint8_t* data, size_t len) {
+    return is_binary(data, len) ? data[sizeof(MAGIC)] : 0;
+}
+
+bool decode_merge(const uint8_t* data, size_t len, cJSON* target) {
+    uint8_t version = format_version(data, len);
+    if (version == 0 || version > FORMAT_VERSION || !cJSON_IsObject(target)) {
+        return false;
+    }
+    Reader reader(data + HEADER_SIZE, len - HEADER_SIZE);
+    if (reader.u8() != TAG_OBJECT) {
+        return false;
+    }
+    return merge_object(reader, target, 0) && reader.at_end();
+}
+
+cJSON* make_merge_patch(const cJSON* from, const cJSON* to) {
+    if (!cJSON_IsObject(from) || !cJSON_IsObject(to)) {
+        return cJSON_Compare(from, to, true) ? nullptr : cJSON_Duplicate(to, true);
+    }
+    cJSON* patch = nullptr;
+    for (const cJSON* child = to->child; child; child = child->next) {
+        cJSON* change = make_merge_patch(cJSON_GetObjectItemCaseSensitive(from, child->string), child);
+        if (change && (patch || (patch = cJSON_CreateObject()))) {
+            cJSON_AddItemToObject(patch, child->string, change);
+        } else if (change) {
+            cJSON_Delete(change);
+        }
+    }
+    for (const cJSON* child = from->child; child; child = child->next) {
+        if (!cJSON_GetObjectItemCaseSensitive(to, child->string) &&
+            (patch || (patch = cJSON_CreateObject()))) {
+            cJSON_AddItemToObject(patch, child->string, cJSON_CreateNull());
+        }
+    }
+    return patch;
+}
+
+} // namespace config_codec
@@ -0,0 +1,55 @@
+#ifndef CORE_CONFIG_CODEC_H
+#define CORE_CONFIG_CODEC_H
+
+#include "cJSON.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Компактний бінарний формат конфігурації для flash.
+ *
+ * Заголовок "MCFG" + версія, далі одне значення (кореневий об'єкт).
+ * Версія 1 - повне дерево, версія 2 - merge patch відносно дефолтів;
+ * кодування однакове, тож декодуються обидві.
+ * Значення - байт тегу і дані (little-endian): числа як int32 або double,
+ * рядки з u16-довжиною, об'єкти - u16-кількість пар з u8-довжиною ключа.
+ * Декодування не потребує текстового розбору і проміжного дерева:
+ * значення накладаються прямо на дерево дефолтів.
+ */
+namespace config_codec {
+
+constexpr uint8_t FORMAT_VERSION = 2;
+// Обмеження вкладеності: захист стека від пошкодженого файлу (корінь - рівень 0)
+constexpr int MAX_DEPTH = 16;
+
+// Кодує дерево у out. false - значення, яке формат не підтримує
+bool encode(const cJSON* root, std::vector<uint8_t>& out);
+
+// Чи схожі дані на бінарний формат (за заголовком)
+bool is_binary(const uint8_t* data, size_t len);
+
+// Версія формату з заголовка (0 - не бінарний формат)
+uint8_t format_version(const uint8_t* data, size_t len);
+
+/**
+ * @brief Декодує дані і накладає їх поверх target.
+ *
+ * Семантика merge patch: об'єкти зливаються по ключах, null видаляє ключ,
+ * решта значень замінює наявні. При false target міг бути змінений частково.
+ */
+bool decode_merge(const uint8_t* data, size_t len, cJSON* target);
+
+/**
+ * @brief Merge patch (RFC 7386), що перетворює from на to.
+ *
+ * Об'єкти порівнюються по ключах, видалені ключі дають null, решта
+ * значень (масиви теж) - цілком. decode_merge(encode(patch)) поверх from
+ * відтворює to.
+ * @return Новий патч (звільняє викликач) або nullptr, якщо дерева однакові.
+ */
+cJSON* make_merge_patch(const cJSON* from, const cJSON* to);
+
+} // namespace config_codec
+
+#endif // CORE_CONFIG_CODEC_H
@@ -4,85 +4,1017 @@
 #include "freertos/queue.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "cJSON.h"
 #include <map>
 #include <vector>
 #include <string>
-#include <functional>
 #include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
 
 static const char* TAG = "EventBus";
 
 namespace {
+    static constexpr uint8_t POOL_BLOCK_NONE = 0xFF;
+    // Маркер злиття: сам payload лежить у CoalesceSlot типу події
+    static constexpr uint8_t POOL_BLOCK_COALESCED = 0xFE;
+
+    // Конфігурація смуг за замовчуванням (індекс = EventLane).
+    // Смуга керування має найвищий пріоритет і закріплена за APP CPU,
+    // телеметрія - на PRO CPU разом з Wi-Fi та веб-сервером.
+    static const EventLaneConfig DEFAULT_LANES[EventBus::LANE_COUNT] = {
+        { 8,  4096, 10, 1 },                    // CONTROL
+        { 10, 4096, 5,  EVENT_LANE_ANY_CORE },  // NORMAL
+        { 16, 6144, 3,  0 },                    // TELEMETRY
+    };
+
+    static const char* const LANE_TASK_NAMES[EventBus::LANE_COUNT] = {
+        "evt_control", "evt_normal", "evt_telemetry"
+    };
+
+    // Елемент черги має бути тривіально копійованим: FreeRTOS копіює його через memcpy.
+    // Малий payload лежить прямо в inline_data, більший - у блоці пулу pool_block.
     struct EventQueueItem {
+        EventId id;
+        uint8_t size;
+        uint8_t pool_block;
+        uint32_t enqueue_us;    // Молодші 32 біти esp_timer_get_time() на момент публікації
+        alignas(EventBus::PAYLOAD_ALIGN) uint8_t inline_data[EventBus::INLINE_PAYLOAD_SIZE];
+    };
+
+    static_assert(EventBus::POOL_BLOCK_COUNT <= 32, "Бітова маска пулу розрахована на 32 блоки");
+    static_assert(EventBus::POOL_BLOCK_SIZE <= 0xFF, "Розмір payload зберігається в uint8_t");
+    static_assert(EventBus::LANE_COUNT <= 8, "Маска смуг зберігається в uint8_t");
+
+    // Пул блоків для великих payload. Вільні блоки позначені одиницями в масці,
+    // захоплення/звільнення - через CAS, без м'ютексів і malloc.
+    // Один блок може бути в чергах кількох смуг, тому має лічильник посилань.
+    alignas(EventBus::PAYLOAD_ALIGN) static uint8_t pool_blocks[EventBus::POOL_BLOCK_COUNT][EventBus::POOL_BLOCK_SIZE];
+    static std::atomic<uint8_t> pool_refs[EventBus::POOL_BLOCK_COUNT];
+    static std::atomic<uint32_t> pool_free_mask{
+        EventBus::POOL_BLOCK_COUNT == 32 ? 0xFFFFFFFFu : ((1u << EventBus::POOL_BLOCK_COUNT) - 1)};
+
+    uint8_t pool_acquire(uint8_t refs) {
+        uint32_t mask = pool_free_mask.load(std::memory_order_relaxed);
+        while (mask) {
+            uint32_t bit = mask & (~mask + 1); // Найменший вільний блок
+            if (pool_free_mask.compare_exchange_weak(mask, mask & ~bit, std::memory_order_acquire, std::memory_order_relaxed)) {
+                uint8_t block = static_cast<uint8_t>(__builtin_ctz(bit));
+                pool_refs[block].store(refs, std::memory_order_relaxed);
+                return block;
+            }
+        }
+        return POOL_BLOCK_NONE;
+    }
+
+    void pool_release(uint8_t block) {
+        if (block < EventBus::POOL_BLOCK_COUNT &&
+            pool_refs[block].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            pool_free_mask.fetch_or(1u << block, std::memory_order_release);
+        }
+    }
+
+    const void* item_payload(const EventQueueItem& item) {
+        if (item.size == 0) return nullptr;
+        if (item.pool_block != POOL_BLOCK_NONE) return pool_blocks[item.pool_block];
+        return item.inline_data;
+    }
+
+    // Останнє значення події з політикою COALESCE. У черзі смуги лежить лише маркер,
+    // а pending[lane] показує, що маркер для цієї смуги вже стоїть у черзі.
+    struct CoalesceSlot {
+        portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+        EventQueueItem latest;
+        bool pending[EventBus::LANE_COUNT] = {};
+    };
+
+    // Кільцевий резерв смуги для подій MUST_DELIVER, що не влізли в чергу
+    struct LaneReserve {
+        portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+        EventQueueItem items[EventBus::RESERVE_SIZE];
+        uint8_t head = 0;
+        uint8_t count = 0;
+    };
+
+    // Гістограма часу в мкс з log2-кошиками: кошик i - [2^i, 2^(i+1)), кошик 0 - [0, 2),
+    // останній збирає все довше. Лише атомарні лічильники - запис без блокувань.
+    static constexpr size_t HISTOGRAM_BUCKETS = 16;
+
+    struct Histogram {
+        std::atomic<uint32_t> buckets[HISTOGRAM_BUCKETS] = {};
+        std::atomic<uint32_t> max_us{0};
+
+        void record(uint32_t us) {
+            size_t bucket = us ? static_cast<size_t>(31 - __builtin_clz(us)) : 0;
+            if (bucket >= HISTOGRAM_BUCKETS) bucket = HISTOGRAM_BUCKETS - 1;
+            buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+            uint32_t max = max_us.load(std::memory_order_relaxed);
+            while (us > max && !max_us.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+            }
+        }
+    };
+
+    // Запис підписника створюється один раз у subscribe. Списки типів, дерево шаблонів
+    // і знімки тримають лише вказівники: callback (move-only) ніколи не копіюється.
+    struct Subscriber {
+        EventSubscriptionHandle handle = 0;
+        uint8_t lane = 0;
+        EventCallback callback;
+        Histogram exec_time;    // Час виконання callback
+    };
+    using SubscriberPtr = std::shared_ptr<Subscriber>;
+
+    // Незмінний знімок підписників усіх типів, згрупований за (тип, смуга).
+    // Перебудовується під subs_mutex при зміні підписок і заміняється атомарно;
+    // диспетчер лише бере посилання - без м'ютекса, копій std::function і алокацій.
+    struct SubscriberTable {
+        uint32_t version = 0;
+        std::vector<SubscriberPtr> subscribers;
+        // Підписники (id, lane): [offsets[id * LANE_COUNT + lane], offsets[id * LANE_COUNT + lane + 1])
+        uint16_t offsets[EventBus::MAX_EVENT_TYPES * EventBus::LANE_COUNT + 1] = {};
+    };
+
+    static std::shared_ptr<const SubscriberTable> current_table;
+    static std::atomic<uint32_t> table_version{0};
+
+    // Зареєстрований тип події. Записи з індексом < event_type_count незмінні
+    // (крім списку підписників, який захищено subs_mutex).
+    struct EventType {
+        uint32_t hash = 0;
         std::string name;
-        void* data;
+        std::vector<SubscriberPtr> subscribers;
+        // Смуги, в яких є підписники: publish ставить подію лише в ці черги
+        std::atomic<uint8_t> lane_mask{0};
+        std::atomic<uint8_t> policy{static_cast<uint8_t>(EventPolicy::DROP_NEWEST)};
+        // Створюється в set_policy(COALESCE) і далі не звільняється
+        CoalesceSlot* coalesce = nullptr;
+
+        std::atomic<uint32_t> published{0};
+        std::atomic<uint32_t> delivered{0};   // Викликів callback підписників
+        std::atomic<uint32_t> dropped{0};     // Відкинуто, витіснено або втрачено в будь-якій смузі
+        std::atomic<uint32_t> coalesced{0};
+    };
+
+    static EventType event_types[EventBus::MAX_EVENT_TYPES];
+    static std::atomic<uint16_t> event_type_count{0};
+
+    static std::map<EventSubscriptionHandle, EventId> handle_to_id;
+
+    // Вузол дерева шаблонів підписки. Ім'я події ділиться на сегменти за '.',
+    // '*' у шаблоні відповідає рівно одному сегменту. Дерево обходиться лише при
+    // реєстрації нового імені: підписники шаблонів копіюються в списки типів подій,
+    // тож вартість диспетчеризації не залежить від кількості шаблонів.
+    struct TopicNode {
+        std::map<std::string, std::unique_ptr<TopicNode>> children;
+        std::vector<SubscriberPtr> subscribers;    // Шаблони, що закінчуються в цьому вузлі
     };
 
-    static std::map<std::string, std::vector<std::pair<EventSubscriptionHandle, EventCallback>>> subscribers;
-    static std::map<EventSubscriptionHandle, std::string> handle_to_key;
+    static TopicNode topic_root;
+    static std::map<EventSubscriptionHandle, std::string> handle_to_pattern;
     static std::atomic<uint32_t> next_handle{1};
     static SemaphoreHandle_t subs_mutex = nullptr;
-    static QueueHandle_t event_queue = nullptr;
-    static TaskHandle_t event_task_handle = nullptr;
+    static QueueHandle_t lane_queues[EventBus::LANE_COUNT] = {};
+    static TaskHandle_t lane_tasks[EventBus::LANE_COUNT] = {};
+    static LaneReserve lane_reserves[EventBus::LANE_COUNT];
+    static uint32_t lane_queue_sizes[EventBus::LANE_COUNT] = {};
+    static std::atomic<uint32_t> lane_high_watermark[EventBus::LANE_COUNT] = {};
+    // Затримка від публікації до початку диспетчеризації
+    static Histogram lane_latency[EventBus::LANE_COUNT];
 
-    void event_handler_task(void* param) {
+    static std::atomic<uint32_t> stat_coalesced{0};
+    static std::atomic<uint32_t> stat_dropped{0};
+    static std::atomic<uint32_t> stat_evicted{0};
+    static std::atomic<uint32_t> stat_spilled{0};
+    static std::atomic<uint32_t> stat_lost{0};
+
+    // Запис ISR-публікації: payload лише inline, час переривання - для вимірювання затримки
+    struct IsrRecord {
+        EventId id;
+        uint8_t size;
+        int64_t timestamp_us;
+        alignas(EventBus::PAYLOAD_ALIGN) uint8_t data[EventBus::INLINE_PAYLOAD_SIZE];
+    };
+
+    // Кільце одного виробника (переривання свого ядра) і одного споживача (диспетчер CONTROL).
+    // Індекси ростуть монотонно, позиція - індекс за модулем ISR_RING_SIZE.
+    struct IsrRing {
+        std::atomic<uint32_t> head{0};
+        std::atomic<uint32_t> tail{0};
+        IsrRecord records[EventBus::ISR_RING_SIZE];
+    };
+
+    static_assert((EventBus::ISR_RING_SIZE & (EventBus::ISR_RING_SIZE - 1)) == 0,
+                  "ISR_RING_SIZE має бути степенем двійки");
+
+    static IsrRing isr_rings[portNUM_PROCESSORS];
+    // Диспетчер CONTROL взводить прапорець перед сном; перше переривання його знімає
+    // і будить диспетчер маркером у черзі (id = EVENT_ID_INVALID)
+    static std::atomic<uint32_t> isr_wake_armed{0};
+
+    static std::atomic<uint32_t> isr_published{0};
+    static std::atomic<uint32_t> isr_overflowed{0};
+    static std::atomic<uint32_t> isr_last_latency_us{0};
+    static std::atomic<uint32_t> isr_max_latency_us{0};
+
+    static constexpr uint8_t CONTROL_LANE = static_cast<uint8_t>(EventLane::CONTROL);
+
+    // Пошук без блокування: записи публікуються через event_type_count (release)
+    EventId find_event_id(const char* event_name, uint32_t h) {
+        uint16_t count = event_type_count.load(std::memory_order_acquire);
+        for (uint16_t i = 0; i < count; ++i) {
+            if (event_types[i].hash == h && event_types[i].name == event_name) {
+                return i;
+            }
+        }
+        return EVENT_ID_INVALID;
+    }
+
+    bool is_pattern(const char* name) {
+        return strchr(name, '*') != nullptr;
+    }
+
+    std::vector<std::string> split_topic(const std::string& name) {
+        std::vector<std::string> segments;
+        size_t start = 0;
         while (true) {
-            EventQueueItem item;
-            if (xQueueReceive(event_queue, &item, portMAX_DELAY) == pdTRUE) {
-                std::vector<std::pair<EventSubscriptionHandle, EventCallback>> callbacks;
-                if (xSemaphoreTake(subs_mutex, portMAX_DELAY) == pdTRUE) {
-                    auto it = subscribers.find(item.name);
-                    if (it != subscribers.end()) {
-                        callbacks = it->second;
+            const size_t dot = name.find('.', start);
+            segments.push_back(name.substr(start, dot == std::string::npos ? std::string::npos : dot - start));
+            if (dot == std::string::npos) break;
+            start = dot + 1;
+        }
+        return segments;
+    }
+
+    bool topic_matches(const std::vector<std::string>& pattern, const std::vector<std::string>& segments) {
+        if (pattern.size() != segments.size()) return false;
+        for (size_t i = 0; i < pattern.size(); ++i) {
+            if (pattern[i] != "*" && pattern[i] != segments[i]) return false;
+        }
+        return true;
+    }
+
+    // Збирає підписників усіх шаблонів, що відповідають імені. Викликається під subs_mutex.
+    void collect_pattern_subscribers(const TopicNode& node, const std::vector<std::string>& segments,
+                                     size_t depth, std::vector<SubscriberPtr>& out) {
+        if (depth == segments.size()) {
+            out.insert(out.end(), node.subscribers.begin(), node.subscribers.end());
+            return;
+        }
+        auto exact = node.children.find(segments[depth]);
+        if (exact != node.children.end()) {
+            collect_pattern_subscribers(*exact->second, segments, depth + 1, out);
+        }
+        auto any = node.children.find("*");
+        if (any != node.children.end()) {
+            collect_pattern_subscribers(*any->second, segments, depth + 1, out);
+        }
+    }
+
+    std::shared_ptr<const SubscriberTable> load_table() {
+        return std::atomic_load(&current_table);
+    }
+
+    // Публікує новий знімок і лише потім маски смуг: подія, поставлена в чергу
+    // за новою маскою, гарантовано застане в диспетчері новий знімок.
+    // Викликається під subs_mutex після кожної зміни списків підписників.
+    void commit_subscribers(uint16_t type_count) {
+        auto table = std::make_shared<SubscriberTable>();
+        size_t total = 0;
+        for (uint16_t id = 0; id < type_count; ++id) {
+            total += event_types[id].subscribers.size();
+        }
+        table->subscribers.reserve(total);
+
+        size_t slot = 0;
+        for (uint16_t id = 0; id < type_count; ++id) {
+            for (uint8_t lane = 0; lane < EventBus::LANE_COUNT; ++lane) {
+                table->offsets[slot++] = static_cast<uint16_t>(table->subscribers.size());
+                for (const auto& sub : event_types[id].subscribers) {
+                    if (sub->lane == lane) table->subscribers.push_back(sub);
+                }
+            }
+        }
+        while (slot <= EventBus::MAX_EVENT_TYPES * EventBus::LANE_COUNT) {
+            table->offsets[slot++] = static_cast<uint16_t>(table->subscribers.size());
+        }
+        table->version = table_version.load(std::memory_order_relaxed) + 1;
+        std::atomic_store(&current_table, std::shared_ptr<const SubscriberTable>(std::move(table)));
+        table_version.fetch_add(1, std::memory_order_release);
+
+        for (uint16_t id = 0; id < type_count; ++id) {
+            uint8_t mask = 0;
+            for (const auto& sub : event_types[id].subscribers) {
+                mask |= static_cast<uint8_t>(1u << sub->lane);
+            }
+            event_types[id].lane_mask.store(mask, std::memory_order_release);
+        }
+    }
+
+    uint32_t now_us() {
+        return static_cast<uint32_t>(esp_timer_get_time());
+    }
+
+    void count_dropped(EventId id) {
+        if (id < EventBus::MAX_EVENT_TYPES) event_types[id].dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void note_queue_depth(uint8_t lane) {
+        const uint32_t depth = uxQueueMessagesWaiting(lane_queues[lane]);
+        uint32_t max = lane_high_watermark[lane].load(std::memory_order_relaxed);
+        while (depth > max && !lane_high_watermark[lane].compare_exchange_weak(max, depth, std::memory_order_relaxed)) {
+        }
+    }
+
+    EventPolicy policy_of(EventId id) {
+        return static_cast<EventPolicy>(event_types[id].policy.load(std::memory_order_acquire));
+    }
+
+    // Порожній елемент (id = EVENT_ID_INVALID), що лише будить диспетчер смуги
+    EventQueueItem wake_marker() {
+        EventQueueItem marker;
+        marker.id = EVENT_ID_INVALID;
+        marker.size = 0;
+        marker.pool_block = POOL_BLOCK_NONE;
+        marker.enqueue_us = 0;
+        return marker;
+    }
+
+    // Чи викликає код диспетчер будь-якої смуги (підписник або розбір кілець ISR)
+    bool is_dispatcher_task() {
+        const TaskHandle_t current = xTaskGetCurrentTaskHandle();
+        for (TaskHandle_t task : lane_tasks) {
+            if (task && task == current) return true;
+        }
+        return false;
+    }
+
+    bool reserve_push(uint8_t lane, const EventQueueItem& item) {
+        LaneReserve& r = lane_reserves[lane];
+        bool pushed = false;
+        taskENTER_CRITICAL(&r.lock);
+        if (r.count < EventBus::RESERVE_SIZE) {
+            r.items[(r.head + r.count) % EventBus::RESERVE_SIZE] = item;
+            r.count++;
+            pushed = true;
+        }
+        taskEXIT_CRITICAL(&r.lock);
+        return pushed;
+    }
+
+    bool reserve_pop(uint8_t lane, EventQueueItem& item) {
+        LaneReserve& r = lane_reserves[lane];
+        bool popped = false;
+        taskENTER_CRITICAL(&r.lock);
+        if (r.count > 0) {
+            item = r.items[r.head];
+            r.head = (r.head + 1) % EventBus::RESERVE_SIZE;
+            r.count--;
+            popped = true;
+        }
+        taskEXIT_CRITICAL(&r.lock);
+        return popped;
+    }
+
+    // Звільняє ресурси елемента, який не буде доставлено
+    void discard_item(uint8_t lane, const EventQueueItem& item) {
+        if (item.pool_block == POOL_BLOCK_COALESCED) {
+            // Маркер зник - наступна публікація має поставити новий
+            CoalesceSlot* slot = event_types[item.id].coalesce;
+            taskENTER_CRITICAL(&slot->lock);
+            slot->pending[lane] = false;
+            taskEXIT_CRITICAL(&slot->lock);
+        } else {
+            pool_release(item.pool_block);
+        }
+    }
+
+    // Ставить елемент у чергу смуги з урахуванням політики переповнення.
+    // При false ресурси елемента (блок пулу, маркер злиття) має звільнити викликач.
+    bool enqueue(uint8_t lane, const EventQueueItem& item, EventPolicy policy) {
+        QueueHandle_t queue = lane_queues[lane];
+        if (xQueueSend(queue, &item, 0) == pdTRUE) {
+            note_queue_depth(lane);
+            return true;
+        }
+
+        switch (policy) {
+            case EventPolicy::DROP_OLDEST: {
+                EventQueueItem oldest;
+                if (xQueueReceive(queue, &oldest, 0) == pdTRUE) {
+                    if (oldest.id == EVENT_ID_INVALID) {
+                        // Маркер пробудження: нова подія в черзі розбудить диспетчер сама
+                    } else if (oldest.id < EventBus::MAX_EVENT_TYPES && policy_of(oldest.id) == EventPolicy::MUST_DELIVER) {
+                        // Гарантовані події не витісняємо, а переносимо в резерв
+                        if (reserve_push(lane, oldest)) {
+                            stat_spilled++;
+                        } else {
+                            discard_item(lane, oldest);
+                            count_dropped(oldest.id);
+                            stat_lost++;
+                        }
+                    } else {
+                        discard_item(lane, oldest);
+                        count_dropped(oldest.id);
+                        stat_evicted++;
                     }
-                    xSemaphoreGive(subs_mutex);
                 }
-                for (const auto& [handle, cb] : callbacks) {
-                    if (cb) cb(item.name, item.data);
+                if (xQueueSend(queue, &item, 0) == pdTRUE) return true;
+                break;
+            }
+            case EventPolicy::MUST_DELIVER: {
+                if (reserve_push(lane, item)) {
+                    stat_spilled++;
+                    // Диспетчер міг розібрати чергу і заснути до того, як подія лягла в резерв.
+                    // Маркер його будить; якщо черга знову повна, диспетчер і так не спить
+                    // і перевірить резерв після поточної пачки.
+                    const EventQueueItem marker = wake_marker();
+                    xQueueSend(queue, &marker, 0);
+                    return true;
+                }
+                // Диспетчери не блокуємо: власний тоді не розбирає чергу, а чужий
+                // (CONTROL, що пересилає записи ISR) затримує свою смугу
+                const TickType_t wait = is_dispatcher_task() ? 0 : pdMS_TO_TICKS(EventBus::MUST_DELIVER_TIMEOUT_MS);
+                if (xQueueSend(queue, &item, wait) == pdTRUE) {
+                    return true;
                 }
+                stat_lost++;
+                count_dropped(item.id);
+                ESP_LOGE(TAG, "Подію MUST_DELIVER '%s' втрачено (%s)", event_types[item.id].name.c_str(), LANE_TASK_NAMES[lane]);
+                return false;
+            }
+            default:
+                break;
+        }
+
+        stat_dropped++;
+        count_dropped(item.id);
+        ESP_LOGW(TAG, "Черга подій переповнена (%s)", LANE_TASK_NAMES[lane]);
+        return false;
+    }
+
+    void dispatch_item(uint8_t lane, EventQueueItem& item, const SubscriberTable* table) {
+        if (item.id >= event_type_count.load(std::memory_order_acquire)) {
+            pool_release(item.pool_block);
+            return;
+        }
+        EventType& type = event_types[item.id];
+
+        if (item.pool_block == POOL_BLOCK_COALESCED) {
+            // Забираємо найсвіжіше значення; нові публікації знову поставлять маркер
+            CoalesceSlot* slot = type.coalesce;
+            taskENTER_CRITICAL(&slot->lock);
+            item = slot->latest;
+            slot->pending[lane] = false;
+            taskEXIT_CRITICAL(&slot->lock);
+        }
+
+        lane_latency[lane].record(now_us() - item.enqueue_us);
+
+        const void* payload = item_payload(item);
+        const size_t slot = static_cast<size_t>(item.id) * EventBus::LANE_COUNT + lane;
+        const size_t end = table ? table->offsets[slot + 1] : 0;
+        for (size_t i = table ? table->offsets[slot] : 0; i < end; ++i) {
+            Subscriber& sub = *table->subscribers[i];
+            if (!sub.callback) continue;
+            const uint32_t started_us = now_us();
+            sub.callback(type.name, payload);
+            sub.exec_time.record(now_us() - started_us);
+            type.delivered.fetch_add(1, std::memory_order_relaxed);
+        }
+        pool_release(item.pool_block);
+    }
+
+    // Оновлює останнє значення і ставить маркер лише в ті смуги, де його ще немає
+    esp_err_t publish_coalesced(EventId id, const EventQueueItem& item, uint8_t lane_mask) {
+        CoalesceSlot* slot = event_types[id].coalesce;
+        uint8_t need_marker = 0;
+
+        taskENTER_CRITICAL(&slot->lock);
+        slot->latest = item;
+        for (uint8_t lane = 0; lane < EventBus::LANE_COUNT; ++lane) {
+            if (!(lane_mask & (1u << lane))) continue;
+            if (slot->pending[lane]) {
+                stat_coalesced++;
+                event_types[id].coalesced.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                slot->pending[lane] = true;
+                need_marker |= static_cast<uint8_t>(1u << lane);
+            }
+        }
+        taskEXIT_CRITICAL(&slot->lock);
+
+        EventQueueItem marker;
+        marker.id = id;
+        marker.size = 0;
+        marker.pool_block = POOL_BLOCK_COALESCED;
+
+        esp_err_t result = ESP_OK;
+        for (uint8_t lane = 0; lane < EventBus::LANE_COUNT; ++lane) {
+            if (!(need_marker & (1u << lane))) continue;
+            if (!enqueue(lane, marker, EventPolicy::COALESCE)) {
+                discard_item(lane, marker);
+                result = ESP_ERR_TIMEOUT;
             }
         }
+        return result;
     }
+
+    // Ставить готовий елемент у черги смуг з маски згідно з політикою типу
+    esp_err_t publish_item(EventId id, const EventQueueItem& item, uint8_t lane_mask) {
+        event_types[id].published.fetch_add(1, std::memory_order_relaxed);
+        const EventPolicy policy = policy_of(id);
+        if (policy == EventPolicy::COALESCE && item.pool_block == POOL_BLOCK_NONE) {
+            return publish_coalesced(id, item, lane_mask);
+        }
+
+        esp_err_t result = ESP_OK;
+        for (uint8_t lane = 0; lane < EventBus::LANE_COUNT; ++lane) {
+            if (!(lane_mask & (1u << lane))) continue;
+            if (!enqueue(lane, item, policy)) {
+                pool_release(item.pool_block);
+                result = ESP_ERR_TIMEOUT;
+            }
+        }
+        return result;
+    }
+
+    void record_isr_latency(uint32_t latency_us) {
+        isr_last_latency_us.store(latency_us, std::memory_order_relaxed);
+        uint32_t max = isr_max_latency_us.load(std::memory_order_relaxed);
+        while (latency_us > max &&
+               !isr_max_latency_us.compare_exchange_weak(max, latency_us, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Розбирає кільця ISR-публікацій. Викликається лише диспетчером CONTROL.
+    void drain_isr_rings(const SubscriberTable* table) {
+        for (IsrRing& ring : isr_rings) {
+            uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+            while (tail != ring.head.load(std::memory_order_acquire)) {
+                const IsrRecord& rec = ring.records[tail % EventBus::ISR_RING_SIZE];
+                EventQueueItem item;
+                item.id = rec.id;
+                item.size = rec.size;
+                item.pool_block = POOL_BLOCK_NONE;
+                item.enqueue_us = static_cast<uint32_t>(rec.timestamp_us);
+                if (rec.size) memcpy(item.inline_data, rec.data, rec.size);
+                const int64_t timestamp_us = rec.timestamp_us;
+                ring.tail.store(++tail, std::memory_order_release);
+
+                const uint8_t lane_mask = event_types[item.id].lane_mask.load(std::memory_order_acquire);
+                // Іншим смугам подія йде звичайним шляхом публікації
+                const uint8_t other_lanes = lane_mask & ~(1u << CONTROL_LANE);
+                if (other_lanes) {
+                    publish_item(item.id, item, other_lanes);
+                } else {
+                    event_types[item.id].published.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (lane_mask & (1u << CONTROL_LANE)) {
+                    record_isr_latency(static_cast<uint32_t>(esp_timer_get_time() - timestamp_us));
+                    dispatch_item(CONTROL_LANE, item, table);
+                }
+            }
+        }
+    }
+
+    // Гарантовані події, що не влізли в чергу, і для смуги CONTROL - записи з переривань
+    void drain_pending(uint8_t lane, const SubscriberTable* table) {
+        EventQueueItem item;
+        while (reserve_pop(lane, item)) {
+            dispatch_item(lane, item, table);
+        }
+        if (lane == CONTROL_LANE) {
+            drain_isr_rings(table);
+        }
+    }
+
+    void event_handler_task(void* param) {
+        const uint8_t lane = static_cast<uint8_t>(reinterpret_cast<uintptr_t>(param));
+        QueueHandle_t queue = lane_queues[lane];
+
+        while (true) {
+            EventQueueItem item;
+            {
+                // Знімок тримаємо лише поки є робота, щоб не затримувати звільнення старих
+                const auto table = load_table();
+                drain_pending(lane, table.get());
+                if (lane == CONTROL_LANE) {
+                    // Взводимо прапорець і перевіряємо ще раз: запис, доданий між
+                    // першим розбором і взведенням, інакше чекав би наступної події
+                    isr_wake_armed.store(1, std::memory_order_seq_cst);
+                    drain_isr_rings(table.get());
+                }
+            }
+            if (xQueueReceive(queue, &item, portMAX_DELAY) == pdTRUE) {
+                // Пачка до DISPATCH_BATCH подій з одним знімком; новий беремо лише
+                // якщо підписки змінились посеред пачки
+                auto table = load_table();
+                size_t dispatched = 0;
+                do {
+                    if (!table || table->version != table_version.load(std::memory_order_acquire)) {
+                        table = load_table();
+                    }
+                    if (item.id == EVENT_ID_INVALID) {
+                        // Маркер пробудження: запис з переривання або подія в резерві - розбираємо одразу
+                        drain_pending(lane, table.get());
+                        continue;
+                    }
+                    if (lane == CONTROL_LANE) {
+                        // Записи з переривань не чекають за рештою пачки з черги
+                        drain_isr_rings(table.get());
+                    }
+                    dispatch_item(lane, item, table.get());
+                } while (++dispatched < EventBus::DISPATCH_BATCH && xQueueReceive(queue, &item, 0) == pdTRUE);
+            }
+        }
+    }
+}
+
+esp_err_t EventBus::init() {
+    return init(DEFAULT_LANES);
 }
 
-esp_err_t EventBus::init(size_t queue_size, uint32_t task_stack_size) {
+esp_err_t EventBus::init(const EventLaneConfig* lanes) {
+    if (!lanes) return ESP_ERR_INVALID_ARG;
     if (!subs_mutex) subs_mutex = xSemaphoreCreateMutex();
-    if (!event_queue) event_queue = xQueueCreate(queue_size, sizeof(EventQueueItem));
-    if (!event_task_handle) {
-        xTaskCreate(event_handler_task, "event_bus_task", task_stack_size, nullptr, 5, &event_task_handle);
+    if (!subs_mutex) return ESP_ERR_NO_MEM;
+
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+        const EventLaneConfig& cfg = lanes[lane];
+        if (!lane_queues[lane]) {
+            lane_queues[lane] = xQueueCreate(cfg.queue_size, sizeof(EventQueueItem));
+            if (!lane_queues[lane]) {
+                ESP_LOGE(TAG, "Не вдалося створити чергу смуги %u", (unsigned)lane);
+                return ESP_ERR_NO_MEM;
+            }
+            lane_queue_sizes[lane] = cfg.queue_size;
+        }
+        if (!lane_tasks[lane]) {
+            BaseType_t core = cfg.core_id == EVENT_LANE_ANY_CORE ? tskNO_AFFINITY : cfg.core_id;
+            if (xTaskCreatePinnedToCore(event_handler_task, LANE_TASK_NAMES[lane], cfg.task_stack_size,
+                                        reinterpret_cast<void*>(lane), cfg.task_priority,
+                                        &lane_tasks[lane], core) != pdPASS) {
+                ESP_LOGE(TAG, "Не вдалося створити задачу смуги %u", (unsigned)lane);
+                return ESP_ERR_NO_MEM;
+            }
+        }
+        ESP_LOGI(TAG, "Смуга %s: черга %u, пріоритет %u, ядро %d", LANE_TASK_NAMES[lane],
+                 (unsigned)cfg.queue_size, (unsigned)cfg.task_priority, cfg.core_id);
     }
     ESP_LOGI(TAG, "EventBus ініціалізовано");
     return ESP_OK;
 }
 
-esp_err_t EventBus::publish(const std::string& event_name, void* event_data) {
-    if (!event_queue) return ESP_FAIL;
-    EventQueueItem item{event_name, event_data};
-    if (xQueueSend(event_queue, &item, 0) != pdTRUE) {
-        ESP_LOGW(TAG, "Черга подій переповнена");
-        return ESP_ERR_TIMEOUT;
+EventId EventBus::intern(const char* event_name) {
+    if (!event_name || !event_name[0]) return EVENT_ID_INVALID;
+    if (is_pattern(event_name)) {
+        ESP_LOGE(TAG, "'%s' - шаблон, а не ім'я події", event_name);
+        return EVENT_ID_INVALID;
+    }
+
+    const uint32_t h = hash(event_name);
+    EventId id = find_event_id(event_name, h);
+    if (id != EVENT_ID_INVALID) return id;
+
+    if (!subs_mutex) {
+        ESP_LOGE(TAG, "intern(%s) до ініціалізації EventBus", event_name);
+        return EVENT_ID_INVALID;
+    }
+
+    if (xSemaphoreTake(subs_mutex, portMAX_DELAY) == pdTRUE) {
+        // Повторна перевірка: інша задача могла зареєструвати ім'я, поки ми чекали
+        id = find_event_id(event_name, h);
+        if (id == EVENT_ID_INVALID) {
+            uint16_t count = event_type_count.load(std::memory_order_relaxed);
+            if (count < MAX_EVENT_TYPES) {
+                EventType& type = event_types[count];
+                type.hash = h;
+                type.name = event_name;
+                // Нове ім'я одразу отримує підписників шаблонів, що йому відповідають
+                collect_pattern_subscribers(topic_root, split_topic(type.name), 0, type.subscribers);
+                if (!type.subscribers.empty()) commit_subscribers(count + 1);
+                event_type_count.store(count + 1, std::memory_order_release);
+                id = count;
+                ESP_LOGD(TAG, "Зареєстровано подію '%s' -> %u", event_name, id);
+            } else {
+                ESP_LOGE(TAG, "Таблиця подій заповнена, '%s' не зареєстровано", event_name);
+            }
+        }
+        xSemaphoreGive(subs_mutex);
+    }
+    return id;
+}
+
+const char* EventBus::name_of(EventId id) {
+    if (id >= event_type_count.load(std::memory_order_acquire)) return nullptr;
+    return event_types[id].name.c_str();
+}
+
+esp_err_t EventBus::publish(EventId id) {
+    return publish_copy(id, nullptr, 0);
+}
+
+esp_err_t EventBus::publish(const char* event_name) {
+    EventId id = intern(event_name);
+    if (id == EVENT_ID_INVALID) return ESP_ERR_INVALID_ARG;
+    return publish_copy(id, nullptr, 0);
+}
+
+esp_err_t EventBus::publish_copy(EventId id, const void* data, size_t size) {
+    if (!subs_mutex) return ESP_FAIL;
+    if (id >= event_type_count.load(std::memory_order_acquire)) return ESP_ERR_INVALID_ARG;
+    if (size > POOL_BLOCK_SIZE) return ESP_ERR_INVALID_SIZE;
+
+    // Немає підписників - нічого не ставимо в черги
+    const uint8_t lane_mask = event_types[id].lane_mask.load(std::memory_order_acquire);
+    if (lane_mask == 0) return ESP_OK;
+
+    EventQueueItem item;
+    item.id = id;
+    item.size = static_cast<uint8_t>(data ? size : 0);
+    item.pool_block = POOL_BLOCK_NONE;
+    item.enqueue_us = now_us();
+    if (item.size <= INLINE_PAYLOAD_SIZE) {
+        if (item.size) memcpy(item.inline_data, data, item.size);
+    } else {
+        item.pool_block = pool_acquire(static_cast<uint8_t>(__builtin_popcount(lane_mask)));
+        if (item.pool_block == POOL_BLOCK_NONE) {
+            event_types[id].published.fetch_add(1, std::memory_order_relaxed);
+            count_dropped(id);
+            ESP_LOGW(TAG, "Пул payload вичерпано, подію '%s' відкинуто", event_types[id].name.c_str());
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(pool_blocks[item.pool_block], data, item.size);
+    }
+
+    return publish_item(id, item, lane_mask);
+}
+
+esp_err_t EventBus::publish_from_isr(EventId id) {
+    return publish_isr_copy(id, nullptr, 0);
+}
+
+esp_err_t IRAM_ATTR EventBus::publish_isr_copy(EventId id, const void* data, size_t size) {
+    if (!lane_queues[CONTROL_LANE]) return ESP_ERR_INVALID_STATE;
+    if (id >= event_type_count.load(std::memory_order_acquire)) return ESP_ERR_INVALID_ARG;
+    if (size > INLINE_PAYLOAD_SIZE) return ESP_ERR_INVALID_SIZE;
+    if (event_types[id].lane_mask.load(std::memory_order_acquire) == 0) return ESP_OK;
+
+    IsrRing& ring = isr_rings[xPortGetCoreID()];
+    const uint32_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= ISR_RING_SIZE) {
+        isr_overflowed.fetch_add(1, std::memory_order_relaxed);
+        event_types[id].dropped.fetch_add(1, std::memory_order_relaxed);
+        return ESP_ERR_NO_MEM;
+    }
+
+    IsrRecord& rec = ring.records[head % ISR_RING_SIZE];
+    rec.id = id;
+    rec.size = static_cast<uint8_t>(data ? size : 0);
+    rec.timestamp_us = esp_timer_get_time();
+    if (rec.size) memcpy(rec.data, data, rec.size);
+    ring.head.store(head + 1, std::memory_order_release);
+    isr_published.fetch_add(1, std::memory_order_relaxed);
+
+    if (isr_wake_armed.exchange(0, std::memory_order_seq_cst)) {
+        // Маркер - у голову черги, щоб подія з переривання не чекала за телеметрією.
+        // Якщо черга повна, диспетчер і так не спить і розбере кільце на наступній ітерації.
+        const EventQueueItem marker = wake_marker();
+        BaseType_t task_woken = pdFALSE;
+        xQueueSendToFrontFromISR(lane_queues[CONTROL_LANE], &marker, &task_woken);
+        portYIELD_FROM_ISR(task_woken);
     }
     return ESP_OK;
 }
 
-EventSubscriptionHandle EventBus::subscribe(const std::string& event_name, EventCallback callback) {
+EventSubscriptionHandle EventBus::subscribe(EventId id, EventCallback callback, EventLane lane) {
+    if (id >= event_type_count.load(std::memory_order_acquire)) return 0;
+    if (static_cast<size_t>(lane) >= LANE_COUNT) return 0;
     EventSubscriptionHandle handle = next_handle++;
     if (xSemaphoreTake(subs_mutex, portMAX_DELAY) == pdTRUE) {
-        subscribers[event_name].emplace_back(handle, callback);
-        handle_to_key[handle] = event_name;
+        EventType& type = event_types[id];
+        auto sub = std::make_shared<Subscriber>();
+        sub->handle = handle;
+        sub->lane = static_cast<uint8_t>(lane);
+        sub->callback = std::move(callback);
+        type.subscribers.push_back(std::move(sub));
+        handle_to_id[handle] = id;
+        commit_subscribers(event_type_count.load(std::memory_order_acquire));
         xSemaphoreGive(subs_mutex);
     }
     return handle;
 }
 
+EventSubscriptionHandle EventBus::subscribe(const char* event_name, EventCallback callback, EventLane lane) {
+    if (event_name && is_pattern(event_name)) return subscribe_pattern(event_name, std::move(callback), lane);
+    EventId id = intern(event_name);
+    if (id == EVENT_ID_INVALID) return 0;
+    return subscribe(id, std::move(callback), lane);
+}
+
+EventSubscriptionHandle EventBus::subscribe_pattern(const char* pattern, EventCallback callback, EventLane lane) {
+    if (!subs_mutex || static_cast<size_t>(lane) >= LANE_COUNT) return 0;
+    const std::vector<std::string> segments = split_topic(pattern);
+    for (const auto& segment : segments) {
+        if (segment.empty() || (segment.find('*') != std::string::npos && segment != "*")) {
+            ESP_LOGE(TAG, "Некоректний шаблон підписки '%s'", pattern);
+            return 0;
+        }
+    }
+
+    EventSubscriptionHandle handle = next_handle++;
+    auto sub = std::make_shared<Subscriber>();
+    sub->handle = handle;
+    sub->lane = static_cast<uint8_t>(lane);
+    sub->callback = std::move(callback);
+    if (xSemaphoreTake(subs_mutex, portMAX_DELAY) == pdTRUE) {
+        TopicNode* node = &topic_root;
+        for (const auto& segment : segments) {
+            auto& child = node->children[segment];
+            if (!child) child.reset(new TopicNode());
+            node = child.get();
+        }
+        node->subscribers.push_back(sub);
+        handle_to_pattern[handle] = pattern;
+
+        // Уже зареєстровані імена, що відповідають шаблону
+        const uint16_t count = event_type_count.load(std::memory_order_acquire);
+        for (uint16_t id = 0; id < count; ++id) {
+            EventType& type = event_types[id];
+            if (topic_matches(segments, split_topic(type.name))) {
+                type.subscribers.push_back(sub);
+            }
+        }
+        commit_subscribers(count);
+        xSemaphoreGive(subs_mutex);
+    }
+    ESP_LOGD(TAG, "Підписка на шаблон '%s' -> %u", pattern, (unsigned)handle);
+    return handle;
+}
+
 void EventBus::unsubscribe(EventSubscriptionHandle handle) {
+    auto by_handle = [handle](const SubscriberPtr& s) { return s->handle == handle; };
     if (xSemaphoreTake(subs_mutex, portMAX_DELAY) == pdTRUE) {
-        auto it = handle_to_key.find(handle);
-        if (it != handle_to_key.end()) {
-            auto& vec = subscribers[it->second];
-            vec.erase(std::remove_if(vec.begin(), vec.end(), [handle](const auto& p) { return p.first == handle; }), vec.end());
-            handle_to_key.erase(it);
+        auto it = handle_to_id.find(handle);
+        if (it != handle_to_id.end()) {
+            EventType& type = event_types[it->second];
+            auto& vec = type.subscribers;
+            vec.erase(std::remove_if(vec.begin(), vec.end(), by_handle), vec.end());
+            handle_to_id.erase(it);
+        }
+
+        auto pit = handle_to_pattern.find(handle);
+        if (pit != handle_to_pattern.end()) {
+            // Порожні вузли дерева не видаляємо: шаблонів небагато і вони переважно статичні
+            TopicNode* node = &topic_root;
+            for (const auto& segment : split_topic(pit->second)) {
+                auto child = node->children.find(segment);
+                if (child == node->children.end()) {
+                    node = nullptr;
+                    break;
+                }
+                node = child->second.get();
+            }
+            if (node) {
+                auto& subs = node->subscribers;
+                subs.erase(std::remove_if(subs.begin(), subs.end(), by_handle), subs.end());
+            }
+            const uint16_t count = event_type_count.load(std::memory_order_acquire);
+            for (uint16_t id = 0; id < count; ++id) {
+                auto& vec = event_types[id].subscribers;
+                vec.erase(std::remove_if(vec.begin(), vec.end(), by_handle), vec.end());
+            }
+            handle_to_pattern.erase(pit);
         }
+        commit_subscribers(event_type_count.load(std::memory_order_acquire));
         xSemaphoreGive(subs_mutex);
     }
-} 
\ No newline at end of file
+}
+
+esp_err_t EventBus::set_policy(EventId id, EventPolicy policy) {
+    if (id >= event_type_count.load(std::memory_order_acquire)) return ESP_ERR_INVALID_ARG;
+    if (xSemaphoreTake(subs_mutex, portMAX_DELAY) != pdTRUE) return ESP_FAIL;
+
+    EventType& type = event_types[id];
+    if (policy == EventPolicy::COALESCE && !type.coalesce) {
+        type.coalesce = new (std::nothrow) CoalesceSlot();
+        if (!type.coalesce) {
+            xSemaphoreGive(subs_mutex);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    // Слот публікується раніше за політику (release), тож publish бачить його готовим
+    type.policy.store(static_cast<uint8_t>(policy), std::memory_order_release);
+    xSemaphoreGive(subs_mutex);
+
+    ESP_LOGD(TAG, "Політика події '%s': %u", type.name.c_str(), static_cast<unsigned>(policy));
+    return ESP_OK;
+}
+
+EventPolicyStats EventBus::get_policy_stats() {
+    EventPolicyStats stats;
+    stats.coalesced = stat_coalesced.load(std::memory_order_relaxed);
+    stats.dropped = stat_dropped.load(std::memory_order_relaxed);
+    stats.evicted = stat_evicted.load(std::memory_order_relaxed);
+    stats.spilled = stat_spilled.load(std::memory_order_relaxed);
+    stats.lost = stat_lost.load(std::memory_order_relaxed);
+    return stats;
+}
+
+EventIsrStats EventBus::get_isr_stats() {
+    EventIsrStats stats;
+    stats.published = isr_published.load(std::memory_order_relaxed);
+    stats.overflowed = isr_overflowed.load(std::memory_order_relaxed);
+    stats.last_latency_us = isr_last_latency_us.load(std::memory_order_relaxed);
+    stats.max_latency_us = isr_max_latency_us.load(std::memory_order_relaxed);
+    return stats;
+}
+
+namespace {
+    cJSON* histogram_to_json(const Histogram& hist) {
+        cJSON* obj = cJSON_CreateObject();
+        if (!obj) return nullptr;
+        cJSON* buckets = cJSON_AddArrayToObject(obj, "buckets");
+        uint32_t count = 0;
+        for (const auto& bucket : hist.buckets) {
+            const uint32_t n = bucket.load(std::memory_order_relaxed);
+            count += n;
+            if (buckets) cJSON_AddItemToArray(buckets, cJSON_CreateNumber(n));
+        }
+        cJSON_AddNumberToObject(obj, "count", count);
+        cJSON_AddNumberToObject(obj, "maxUs", hist.max_us.load(std::memory_order_relaxed));
+        return obj;
+    }
+}
+
+cJSON* EventBus::stats_to_json() {
+    cJSON* root = cJSON_CreateObject();
+    if (!root) return nullptr;
+
+    cJSON* lanes = cJSON_AddArrayToObject(root, "lanes");
+    for (uint8_t lane = 0; lanes && lane < LANE_COUNT; ++lane) {
+        cJSON* obj = cJSON_CreateObject();
+        if (!obj) break;
+        cJSON_AddStringToObject(obj, "name", LANE_TASK_NAMES[lane]);
+        cJSON_AddNumberToObject(obj, "queueSize", lane_queue_sizes[lane]);
+        cJSON_AddNumberToObject(obj, "waiting", lane_queues[lane] ? uxQueueMessagesWaiting(lane_queues[lane]) : 0);
+        cJSON_AddNumberToObject(obj, "highWatermark", lane_high_watermark[lane].load(std::memory_order_relaxed));
+        cJSON_AddItemToObject(obj, "latencyUs", histogram_to_json(lane_latency[lane]));
+        cJSON_AddItemToArray(lanes, obj);
+    }
+
+    const uint16_t count = event_type_count.load(std::memory_order_acquire);
+    cJSON* events = cJSON_AddArrayToObject(root, "events");
+    for (uint16_t id = 0; events && id < count; ++id) {
+        const EventType& type = event_types[id];
+        cJSON* obj = cJSON_CreateObject();
+        if (!obj) break;
+        cJSON_AddNumberToObject(obj, "id", id);
+        cJSON_AddStringToObject(obj, "name", type.name.c_str());
+        cJSON_AddNumberToObject(obj, "published", type.published.load(std::memory_order_relaxed));
+        cJSON_AddNumberToObject(obj, "delivered", type.delivered.load(std::memory_order_relaxed));
+        cJSON_AddNumberToObject(obj, "dropped", type.dropped.load(std::memory_order_relaxed));
+        cJSON_AddNumberToObject(obj, "coalesced", type.coalesced.load(std::memory_order_relaxed));
+        cJSON_AddItemToArray(events, obj);
+    }
+
+    // Підписників читаємо зі знімка - без subs_mutex
+    const auto table = load_table();
+    cJSON* subscribers = cJSON_AddArrayToObject(root, "subscribers");
+    for (size_t slot = 0; table && subscribers && slot < static_cast<size_t>(count) * LANE_COUNT; ++slot) {
+        for (size_t i = table->offsets[slot]; i < table->offsets[slot + 1]; ++i) {
+            const Subscriber& sub = *table->subscribers[i];
+            cJSON* obj = cJSON_CreateObject();
+            if (!obj) break;
+            cJSON_AddNumberToObject(obj, "handle", sub.handle);
+            cJSON_AddStringToObject(obj, "event", event_types[slot / LANE_COUNT].name.c_str());
+            cJSON_AddStringToObject(obj, "lane", LANE_TASK_NAMES[sub.lane]);
+            cJSON_AddItemToObject(obj, "execUs", histogram_to_json(sub.exec_time));
+            cJSON_AddItemToArray(subscribers, obj);
+        }
+    }
+
+    const EventPolicyStats policy = get_policy_stats();
+    cJSON* policy_obj = cJSON_AddObjectToObject(root, "policy");
+    if (policy_obj) {
+        cJSON_AddNumberToObject(policy_obj, "coalesced", policy.coalesced);
+        cJSON_AddNumberToObject(policy_obj, "dropped", policy.dropped);
+        cJSON_AddNumberToObject(policy_obj, "evicted", policy.evicted);
+        cJSON_AddNumberToObject(policy_obj, "spilled", policy.spilled);
+        cJSON_AddNumberToObject(policy_obj, "lost", policy.lost);
+    }
+
+    const EventIsrStats isr = get_isr_stats();
+    cJSON* isr_obj = cJSON_AddObjectToObject(root, "isr");
+    if (isr_obj) {
+        cJSON_AddNumberToObject(isr_obj, "published", isr.published);
+        cJSON_AddNumberToObject(isr_obj, "overflowed", isr.overflowed);
+        cJSON_AddNumberToObject(isr_obj, "lastLatencyUs", isr.last_latency_us);
+        cJSON_AddNumberToObject(isr_obj, "maxLatencyUs", isr.max_latency_us);
+    }
+    return root;
+}
@@ -5,18 +5,228 @@
 #include <string>
 #include <map>
 #include <vector>
-#include <functional>
 #include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include "inplace_function.h"
 
-using EventCallback = std::function<void(const std::string& event_name, void* event_data)>;
+struct cJSON;
+
+// event_data вказує на копію payload, що належить шині і валідна лише під час виклику.
+// Без купи: захоплення лямбди має влазити в буфер InplaceFunction.
+using EventCallback = InplaceFunction<void(const std::string& event_name, const void* event_data)>;
 using EventSubscriptionHandle = uint32_t;
 
+// Компактний ідентифікатор типу події (індекс у таблиці зареєстрованих імен)
+using EventId = uint16_t;
+static constexpr EventId EVENT_ID_INVALID = 0xFFFF;
+
+/**
+ * @brief Смуги пріоритету доставки подій.
+ *
+ * Кожна смуга має власну чергу і задачу-диспетчер, тому повільний підписник
+ * телеметрії (WebSocket, логування) не затримує події керування.
+ */
+enum class EventLane : uint8_t {
+    CONTROL = 0,    ///< Критичні для керування обладнанням (компресор, розморожування)
+    NORMAL = 1,     ///< Звичайні системні події
+    TELEMETRY = 2,  ///< UI, WebSocket, статистика
+};
+
+static constexpr int EVENT_LANE_ANY_CORE = -1;
+
+/**
+ * @brief Політика поведінки при переповненні черги для типу події
+ */
+enum class EventPolicy : uint8_t {
+    DROP_NEWEST = 0,  ///< Нову подію відкидаємо (поведінка за замовчуванням)
+    DROP_OLDEST,      ///< Витісняємо найстарішу подію з черги смуги
+    COALESCE,         ///< У черзі тримаємо лише останнє значення (payload до INLINE_PAYLOAD_SIZE)
+    MUST_DELIVER,     ///< Не губимо: резервний буфер смуги, далі - коротке блокування (крім задач-диспетчерів)
+};
+
+/**
+ * @brief Лічильники спрацювань політик переповнення
+ */
+struct EventPolicyStats {
+    uint32_t coalesced;   ///< Значень замінено новішими до доставки (COALESCE)
+    uint32_t dropped;     ///< Нових подій відкинуто через переповнення
+    uint32_t evicted;     ///< Старих подій витіснено з черги (DROP_OLDEST)
+    uint32_t spilled;     ///< Подій MUST_DELIVER збережено в резервний буфер
+    uint32_t lost;        ///< Подій MUST_DELIVER втрачено попри резерв і очікування
+};
+
+/**
+ * @brief Лічильники ISR-публікацій і затримки від переривання до обробника
+ */
+struct EventIsrStats {
+    uint32_t published;         ///< Записів покладено в буфери з переривань
+    uint32_t overflowed;        ///< Записів відкинуто через заповнений буфер
+    uint32_t last_latency_us;   ///< Остання затримка переривання -> диспетчер CONTROL (мкс)
+    uint32_t max_latency_us;    ///< Максимальна зафіксована затримка (мкс)
+};
+
+/**
+ * @brief Параметри смуги: глибина черги та задача-диспетчер
+ */
+struct EventLaneConfig {
+    size_t queue_size;          ///< Глибина черги смуги
+    uint32_t task_stack_size;   ///< Стек задачі-диспетчера (байт)
+    uint32_t task_priority;     ///< Пріоритет FreeRTOS задачі-диспетчера
+    int core_id;                ///< Ядро ESP32 (0/1) або EVENT_LANE_ANY_CORE
+};
+
 class EventBus {
 public:
-    static esp_err_t init(size_t queue_size = 10, uint32_t task_stack_size = 4096);
-    static esp_err_t publish(const std::string& event_name, void* event_data = nullptr);
-    static EventSubscriptionHandle subscribe(const std::string& event_name, EventCallback callback);
+    // Максимальна кількість різних імен подій у системі
+    static constexpr size_t MAX_EVENT_TYPES = 64;
+    // Payload до цього розміру копіюється прямо в елемент черги
+    static constexpr size_t INLINE_PAYLOAD_SIZE = 24;
+    // Більші payload копіюються в блоки попередньо виділеного пулу
+    static constexpr size_t POOL_BLOCK_SIZE = 128;
+    static constexpr size_t POOL_BLOCK_COUNT = 8;
+    static constexpr size_t PAYLOAD_ALIGN = 8;
+    static constexpr size_t LANE_COUNT = 3;
+    // Ємність резервного буфера смуги для подій MUST_DELIVER
+    static constexpr size_t RESERVE_SIZE = 8;
+    // Максимальне очікування місця в черзі для MUST_DELIVER, коли резерв заповнено.
+    // Задачі-диспетчери (підписники, пересилання ISR-записів) не чекають - подія рахується як lost
+    static constexpr uint32_t MUST_DELIVER_TIMEOUT_MS = 50;
+    // Скільки подій диспетчер розбирає за одне пробудження з одним знімком підписників
+    static constexpr size_t DISPATCH_BATCH = 8;
+    // Ємність кільцевого буфера ISR-публікацій одного ядра (степінь двійки)
+    static constexpr size_t ISR_RING_SIZE = 16;
+
+    /**
+     * @brief Ініціалізує шину з конфігурацією смуг за замовчуванням
+     */
+    static esp_err_t init();
+
+    /**
+     * @brief Ініціалізує шину із заданою конфігурацією смуг
+     *
+     * @param lanes Масив з LANE_COUNT елементів, індексований EventLane
+     */
+    static esp_err_t init(const EventLaneConfig* lanes);
+
+    /**
+     * @brief FNV-1a хеш імені події.
+     *
+     * constexpr - для літералів обчислюється на етапі компіляції.
+     */
+    static constexpr uint32_t hash(const char* name) {
+        uint32_t h = 2166136261u;
+        while (name && *name) {
+            h ^= static_cast<uint8_t>(*name++);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    /**
+     * @brief Повертає ідентифікатор для імені події, реєструючи його за потреби.
+     *
+     * Виклик варто робити один раз (наприклад, в init() модуля) і далі
+     * публікувати/підписуватись за EventId - без рядків і алокацій.
+     *
+     * @return EventId або EVENT_ID_INVALID, якщо таблиця заповнена чи шина не ініціалізована
+     */
+    static EventId intern(const char* event_name);
+
+    /**
+     * @brief Повертає ім'я події за ідентифікатором (nullptr для невідомого id)
+     */
+    static const char* name_of(EventId id);
+
+    /**
+     * @brief Публікує подію без даних
+     */
+    static esp_err_t publish(EventId id);
+    static esp_err_t publish(const char* event_name);
+
+    /**
+     * @brief Публікує подію з payload, який копіюється за значенням.
+     *
+     * Дані копіюються в слот елемента черги (або в блок пулу, якщо не влазять),
+     * тож можна передавати локальні змінні - після повернення вони шині не потрібні.
+     * Підписник отримує вказівник на копію типу T.
+     */
+    template <typename T>
+    static esp_err_t publish(EventId id, const T& payload) {
+        static_assert(!std::is_pointer_v<T>, "Payload передається за значенням, а не вказівником");
+        static_assert(std::is_trivially_copyable_v<T>, "Payload події має бути тривіально копійованим");
+        static_assert(sizeof(T) <= POOL_BLOCK_SIZE, "Payload події більший за блок пулу");
+        static_assert(alignof(T) <= PAYLOAD_ALIGN, "Непідтримуване вирівнювання payload");
+        return publish_copy(id, &payload, sizeof(T));
+    }
+
+    template <typename T>
+    static esp_err_t publish(const char* event_name, const T& payload) {
+        EventId id = intern(event_name);
+        if (id == EVENT_ID_INVALID) return ESP_ERR_INVALID_ARG;
+        return publish(id, payload);
+    }
+
+    /**
+     * @brief Публікує подію з обробника переривання.
+     *
+     * Без м'ютексів, алокацій і рядків: запис копіюється в кільцевий буфер
+     * поточного ядра, який розбирає диспетчер смуги CONTROL. Виробник на ядрі
+     * має бути один (переривання одного рівня, напр. сервіс GPIO ISR).
+     * EventId отримуйте через intern() заздалегідь, поза перериванням.
+     *
+     * @return ESP_OK, ESP_ERR_INVALID_ARG або ESP_ERR_NO_MEM, якщо буфер заповнено
+     */
+    template <typename T>
+    static esp_err_t publish_from_isr(EventId id, const T& payload) {
+        static_assert(!std::is_pointer_v<T>, "Payload передається за значенням, а не вказівником");
+        static_assert(std::is_trivially_copyable_v<T>, "Payload події має бути тривіально копійованим");
+        static_assert(sizeof(T) <= INLINE_PAYLOAD_SIZE, "Payload ISR-події має влазити в inline-слот");
+        static_assert(alignof(T) <= PAYLOAD_ALIGN, "Непідтримуване вирівнювання payload");
+        return publish_isr_copy(id, &payload, sizeof(T));
+    }
+    static esp_err_t publish_from_isr(EventId id);
+
+    /**
+     * @brief Повертає лічильники ISR-публікацій і виміряну затримку доставки
+     */
+    static EventIsrStats get_isr_stats();
+
+    /**
+     * @brief Знімок інструментування шини у вигляді JSON.
+     *
+     * Лічильники по типах подій (published/delivered/dropped/coalesced), глибина
+     * і high-watermark черг смуг, log2-гістограми (кошик i - [2^i, 2^(i+1)) мкс)
+     * затримки публікація -> диспетчер і часу виконання кожного підписника.
+     *
+     * @return Новий об'єкт cJSON (звільняє викликач) або nullptr при нестачі пам'яті
+     */
+    static cJSON* stats_to_json();
+
+    /**
+     * @brief Підписка на подію. Callback виконується задачею-диспетчером вказаної смуги.
+     *
+     * Ім'я може бути шаблоном: '*' відповідає рівно одному сегменту між крапками
+     * ("cooling.*", "*.mode_changed"). Шаблон охоплює і вже зареєстровані, і майбутні імена.
+     */
+    static EventSubscriptionHandle subscribe(EventId id, EventCallback callback, EventLane lane = EventLane::NORMAL);
+    static EventSubscriptionHandle subscribe(const char* event_name, EventCallback callback, EventLane lane = EventLane::NORMAL);
     static void unsubscribe(EventSubscriptionHandle handle);
+
+    /**
+     * @brief Встановлює політику переповнення для типу події
+     */
+    static esp_err_t set_policy(EventId id, EventPolicy policy);
+
+    /**
+     * @brief Повертає накопичені лічильники політик переповнення
+     */
+    static EventPolicyStats get_policy_stats();
+
+private:
+    static esp_err_t publish_copy(EventId id, const void* data, size_t size);
+    static esp_err_t publish_isr_copy(EventId id, const void* data, size_t size);
+    static EventSubscriptionHandle subscribe_pattern(const char* pattern, EventCallback callback, EventLane lane);
 };
 
-#endif // CORE_EVENT_BUS_H 
\ No newline at end of file
+#endif // CORE_EVENT_BUS_H
\ No newline at end of file
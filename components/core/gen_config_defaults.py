@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""Генерує config_defaults.h з default_config.json під час збірки.
+
+Результат:
+  - constexpr-структура Defaults (вкладені структури для об'єктів) і
+    екземпляр DEFAULTS - дефолти без розбору JSON і без купи;
+  - ConfigField<T> для кожного значення: шлях, позиція в ENTRIES (вона ж
+    хендл ConfigPath у плоскому індексі ConfigLoader) і дефолт. Помилка в
+    імені поля - помилка компіляції, а не тихий default;
+  - таблиця ENTRIES, з якої ConfigLoader будує дерево дефолтів.
+
+Використання: gen_config_defaults.py <default_config.json> <config_defaults.h>
+"""
+
+import json
+import os
+import re
+import sys
+
+
+def identifier(key):
+    name = re.sub(r"[^0-9A-Za-z_]", "_", key)
+    if not name or name[0].isdigit():
+        name = "_" + name
+    return name
+
+
+def struct_name(key):
+    return "".join(part[:1].upper() + part[1:] for part in identifier(key).split("_") if part) or "Node"
+
+
+def cpp_string(value):
+    return json.dumps(value, ensure_ascii=False)
+
+
+def scalar(value):
+    """(тип поля, тип ConfigValueType, C++ літерал) для скалярного значення."""
+    if isinstance(value, bool):
+        return "bool", "BOOL", "true" if value else "false"
+    if isinstance(value, int):
+        return "int", "INT", str(value)
+    if isinstance(value, float):
+        return "float", "FLOAT", repr(value) + "f"
+    if isinstance(value, str):
+        return "const char*", "STRING", cpp_string(value)
+    raise ValueError("непідтримуване значення: %r" % (value,))
+
+
+class Generator:
+    def __init__(self):
+        self.fields = []   # (CONSTANT, тип, шлях, позиція в ENTRIES, літерал)
+        self.entries = []  # (шлях, ConfigValueType, зміщення)
+        self.constants = set()
+
+    def struct(self, obj, name, path, member_path, indent):
+        pad = "    " * indent
+        lines = [pad + "struct %s {" % name]
+        for key, value in obj.items():
+            member = identifier(key)
+            child_path = path + "/" + key
+            child_member = member_path + [member]
+            if isinstance(value, dict):
+                lines += self.struct(value, struct_name(key), child_path, child_member, indent + 1)
+                lines.append(pad + "    %s %s{};" % (struct_name(key), member))
+                continue
+            if isinstance(value, list) or value is None:
+                raise ValueError("%s: масиви і null у дефолтах не підтримуються" % child_path)
+            cpp_type, value_type, literal = scalar(value)
+            lines.append(pad + "    %s %s = %s;" % (cpp_type, member, literal))
+
+            constant = "_".join(m.upper() for m in child_member)
+            if constant in self.constants:
+                raise ValueError("%s: конфлікт імені %s" % (child_path, constant))
+            self.constants.add(constant)
+            offset = "offsetof(Defaults, %s)" % ".".join(child_member)
+            self.fields.append((constant, cpp_type, child_path, len(self.entries), literal))
+            self.entries.append((child_path, value_type, offset))
+        lines.append(pad + "};")
+        return lines
+
+
+def generate(source_path):
+    with open(source_path, encoding="utf-8") as f:
+        defaults = json.load(f)
+    if not isinstance(defaults, dict):
+        raise ValueError("кореневий елемент має бути об'єктом")
+
+    gen = Generator()
+    struct_lines = gen.struct(defaults, "Defaults", "", [], 0)
+    if len(gen.entries) >= 0xFFFF:
+        raise ValueError("забагато значень для індексу ConfigPath")
+
+    out = [
+        "// Згенеровано gen_config_defaults.py з %s - не редагувати вручну" % os.path.basename(source_path),
+        "#ifndef CORE_CONFIG_DEFAULTS_H",
+        "#define CORE_CONFIG_DEFAULTS_H",
+        "",
+        "#include <cstddef>",
+        '#include "config.h"',
+        "",
+        "namespace config_defaults {",
+        "",
+    ]
+    out += struct_lines
+    out += [
+        "",
+        "inline constexpr Defaults DEFAULTS{};",
+        "",
+        "// Типізовані поля: ConfigLoader::get(config_defaults::CONTROL_SET_TEMP)",
+    ]
+    for constant, cpp_type, path, index, literal in gen.fields:
+        out.append("inline constexpr ConfigField<%s> %s{%s, %d, %s};"
+                   % (cpp_type, constant, cpp_string(path), index, literal))
+    out += [
+        "",
+        "// Усі значення в порядку default_config.json; позиція - ConfigField::index",
+        "inline constexpr ConfigDefaultEntry ENTRIES[] = {",
+    ]
+    for path, value_type, offset in gen.entries:
+        out.append("    {%s, ConfigValueType::%s, %s}," % (cpp_string(path), value_type, offset))
+    out += [
+        "};",
+        "",
+        "} // namespace config_defaults",
+        "",
+        "#endif // CORE_CONFIG_DEFAULTS_H",
+        "",
+    ]
+    return "\n".join(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write(__doc__)
+        return 2
+    source, target = sys.argv[1], sys.argv[2]
+    try:
+        content = generate(source)
+    except (OSError, ValueError) as err:
+        sys.stderr.write("gen_config_defaults: %s: %s\n" % (source, err))
+        return 1
+
+    # Не перезаписуємо незмінений файл, щоб не перезбирати залежні джерела
+    if os.path.exists(target):
+        with open(target, encoding="utf-8") as f:
+            if f.read() == content:
+                return 0
+    os.makedirs(os.path.dirname(os.path.abspath(target)), exist_ok=True)
+    with open(target, "w", encoding="utf-8") as f:
+        f.write(content)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,125 @@
+#ifndef CORE_INPLACE_FUNCTION_H
+#define CORE_INPLACE_FUNCTION_H
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Місткість буфера за замовчуванням: вказівник this і ще кілька слів захоплення
+static constexpr size_t INPLACE_FUNCTION_DEFAULT_CAPACITY = 16;
+
+template <typename Signature, size_t Capacity = INPLACE_FUNCTION_DEFAULT_CAPACITY>
+class InplaceFunction;
+
+/**
+ * @brief Замінник std::function без купи.
+ *
+ * Callable зберігається у вбудованому буфері фіксованого розміру Capacity.
+ * Якщо захоплення лямбди не влазить - помилка компіляції, а не алокація.
+ * Лише переміщення: копіювати callback на кожен виклик не потрібно,
+ * тож власник тримає один екземпляр і передає його за вказівником.
+ */
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> {
+public:
+    InplaceFunction() noexcept = default;
+    InplaceFunction(std::nullptr_t) noexcept {}
+
+    template <typename F,
+              typename Fn = std::decay_t<F>,
+              typename = std::enable_if_t<!std::is_same_v<Fn, InplaceFunction> &&
+                                          std::is_invocable_r_v<R, Fn&, Args...>>>
+    InplaceFunction(F&& f) {
+        static_assert(sizeof(Fn) <= Capacity, "Захоплення не влазить у буфер InplaceFunction - збільште Capacity");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "Непідтримуване вирівнювання callable");
+        static_assert(std::is_nothrow_move_constructible_v<Fn>, "Callable має переміщуватись без винятків");
+        if constexpr (std::is_pointer_v<Fn>) {
+            if (is_null(f)) return; // Порожній вказівник на функцію - порожній callback
+        }
+        new (&storage_) Fn(std::forward<F>(f));
+        ops_ = &OpsFor<Fn>::ops;
+    }
+
+    InplaceFunction(InplaceFunction&& other) noexcept {
+        move_from(other);
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other) noexcept {
+        if (this != &other) {
+            reset();
+            move_from(other);
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    InplaceFunction(const InplaceFunction&) = delete;
+    InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+    ~InplaceFunction() {
+        reset();
+    }
+
+    explicit operator bool() const noexcept {
+        return ops_ != nullptr;
+    }
+
+    R operator()(Args... args) const {
+        assert(ops_ && "Виклик порожнього InplaceFunction");
+        return ops_->invoke(&storage_, std::forward<Args>(args)...);
+    }
+
+private:
+    struct Ops {
+        R (*invoke)(void* storage, Args&&... args);
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void* storage);
+    };
+
+    template <typename Fn>
+    struct OpsFor {
+        static R invoke(void* storage, Args&&... args) {
+            return (*static_cast<Fn*>(storage))(std::forward<Args>(args)...);
+        }
+        static void move(void* dst, void* src) {
+            new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        }
+        static void destroy(void* storage) {
+            static_cast<Fn*>(storage)->~Fn();
+        }
+        static constexpr Ops ops = {&invoke, &move, &destroy};
+    };
+
+    template <typename Fn>
+    static bool is_null(Fn fn) noexcept {
+        return fn == nullptr;
+    }
+
+    void move_from(InplaceFunction& other) noexcept {
+        if (other.ops_) {
+            other.ops_->move(&storage_, &other.storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    void reset() noexcept {
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    // mutable: як і std::function, const-виклик допускає mutable-лямбди
+    alignas(std::max_align_t) mutable unsigned char storage_[Capacity];
+    const Ops* ops_ = nullptr;
+};
+
+#endif // CORE_INPLACE_FUNCTION_H
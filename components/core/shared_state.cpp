@@ -2,18 +2,353 @@
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "nvs.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <new>
+#include <vector>
 
 // Ініціалізація статичних членів класу
-std::map<std::string, ValueType> SharedState::state_map;
-std::map<std::string, std::vector<std::pair<SubscriptionHandle, StateCallback>>> SharedState::subscribers;
-std::map<SubscriptionHandle, std::string> SharedState::handle_to_key;
 SemaphoreHandle_t SharedState::state_mutex_handle = nullptr;
 std::atomic<uint32_t> SharedState::next_handle{1};
 const char* SharedState::TAG = "SharedState";
 
+namespace {
+    // Похідне значення: функція обчислення, спільна для конкурентних читачів
+    struct DerivedState {
+        StateDeriveFunc compute;
+        std::vector<StateHandle> sources;
+    };
+
+    // Маркер порожнього слота (ключ оголошено, значення ще не записано)
+    constexpr uint8_t TYPE_NONE = 0xFF;
+    constexpr uint8_t TYPE_STRING = SharedState::type_index<std::string>();
+
+    /**
+     * Слот ключа. Числові значення зберігаються як біти в атомарних словах
+     * і захищені лічильником послідовності (seqlock): непарний seq - запис
+     * у процесі, читач повторює спробу. Рядок і підписники - під м'ютексом.
+     */
+    struct Slot {
+        std::string name;
+        uint32_t hash = 0;
+        std::atomic<uint32_t> seq{0};
+        std::atomic<uint8_t> type{TYPE_NONE};
+        std::atomic<uint32_t> bits_lo{0};
+        std::atomic<uint32_t> bits_hi{0};
+        std::string str;
+        std::vector<StateSubscriberPtr> subscribers;
+        // Підписники StateDelivery::ASYNC - викликаються задачею-нотифікатором
+        std::vector<StateSubscriberPtr> async_subscribers;
+        // Мертва зона: зміна числа менша за неї не сповіщає підписників
+        float deadband = 0.0f;
+        // Останнє значення, про яке сповіщено (база для мертвої зони)
+        uint8_t notified_type = TYPE_NONE;
+        uint64_t notified_bits = 0;
+        // Глобальна версія останньої зміни значення
+        uint32_t version = 0;
+        // Значення зберігається в NVS; persist_dirty - зміна ще не записана
+        bool persistent = false;
+        bool persist_dirty = false;
+        // Похідний ключ: stale - джерело змінилось, значення треба перерахувати
+        std::shared_ptr<DerivedState> derived;
+        std::atomic<bool> stale{false};
+        // Похідні ключі, що залежать від цього
+        std::vector<StateHandle> dependents;
+    };
+
+    // Блоки слотів не звільняються: читачі без м'ютекса можуть тримати адресу
+    Slot* slot_chunks[SharedState::MAX_SLOT_CHUNKS] = {};
+    // Кількість опублікованих слотів (release після повної ініціалізації слота)
+    std::atomic<uint16_t> slot_count{0};
+    // Назва -> хендл, лише під м'ютексом
+    std::map<std::string, StateHandle> key_index;
+    // Відкрита адресація за хешем назви: пошук без м'ютекса і без алокацій.
+    // Записи лише додаються (під м'ютексом) і публікуються після слота
+    constexpr size_t HASH_TABLE_SIZE = SharedState::MAX_KEYS * 2;
+    std::atomic<StateHandle> hash_table[HASH_TABLE_SIZE];
+    // Хендл підписки -> слот (для швидкої відписки)
+    std::map<SubscriptionHandle, StateHandle> handle_to_slot;
+    // Записи, що не дійшли до підписників (значення не змінилось або в мертвій зоні)
+    std::atomic<uint32_t> suppressed_notifications{0};
+    // Похідні ключі: записи лише додаються (під м'ютексом), лічильник публікується після запису
+    std::atomic<StateHandle> derived_handles[SharedState::MAX_DERIVED_KEYS];
+    std::atomic<uint16_t> derived_count{0};
+    // Глобальна версія: зростає на кожну фактичну зміну будь-якого ключа
+    std::atomic<uint32_t> global_version{0};
+    // Епоха версій: global_version відлічується з нуля після кожного init()
+    std::atomic<uint32_t> boot_epoch{0};
+    // Брудні ключі з асинхронними підписниками: біт на слот
+    constexpr size_t DIRTY_WORDS = SharedState::MAX_KEYS / 32;
+    std::atomic<uint32_t> dirty_bitmap[DIRTY_WORDS] = {};
+    TaskHandle_t notifier_task_handle = nullptr;
+    // Запис seqlock не має витіснятись читачем на тому ж ядрі
+    portMUX_TYPE slot_write_mux = portMUX_INITIALIZER_UNLOCKED;
+
+    // --- Збереження persistent-ключів у NVS (усе нижче - під м'ютексом) ---
+    constexpr const char* PERSIST_NAMESPACE = "state";
+    constexpr StatePersistConfig DEFAULT_PERSIST_CONFIG = {
+        .flush_interval_ms = 1000,
+        .max_dirty_age_ms = 60000,
+    };
+    StatePersistConfig persist_config = DEFAULT_PERSIST_CONFIG;
+    StatePersistStats persist_stats = {};
+    // Час першої незбереженої зміни (0 - брудних ключів немає)
+    int64_t oldest_dirty_us = 0;
+    // Значення, прочитані з NVS в init() і ще не затребувані set_persistent()
+    std::map<std::string, std::vector<uint8_t>> restored_blobs;
+    TaskHandle_t persist_task_handle = nullptr;
+
+    Slot* slot_at(StateHandle handle) {
+        if (handle >= slot_count.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &slot_chunks[handle / SharedState::SLOT_CHUNK_SIZE][handle % SharedState::SLOT_CHUNK_SIZE];
+    }
+
+    // Біти числового значення варіанту; false для рядка
+    template <size_t I = 0>
+    bool scalar_bits(const ValueType& value, uint64_t& bits) {
+        if constexpr (I == std::variant_size_v<ValueType>) {
+            return false;
+        } else {
+            using T = std::variant_alternative_t<I, ValueType>;
+            if constexpr (!std::is_same_v<T, std::string>) {
+                if (auto v = std::get_if<I>(&value)) {
+                    bits = 0;
+                    std::memcpy(&bits, v, sizeof(T));
+                    return true;
+                }
+            }
+            return scalar_bits<I + 1>(value, bits);
+        }
+    }
+
+    // Числове значення як double для порівняння з мертвою зоною (bool - ні)
+    template <size_t I = 0>
+    bool scalar_as_double(uint8_t type, uint64_t bits, double& out) {
+        if constexpr (I == std::variant_size_v<ValueType>) {
+            return false;
+        } else {
+            using T = std::variant_alternative_t<I, ValueType>;
+            if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>) {
+                if (type == I) {
+                    T v;
+                    std::memcpy(&v, &bits, sizeof(T));
+                    out = static_cast<double>(v);
+                    return true;
+                }
+            }
+            return scalar_as_double<I + 1>(type, bits, out);
+        }
+    }
+
+    // Зворотне перетворення: числове значення з бітів слота
+    template <size_t I = 0>
+    ValueType scalar_value(uint8_t type, uint64_t bits) {
+        if constexpr (I == std::variant_size_v<ValueType>) {
+            return ValueType{};
+        } else {
+            using T = std::variant_alternative_t<I, ValueType>;
+            if constexpr (!std::is_same_v<T, std::string>) {
+                if (type == I) {
+                    T v;
+                    std::memcpy(&v, &bits, sizeof(T));
+                    return ValueType(std::in_place_index<I>, v);
+                }
+            }
+            return scalar_value<I + 1>(type, bits);
+        }
+    }
+
+    // Біти слота для сторони запису (під м'ютексом, seqlock не потрібен)
+    uint64_t slot_bits(const Slot& slot) {
+        return (static_cast<uint64_t>(slot.bits_hi.load(std::memory_order_relaxed)) << 32) |
+               slot.bits_lo.load(std::memory_order_relaxed);
+    }
+
+    // Поточне значення слота як ValueType (під м'ютексом)
+    bool slot_value(const Slot& slot, ValueType& out) {
+        uint8_t stored_type = slot.type.load(std::memory_order_relaxed);
+        if (stored_type == TYPE_NONE) {
+            return false;
+        }
+        if (stored_type == TYPE_STRING) {
+            out = slot.str;
+        } else {
+            out = scalar_value(stored_type, slot_bits(slot));
+        }
+        return true;
+    }
+
+    // Ключ NVS обмежений 15 символами, тож зберігаємо під хешем повної назви
+    std::string persist_key(const std::string& name) {
+        char buf[NVS_KEY_NAME_MAX_SIZE];
+        snprintf(buf, sizeof(buf), "s%08" PRIx32, state_key_hash(name.c_str()));
+        return buf;
+    }
+
+    // Формат blob: байт типу (індекс у ValueType) + 8 байт бітів або байти рядка
+    std::vector<uint8_t> encode_slot(const Slot& slot) {
+        uint8_t type = slot.type.load(std::memory_order_relaxed);
+        if (type == TYPE_STRING) {
+            std::vector<uint8_t> blob(1 + slot.str.size(), type);
+            std::memcpy(blob.data() + 1, slot.str.data(), slot.str.size());
+            return blob;
+        }
+        uint64_t bits = slot_bits(slot);
+        std::vector<uint8_t> blob(1 + sizeof(bits), type);
+        std::memcpy(blob.data() + 1, &bits, sizeof(bits));
+        return blob;
+    }
+
+    bool decode_blob(const std::vector<uint8_t>& blob, ValueType& out) {
+        if (blob.empty() || blob[0] >= std::variant_size_v<ValueType>) {
+            return false;
+        }
+        if (blob[0] == TYPE_STRING) {
+            out = std::string(blob.begin() + 1, blob.end());
+            return true;
+        }
+        uint64_t bits = 0;
+        if (blob.size() != 1 + sizeof(bits)) {
+            return false;
+        }
+        std::memcpy(&bits, blob.data() + 1, sizeof(bits));
+        out = scalar_value(blob[0], bits);
+        return true;
+    }
+
+    // Масове читання всіх збережених значень простору імен
+    void load_persisted() {
+        restored_blobs.clear();
+        nvs_handle_t nvs;
+        if (nvs_open(PERSIST_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+            return; // Простору імен ще немає - нічого не зберігали
+        }
+        nvs_iterator_t it = nullptr;
+        esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, PERSIST_NAMESPACE, NVS_TYPE_BLOB, &it);
+        while (err == ESP_OK) {
+            nvs_entry_info_t info;
+            nvs_entry_info(it, &info);
+            size_t len = 0;
+            if (nvs_get_blob(nvs, info.key, nullptr, &len) == ESP_OK && len > 0) {
+                std::vector<uint8_t> blob(len);
+                if (nvs_get_blob(nvs, info.key, blob.data(), &len) == ESP_OK) {
+                    restored_blobs.emplace(info.key, std::move(blob));
+                }
+            }
+            err = nvs_entry_next(&it);
+        }
+        nvs_release_iterator(it);
+        nvs_close(nvs);
+    }
+
+    void store_seqlocked(Slot& slot, uint8_t type, uint64_t bits) {
+        portENTER_CRITICAL(&slot_write_mux);
+        uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+        slot.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.type.store(type, std::memory_order_relaxed);
+        slot.bits_lo.store(static_cast<uint32_t>(bits), std::memory_order_relaxed);
+        slot.bits_hi.store(static_cast<uint32_t>(bits >> 32), std::memory_order_relaxed);
+        slot.seq.store(seq + 2, std::memory_order_release);
+        portEXIT_CRITICAL(&slot_write_mux);
+    }
+    // Позначає похідні ключі (транзитивно) застарілими. Ті, на які є підписники,
+    // треба перерахувати одразу - їх хендли додаються в eager
+    void mark_dependents_stale(const Slot& slot, std::vector<StateHandle>& eager) {
+        for (StateHandle dependent : slot.dependents) {
+            Slot* dep = slot_at(dependent);
+            if (!dep || dep->stale.exchange(true, std::memory_order_relaxed)) {
+                continue; // Вже застарілий - його залежні теж
+            }
+            if (!dep->subscribers.empty() || !dep->async_subscribers.empty()) {
+                eager.push_back(dependent);
+            }
+            mark_dependents_stale(*dep, eager);
+        }
+    }
+
+    /**
+     * Застосовує запис до слота (під м'ютексом): порівняння зі збереженим,
+     * seqlock-запис, версія, позначка для NVS, похідні ключі і мертва зона.
+     * @return true - підписників треба сповістити.
+     */
+    bool apply_write(Slot& slot, const ValueType& value, bool mark_persist_dirty,
+                     std::vector<StateHandle>& eager) {
+        uint8_t type = static_cast<uint8_t>(value.index());
+        uint64_t bits = 0;
+        bool is_scalar = scalar_bits(value, bits);
+
+        // Те саме значення - ні запису, ні сповіщення
+        if (slot.type.load(std::memory_order_relaxed) == type &&
+            (is_scalar ? slot_bits(slot) == bits : slot.str == std::get<std::string>(value))) {
+            suppressed_notifications.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        if (!is_scalar) {
+            slot.str = std::get<std::string>(value);
+        }
+        store_seqlocked(slot, type, bits);
+        slot.version = global_version.fetch_add(1, std::memory_order_relaxed) + 1;
+        mark_dependents_stale(slot, eager);
+
+        // Persistent-ключ потрапить у наступний пакетний запис
+        if (mark_persist_dirty && slot.persistent && !slot.persist_dirty) {
+            slot.persist_dirty = true;
+            if (oldest_dirty_us == 0) {
+                oldest_dirty_us = esp_timer_get_time();
+            }
+        }
+
+        // Значення оновлено, але зміна відносно останнього сповіщення в межах мертвої зони
+        double prev = 0.0;
+        double next = 0.0;
+        if (slot.deadband > 0.0f && slot.notified_type == type &&
+            scalar_as_double(type, slot.notified_bits, prev) && scalar_as_double(type, bits, next) &&
+            std::fabs(next - prev) < slot.deadband) {
+            suppressed_notifications.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slot.notified_type = type;
+        slot.notified_bits = bits;
+        return true;
+    }
+
+    // Знімок значення для обходу поза м'ютексом
+    struct SnapshotEntry {
+        StateHandle handle;
+        uint32_t version;
+        ValueType value;
+    };
+
+    // Відвідувач викликається поза м'ютексом і може звертатись до SharedState
+    void visit_snapshot(const std::vector<SnapshotEntry>& entries, const StateVisitor& visitor) {
+        for (const auto& entry : entries) {
+            visitor(SharedState::name_of(entry.handle), entry.value, entry.version);
+        }
+    }
+
+    // Асинхронним підписникам - лише позначка; вартість не залежить від їх кількості
+    void mark_async_dirty(StateHandle handle) {
+        dirty_bitmap[handle / 32].fetch_or(1u << (handle % 32), std::memory_order_release);
+        if (notifier_task_handle) {
+            xTaskNotifyGive(notifier_task_handle);
+        }
+    }
+}
+
 void SharedState::init() {
     ESP_LOGI(TAG, "Ініціалізація SharedState...");
-    
+
     // Створюємо м'ютекс, якщо він ще не створений
     if (!state_mutex_handle) {
         state_mutex_handle = xSemaphoreCreateMutex();
@@ -22,49 +357,734 @@ void SharedState::init() {
             return;
         }
     }
-    
-    // Очищаємо всі контейнери
+
+    // Очищаємо всі контейнери. Блоки слотів лишаються і перевикористовуються
     if (xSemaphoreTake(state_mutex_handle, portMAX_DELAY) == pdTRUE) {
-        state_map.clear();
-        subscribers.clear();
-        handle_to_key.clear();
+        slot_count.store(0, std::memory_order_release);
+        key_index.clear();
+        for (auto& entry : hash_table) {
+            entry.store(STATE_HANDLE_INVALID, std::memory_order_relaxed);
+        }
+        handle_to_slot.clear();
+        derived_count.store(0, std::memory_order_release);
+        suppressed_notifications.store(0);
+        global_version.store(0);
+        uint32_t epoch;
+        do {
+            epoch = esp_random();
+        } while (epoch == 0 || epoch == boot_epoch.load(std::memory_order_relaxed));
+        boot_epoch.store(epoch, std::memory_order_relaxed);
+        for (auto& word : dirty_bitmap) {
+            word.store(0);
+        }
+        oldest_dirty_us = 0;
+        load_persisted();
+        ESP_LOGI(TAG, "З NVS прочитано %u збережених значень", (unsigned)restored_blobs.size());
         xSemaphoreGive(state_mutex_handle);
     } else {
         ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для ініціалізації!");
     }
-    
+
+    if (!notifier_task_handle) {
+        if (xTaskCreate(notifier_task, "state_notifier", NOTIFIER_TASK_STACK_SIZE, nullptr,
+                        NOTIFIER_TASK_PRIORITY, &notifier_task_handle) != pdPASS) {
+            ESP_LOGE(TAG, "Не вдалося створити задачу-нотифікатор, ASYNC-підписки не працюватимуть");
+        }
+    }
+    if (!persist_task_handle) {
+        if (xTaskCreate(persist_task, "state_persist", PERSIST_TASK_STACK_SIZE, nullptr,
+                        PERSIST_TASK_PRIORITY, &persist_task_handle) != pdPASS) {
+            ESP_LOGE(TAG, "Не вдалося створити задачу збереження, зміни не потраплять у NVS");
+        }
+    }
+
     // Скидаємо лічильник хендлів
     next_handle.store(1);
-    
+
     ESP_LOGI(TAG, "SharedState ініціалізовано");
 }
 
-SubscriptionHandle SharedState::subscribe(const std::string& key, StateCallback callback) {
+StateHandle SharedState::key(const std::string& name, float deadband) {
+    if (xSemaphoreTake(state_mutex_handle, portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для key(%s)", name.c_str());
+        return STATE_HANDLE_INVALID;
+    }
+
+    auto it = key_index.find(name);
+    if (it != key_index.end()) {
+        StateHandle handle = it->second;
+        if (deadband > 0.0f) {
+            slot_at(handle)->deadband = deadband;
+        }
+        xSemaphoreGive(state_mutex_handle);
+        return handle;
+    }
+
+    uint16_t count = slot_count.load(std::memory_order_relaxed);
+    if (count >= MAX_KEYS) {
+        xSemaphoreGive(state_mutex_handle);
+        ESP_LOGE(TAG, "Таблиця слотів заповнена (%u), ключ '%s' не створено", (unsigned)MAX_KEYS, name.c_str());
+        return STATE_HANDLE_INVALID;
+    }
+
+    Slot*& chunk = slot_chunks[count / SLOT_CHUNK_SIZE];
+    if (!chunk) {
+        chunk = new (std::nothrow) Slot[SLOT_CHUNK_SIZE];
+        if (!chunk) {
+            xSemaphoreGive(state_mutex_handle);
+            ESP_LOGE(TAG, "Не вдалося виділити блок слотів для ключа '%s'", name.c_str());
+            return STATE_HANDLE_INVALID;
+        }
+    }
+
+    // Слот може лишитись від попереднього init() - скидаємо його повністю
+    Slot& slot = chunk[count % SLOT_CHUNK_SIZE];
+    slot.name = name;
+    slot.hash = state_key_hash(name.c_str());
+    slot.str.clear();
+    slot.subscribers.clear();
+    slot.async_subscribers.clear();
+    slot.deadband = deadband;
+    slot.notified_type = TYPE_NONE;
+    slot.notified_bits = 0;
+    slot.version = 0;
+    slot.persistent = false;
+    slot.persist_dirty = false;
+    slot.derived.reset();
+    slot.stale.store(false, std::memory_order_relaxed);
+    slot.dependents.clear();
+    store_seqlocked(slot, TYPE_NONE, 0);
+
+    StateHandle handle = count;
+    key_index.emplace(name, handle);
+    slot_count.store(count + 1, std::memory_order_release);
+    // Таблиця вдвічі більша за MAX_KEYS, тож вільна комірка завжди є
+    for (size_t i = slot.hash;; ++i) {
+        auto& entry = hash_table[i & (HASH_TABLE_SIZE - 1)];
+        if (entry.load(std::memory_order_relaxed) == STATE_HANDLE_INVALID) {
+            entry.store(handle, std::memory_order_release);
+            break;
+        }
+    }
+    xSemaphoreGive(state_mutex_handle);
+
+    ESP_LOGD(TAG, "Створено слот %u для ключа '%s'", handle, name.c_str());
+    return handle;
+}
+
+StateHandle SharedState::find(const std::string& name) {
+    return lookup(name.c_str(), state_key_hash(name.c_str()));
+}
+
+StateHandle SharedState::lookup(const char* name, uint32_t hash) {
+    for (size_t i = 0; i < HASH_TABLE_SIZE; ++i) {
+        StateHandle handle = hash_table[(hash + i) & (HASH_TABLE_SIZE - 1)].load(std::memory_order_acquire);
+        const Slot* slot = slot_at(handle);
+        if (!slot) {
+            break; // Порожня комірка - ключа немає
+        }
+        if (slot->hash == hash && slot->name == name) {
+            return handle;
+        }
+    }
+    return STATE_HANDLE_INVALID;
+}
+
+const char* SharedState::name_of(StateHandle handle) {
+    // Назва записується до публікації слота і далі не змінюється
+    const Slot* slot = slot_at(handle);
+    return slot ? slot->name.c_str() : nullptr;
+}
+
+void SharedState::write_value(StateHandle handle, ValueType value, bool mark_persist_dirty) {
+    std::vector<StateSubscriberPtr> callbacks_to_call;
+    std::vector<StateHandle> eager;
+
+    if (xSemaphoreTake(get_mutex(), portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для set(%u)", handle);
+        return;
+    }
+
+    Slot* slot = slot_at(handle);
+    if (!slot) {
+        xSemaphoreGive(get_mutex());
+        ESP_LOGW(TAG, "set() з невалідним хендлом %u", handle);
+        return;
+    }
+
+    // Копіюємо вказівники на підписки, щоб викликати їх *після* звільнення м'ютекса
+    bool notify = apply_write(*slot, value, mark_persist_dirty, eager);
+    bool has_async = false;
+    if (notify) {
+        callbacks_to_call = slot->subscribers;
+        has_async = !slot->async_subscribers.empty();
+    }
+    xSemaphoreGive(get_mutex());
+
+    if (has_async) {
+        mark_async_dirty(handle);
+    }
+
+    // Синхронні callback'и - поза м'ютексом, у потоці виклику set()
+    for (const auto& sub : callbacks_to_call) {
+        if (sub->callback) {
+            sub->callback(value);
+        }
+    }
+
+    // Похідні ключі з підписниками - одразу, решта - при читанні
+    for (StateHandle dependent : eager) {
+        evaluate_derived(dependent);
+    }
+}
+
+SharedState::Transaction& SharedState::Transaction::stage(StateHandle handle, ValueType value) {
+    // Повторний запис того самого ключа замінює попередній
+    for (size_t i = 0; i < count_; ++i) {
+        if (writes_[i].handle == handle) {
+            writes_[i].value = std::move(value);
+            return *this;
+        }
+    }
+    if (count_ >= MAX_WRITES) {
+        ESP_LOGE(TAG, "Транзакція переповнена (%u записів), commit() буде відхилено", (unsigned)MAX_WRITES);
+        overflow_ = true;
+        return *this;
+    }
+    writes_[count_].handle = handle;
+    writes_[count_].value = std::move(value);
+    count_++;
+    return *this;
+}
+
+esp_err_t SharedState::Transaction::commit() {
+    size_t count = count_;
+    count_ = 0;
+    if (overflow_) {
+        overflow_ = false;
+        return ESP_ERR_NO_MEM;
+    }
+    if (count == 0) {
+        return ESP_OK;
+    }
+
+    // Підписник і індекс запису, значення якого йому передати
+    std::vector<std::pair<StateSubscriberPtr, size_t>> callbacks_to_call;
+    std::vector<StateHandle> eager;
+    bool notify_async[MAX_WRITES] = {};
+    esp_err_t result = ESP_OK;
+
+    if (xSemaphoreTake(get_mutex(), portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для commit()");
+        return ESP_ERR_TIMEOUT;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        Slot* slot = slot_at(writes_[i].handle);
+        if (!slot) {
+            result = ESP_ERR_INVALID_ARG;
+            continue;
+        }
+        if (apply_write(*slot, writes_[i].value, true, eager)) {
+            for (const auto& sub : slot->subscribers) {
+                callbacks_to_call.emplace_back(sub, i);
+            }
+            notify_async[i] = !slot->async_subscribers.empty();
+        }
+    }
+    xSemaphoreGive(get_mutex());
+
+    if (result != ESP_OK) {
+        ESP_LOGW(TAG, "commit(): пропущено записи з невалідними хендлами");
+    }
+
+    // Усі записи вже видимі: підписники не побачать напівоновленого стану
+    for (size_t i = 0; i < count; ++i) {
+        if (notify_async[i]) {
+            mark_async_dirty(writes_[i].handle);
+        }
+    }
+    for (const auto& [sub, index] : callbacks_to_call) {
+        if (sub->callback) {
+            sub->callback(writes_[index].value);
+        }
+    }
+    for (StateHandle dependent : eager) {
+        evaluate_derived(dependent);
+    }
+    return result;
+}
+
+esp_err_t SharedState::derive(StateHandle target, std::initializer_list<StateHandle> sources,
+                              StateDeriveFunc compute) {
+    if (!compute) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (xSemaphoreTake(get_mutex(), portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для derive(%u)", target);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    Slot* slot = slot_at(target);
+    esp_err_t result = slot ? ESP_OK : ESP_ERR_INVALID_ARG;
+    if (slot && slot->derived) {
+        result = ESP_ERR_INVALID_STATE; // Функцію вже задано
+    }
+    if (result == ESP_OK && derived_count.load(std::memory_order_relaxed) >= MAX_DERIVED_KEYS) {
+        result = ESP_ERR_NO_MEM;
+    }
+    for (StateHandle source : sources) {
+        if (source == target || !slot_at(source)) {
+            result = ESP_ERR_INVALID_ARG;
+        }
+    }
+    if (result != ESP_OK) {
+        xSemaphoreGive(get_mutex());
+        ESP_LOGW(TAG, "derive(): невалідний похідний ключ %u або його джерела", target);
+        return result;
+    }
+
+    // Поки жодне джерело не має значення, обчислювати нічого
+    bool has_input = false;
+    for (StateHandle source : sources) {
+        Slot* source_slot = slot_at(source);
+        source_slot->dependents.push_back(target);
+        has_input = has_input || source_slot->type.load(std::memory_order_relaxed) != TYPE_NONE;
+    }
+    slot->derived = std::make_shared<DerivedState>();
+    slot->derived->compute = std::move(compute);
+    slot->derived->sources.assign(sources.begin(), sources.end());
+    slot->stale.store(has_input, std::memory_order_relaxed);
+    uint16_t derived = derived_count.load(std::memory_order_relaxed);
+    derived_handles[derived].store(target, std::memory_order_relaxed);
+    derived_count.store(derived + 1, std::memory_order_release);
+    xSemaphoreGive(get_mutex());
+
+    ESP_LOGD(TAG, "Ключ '%s' похідний від %u джерел", name_of(target), (unsigned)sources.size());
+    return ESP_OK;
+}
+
+void SharedState::evaluate_derived(StateHandle handle) {
+    std::shared_ptr<DerivedState> derived;
+
+    if (xSemaphoreTake(get_mutex(), portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для обчислення слота %u", handle);
+        return;
+    }
+    Slot* slot = slot_at(handle);
+    if (!slot || !slot->derived || !slot->stale.load(std::memory_order_relaxed)) {
+        xSemaphoreGive(get_mutex());
+        return;
+    }
+    derived = slot->derived;
+    xSemaphoreGive(get_mutex());
+
+    // Спершу застарілі джерела: їх перерахунок знову позначає цей ключ застарілим
+    for (StateHandle source : derived->sources) {
+        refresh_if_stale(source);
+    }
+
+    // Прапорець знімаємо до обчислення: зміна джерела під час нього позначить ключ знову
+    if (!slot->stale.exchange(false, std::memory_order_relaxed)) {
+        return; // Перерахував інший читач
+    }
+
+    // Функція - поза м'ютексом: джерела вона читає через get()
+    write_value(handle, derived->compute());
+}
+
+void SharedState::refresh_if_stale(StateHandle handle) {
+    const Slot* slot = slot_at(handle);
+    if (slot && slot->stale.load(std::memory_order_relaxed)) {
+        evaluate_derived(handle);
+    }
+}
+
+void SharedState::refresh_all_stale() {
+    // Лише похідні ключі: без них обхід порожній
+    uint16_t count = derived_count.load(std::memory_order_acquire);
+    for (uint16_t i = 0; i < count; ++i) {
+        refresh_if_stale(derived_handles[i].load(std::memory_order_relaxed));
+    }
+}
+
+void SharedState::notifier_task(void* /*arg*/) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for (size_t word = 0; word < DIRTY_WORDS; ++word) {
+            uint32_t bits = dirty_bitmap[word].exchange(0, std::memory_order_acquire);
+            while (bits) {
+                uint32_t bit = __builtin_ctz(bits);
+                bits &= bits - 1;
+                deliver_async(static_cast<StateHandle>(word * 32 + bit));
+            }
+        }
+    }
+}
+
+void SharedState::deliver_async(StateHandle handle) {
+    std::vector<StateSubscriberPtr> callbacks_to_call;
+    ValueType current;
+
+    if (xSemaphoreTake(get_mutex(), portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для доставки слота %u", handle);
+        return;
+    }
+    // Проміжні записи злились: доставляємо значення, актуальне зараз
+    const Slot* slot = slot_at(handle);
+    if (!slot || !slot_value(*slot, current)) {
+        xSemaphoreGive(get_mutex());
+        return;
+    }
+    callbacks_to_call = slot->async_subscribers;
+    xSemaphoreGive(get_mutex());
+
+    for (const auto& sub : callbacks_to_call) {
+        if (sub->callback) {
+            sub->callback(current);
+        }
+    }
+}
+
+uint32_t SharedState::version() {
+    return global_version.load(std::memory_order_relaxed);
+}
+
+uint32_t SharedState::epoch() {
+    return boot_epoch.load(std::memory_order_relaxed);
+}
+
+uint32_t SharedState::changes_since(uint32_t since_version, uint32_t since_epoch, const StateVisitor& visitor) {
+    std::vector<SnapshotEntry> changes;
+    refresh_all_stale();
+
+    if (xSemaphoreTake(get_mutex(), portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для changes_since(%u)", since_version);
+        return since_version;
+    }
+
+    uint32_t current = global_version.load(std::memory_order_relaxed);
+    // Версія з іншої епохи або з майбутнього - клієнт пережив перезавантаження, віддаємо все
+    if (since_epoch != boot_epoch.load(std::memory_order_relaxed) || since_version > current) {
+        since_version = 0;
+    }
+    uint16_t count = slot_count.load(std::memory_order_relaxed);
+    for (StateHandle handle = 0; handle < count; ++handle) {
+        const Slot* slot = slot_at(handle);
+        if (slot->version <= since_version) {
+            continue;
+        }
+        SnapshotEntry change{handle, slot->version, {}};
+        if (slot_value(*slot, change.value)) {
+            changes.push_back(std::move(change));
+        }
+    }
+    xSemaphoreGive(get_mutex());
+
+    visit_snapshot(changes, visitor);
+    return current;
+}
+
+uint32_t SharedState::query(const std::string& prefix, const StateVisitor& visitor) {
+    std::vector<SnapshotEntry> entries;
+    refresh_all_stale();
+
+    if (xSemaphoreTake(get_mutex(), portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для query(%s)", prefix.c_str());
+        return 0;
+    }
+    uint32_t current = global_version.load(std::memory_order_relaxed);
+    // key_index упорядкований: ключі з префіксом ідуть суцільним діапазоном
+    for (auto it = key_index.lower_bound(prefix);
+         it != key_index.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+        const Slot* slot = slot_at(it->second);
+        SnapshotEntry entry{it->second, slot->version, {}};
+        if (slot_value(*slot, entry.value)) {
+            entries.push_back(std::move(entry));
+        }
+    }
+    xSemaphoreGive(get_mutex());
+
+    visit_snapshot(entries, visitor);
+    return current;
+}
+
+void SharedState::set_persist_config(const StatePersistConfig& config) {
+    if (xSemaphoreTake(get_mutex(), portMAX_DELAY) == pdTRUE) {
+        persist_config = config;
+        if (persist_config.flush_interval_ms == 0) {
+            persist_config.flush_interval_ms = DEFAULT_PERSIST_CONFIG.flush_interval_ms;
+        }
+        xSemaphoreGive(get_mutex());
+    }
+}
+
+esp_err_t SharedState::set_persistent(StateHandle handle) {
+    bool restore = false;
+    ValueType restored;
+
+    if (xSemaphoreTake(get_mutex(), portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для set_persistent(%u)", handle);
+        return ESP_ERR_TIMEOUT;
+    }
+    Slot* slot = slot_at(handle);
+    if (!slot) {
+        xSemaphoreGive(get_mutex());
+        return ESP_ERR_INVALID_ARG;
+    }
+    slot->persistent = true;
+
+    auto it = restored_blobs.find(persist_key(slot->name));
+    if (it != restored_blobs.end()) {
+        // Значення, записане до set_persistent(), новіше за збережене
+        if (slot->type.load(std::memory_order_relaxed) == TYPE_NONE) {
+            restore = decode_blob(it->second, restored);
+            if (!restore) {
+                ESP_LOGW(TAG, "Пошкоджене збережене значення ключа '%s'", slot->name.c_str());
+            }
+        }
+        restored_blobs.erase(it);
+    }
+    if (!restore && slot->type.load(std::memory_order_relaxed) != TYPE_NONE && !slot->persist_dirty) {
+        slot->persist_dirty = true;
+        if (oldest_dirty_us == 0) {
+            oldest_dirty_us = esp_timer_get_time();
+        }
+    }
+    if (restore) {
+        persist_stats.restored++;
+    }
+    xSemaphoreGive(get_mutex());
+
+    // Відновлене значення і так лежить у NVS - повторно не позначаємо
+    if (restore) {
+        write_value(handle, std::move(restored), false);
+        ESP_LOGD(TAG, "Ключ '%s' відновлено з NVS", name_of(handle));
+    }
+    return ESP_OK;
+}
+
+esp_err_t SharedState::flush() {
+    return flush_persistent(true);
+}
+
+StatePersistStats SharedState::get_persist_stats() {
+    StatePersistStats stats = {};
+    if (xSemaphoreTake(get_mutex(), portMAX_DELAY) == pdTRUE) {
+        stats = persist_stats;
+        xSemaphoreGive(get_mutex());
+    }
+    return stats;
+}
+
+void SharedState::persist_task(void* /*arg*/) {
+    while (true) {
+        // Налаштування змінює set_persist_config() під м'ютексом - читаємо так само
+        uint32_t interval_ms = DEFAULT_PERSIST_CONFIG.flush_interval_ms;
+        if (xSemaphoreTake(get_mutex(), portMAX_DELAY) == pdTRUE) {
+            interval_ms = persist_config.flush_interval_ms;
+            xSemaphoreGive(get_mutex());
+        }
+        vTaskDelay(pdMS_TO_TICKS(interval_ms));
+        flush_persistent(false);
+    }
+}
+
+esp_err_t SharedState::flush_persistent(bool force) {
+    struct PendingWrite {
+        StateHandle handle;
+        std::string nvs_key;
+        std::vector<uint8_t> blob;
+    };
+    std::vector<PendingWrite> writes;
+
+    if (xSemaphoreTake(get_mutex(), portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для збереження в NVS");
+        return ESP_ERR_TIMEOUT;
+    }
+    // Пишемо лише коли найстаріша зміна досягла max_dirty_age: зміни за цей
+    // час зливаються в один пакет, і кількість записів у flash обмежена
+    int64_t age_us = oldest_dirty_us ? esp_timer_get_time() - oldest_dirty_us : 0;
+    if (oldest_dirty_us == 0 ||
+        (!force && age_us < static_cast<int64_t>(persist_config.max_dirty_age_ms) * 1000)) {
+        xSemaphoreGive(get_mutex());
+        return ESP_OK;
+    }
+    uint16_t count = slot_count.load(std::memory_order_relaxed);
+    for (StateHandle handle = 0; handle < count; ++handle) {
+        Slot* slot = slot_at(handle);
+        if (slot->persist_dirty) {
+            writes.push_back({handle, persist_key(slot->name), encode_slot(*slot)});
+            slot->persist_dirty = false;
+        }
+    }
+    oldest_dirty_us = 0;
+    xSemaphoreGive(get_mutex());
+
+    // NVS - поза м'ютексом: запис у flash триває мілісекунди
+    nvs_handle_t nvs;
+    size_t bytes = 0;
+    esp_err_t err = nvs_open(PERSIST_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        for (const auto& write : writes) {
+            err = nvs_set_blob(nvs, write.nvs_key.c_str(), write.blob.data(), write.blob.size());
+            if (err != ESP_OK) {
+                break;
+            }
+            bytes += write.blob.size();
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+
+    if (xSemaphoreTake(get_mutex(), portMAX_DELAY) == pdTRUE) {
+        if (err == ESP_OK) {
+            persist_stats.batches++;
+            persist_stats.keys_written += writes.size();
+            persist_stats.bytes_written += bytes;
+        } else {
+            // Повертаємо ключі в чергу - спробуємо в наступному пакеті
+            persist_stats.errors++;
+            for (const auto& write : writes) {
+                Slot* slot = slot_at(write.handle);
+                if (slot && slot->persistent) {
+                    slot->persist_dirty = true;
+                }
+            }
+            if (oldest_dirty_us == 0) {
+                oldest_dirty_us = esp_timer_get_time();
+            }
+        }
+        xSemaphoreGive(get_mutex());
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Помилка збереження %u ключів у NVS: %s", (unsigned)writes.size(), esp_err_to_name(err));
+    } else {
+        ESP_LOGD(TAG, "Збережено в NVS: %u ключів, %u байт", (unsigned)writes.size(), (unsigned)bytes);
+    }
+    return err;
+}
+
+uint32_t SharedState::get_suppressed_count() {
+    return suppressed_notifications.load(std::memory_order_relaxed);
+}
+
+bool SharedState::read_scalar(StateHandle handle, uint8_t type, uint64_t& bits) {
+    const Slot* slot = slot_at(handle);
+    if (!slot) {
+        return false;
+    }
+    // Для звичайного ключа - одне relaxed-читання прапорця
+    if (slot->stale.load(std::memory_order_relaxed)) {
+        evaluate_derived(handle);
+    }
+
+    uint32_t seq_begin;
+    uint32_t seq_end = 0;
+    uint8_t stored_type;
+    uint32_t lo;
+    uint32_t hi;
+    do {
+        seq_begin = slot->seq.load(std::memory_order_acquire);
+        if (seq_begin & 1) {
+            continue; // Запис у процесі
+        }
+        stored_type = slot->type.load(std::memory_order_relaxed);
+        lo = slot->bits_lo.load(std::memory_order_relaxed);
+        hi = slot->bits_hi.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        seq_end = slot->seq.load(std::memory_order_relaxed);
+    } while ((seq_begin & 1) || seq_begin != seq_end);
+
+    if (stored_type == TYPE_NONE) {
+        return false;
+    }
+    if (stored_type != type) {
+        ESP_LOGW(TAG, "Невідповідність типу для ключа '%s'. Запитуваний тип не відповідає збереженому.", slot->name.c_str());
+        return false;
+    }
+    bits = (static_cast<uint64_t>(hi) << 32) | lo;
+    return true;
+}
+
+bool SharedState::read_string(StateHandle handle, std::string& out) {
+    refresh_if_stale(handle);
+    if (xSemaphoreTake(get_mutex(), portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для get(%u)", handle);
+        return false;
+    }
+
+    bool found = false;
+    const Slot* slot = slot_at(handle);
+    if (slot) {
+        uint8_t stored_type = slot->type.load(std::memory_order_relaxed);
+        if (stored_type == TYPE_STRING) {
+            out = slot->str;
+            found = true;
+        } else if (stored_type != TYPE_NONE) {
+            ESP_LOGW(TAG, "Невідповідність типу для ключа '%s'. Запитуваний тип не відповідає збереженому.", slot->name.c_str());
+        }
+    }
+
+    xSemaphoreGive(get_mutex());
+    return found;
+}
+
+SubscriptionHandle SharedState::subscribe(const std::string& key_name, StateCallback callback,
+                                          StateDelivery delivery) {
+    return subscribe(key(key_name), std::move(callback), delivery);
+}
+
+SubscriptionHandle SharedState::subscribe(StateHandle key_handle, StateCallback callback,
+                                          StateDelivery delivery) {
     if (!callback) {
-        ESP_LOGW(TAG, "Спроба підписатись з порожнім callback на ключ '%s'", key.c_str());
+        ESP_LOGW(TAG, "Спроба підписатись з порожнім callback на слот %u", key_handle);
         return 0; // Невалідний хендл
     }
-    
+
     SubscriptionHandle handle = next_handle.fetch_add(1);
-    
+    auto sub = std::make_shared<StateSubscriber>();
+    sub->handle = handle;
+    sub->callback = std::move(callback);
+    sub->delivery = delivery;
+
+    // Похідний ключ перераховуємо до підписки, щоб передати актуальне значення
+    refresh_if_stale(key_handle);
+
     if (xSemaphoreTake(state_mutex_handle, portMAX_DELAY) == pdTRUE) {
+        Slot* slot = slot_at(key_handle);
+        if (!slot) {
+            xSemaphoreGive(state_mutex_handle);
+            ESP_LOGW(TAG, "Спроба підписатись на невалідний слот %u", key_handle);
+            return 0;
+        }
+
         // Додаємо підписку
-        subscribers[key].push_back({handle, callback});
-        handle_to_key[handle] = key;
+        if (delivery == StateDelivery::ASYNC) {
+            slot->async_subscribers.push_back(sub);
+        } else {
+            slot->subscribers.push_back(sub);
+        }
+        handle_to_slot[handle] = key_handle;
+
+        // Поточне значення копіюємо під м'ютексом, callback викликаємо вже без нього
+        ValueType current;
+        bool has_value = slot_value(*slot, current);
         xSemaphoreGive(state_mutex_handle);
-        
-        ESP_LOGD(TAG, "Додано підписку %u на ключ '%s'", handle, key.c_str());
-        
+
+        ESP_LOGD(TAG, "Додано підписку %u на ключ '%s'", handle, slot->name.c_str());
+
         // Якщо значення вже існує, викликаємо callback із поточним значенням
-        auto it = state_map.find(key);
-        if (it != state_map.end()) {
-            callback(it->second);
+        if (has_value) {
+            sub->callback(current);
         }
     } else {
-        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для підписки на '%s'", key.c_str());
+        ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для підписки на слот %u", key_handle);
         return 0; // Невалідний хендл
     }
-    
+
     return handle;
 }
 
@@ -73,38 +1093,32 @@ void SharedState::unsubscribe(SubscriptionHandle handle) {
         ESP_LOGW(TAG, "Спроба відписатись з невалідним хендлом 0");
         return;
     }
-    
+
     if (xSemaphoreTake(state_mutex_handle, portMAX_DELAY) == pdTRUE) {
-        // Знаходимо ключ для цього хендла
-        auto it_handle = handle_to_key.find(handle);
-        if (it_handle != handle_to_key.end()) {
-            std::string key = it_handle->second;
-            
-            // Видаляємо підписку з вектора
-            auto it_subs = subscribers.find(key);
-            if (it_subs != subscribers.end()) {
-                auto& subs_vec = it_subs->second;
-                subs_vec.erase(
-                    std::remove_if(subs_vec.begin(), subs_vec.end(), 
-                                 [handle](const auto& pair) { return pair.first == handle; }),
-                    subs_vec.end()
-                );
-                
-                // Якщо вектор став порожнім, видаляємо запис
-                if (subs_vec.empty()) {
-                    subscribers.erase(it_subs);
+        // Знаходимо слот для цього хендла
+        auto it_handle = handle_to_slot.find(handle);
+        if (it_handle != handle_to_slot.end()) {
+            Slot* slot = slot_at(it_handle->second);
+            if (slot) {
+                // Видаляємо підписку з вектора
+                for (auto* subs_vec : {&slot->subscribers, &slot->async_subscribers}) {
+                    subs_vec->erase(
+                        std::remove_if(subs_vec->begin(), subs_vec->end(),
+                                     [handle](const StateSubscriberPtr& sub) { return sub->handle == handle; }),
+                        subs_vec->end()
+                    );
                 }
+                ESP_LOGD(TAG, "Видалено підписку %u на ключ '%s'", handle, slot->name.c_str());
             }
-            
-            // Видаляємо запис із мапування хендл->ключ
-            handle_to_key.erase(it_handle);
-            ESP_LOGD(TAG, "Видалено підписку %u на ключ '%s'", handle, key.c_str());
+
+            // Видаляємо запис із мапування хендл->слот
+            handle_to_slot.erase(it_handle);
         } else {
             ESP_LOGW(TAG, "Спроба відписатись з невідомим хендлом %u", handle);
         }
-        
+
         xSemaphoreGive(state_mutex_handle);
     } else {
         ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для відписки з хендлом %u", handle);
     }
-}
\ No newline at end of file
+}
@@ -1,108 +1,393 @@
 #ifndef CORE_SHARED_STATE_H
 #define CORE_SHARED_STATE_H
 
-#include <map>
 #include <string>
-#include <vector>
-#include <functional>
 #include <variant>
+#include <memory>
 #include <cstdint>
+#include <cstring>
+#include <initializer_list>
 #include <atomic> // Для генерації хендлів
-#include <utility> // Для std::pair
-#include <algorithm> // Для std::remove_if
+#include <type_traits>
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "esp_err.h"
 #include "esp_log.h" // Для логування
+#include "inplace_function.h"
 
-// Типи даних
-using ValueType = std::variant<int, float, bool, std::string>;
-using StateCallback = std::function<void(const ValueType&)>;
+// Типи даних. Нові типи додаються лише в кінець: індекс типу зберігається в NVS
+using ValueType = std::variant<int, float, bool, std::string, uint32_t, int64_t, double>;
+// Без купи: захоплення лямбди має влазити в буфер InplaceFunction
+using StateCallback = InplaceFunction<void(const ValueType&)>;
 using SubscriptionHandle = uint32_t;
 
+/**
+ * @brief Хендл ключа - індекс слота в плоскій таблиці SharedState.
+ *
+ * Отримується один раз через SharedState::key() і далі використовується
+ * замість рядка: без хешування, пошуку в мапі та тимчасових std::string.
+ */
+using StateHandle = uint16_t;
+static constexpr StateHandle STATE_HANDLE_INVALID = 0xFFFF;
+
+/**
+ * @brief FNV-1a хеш назви ключа.
+ *
+ * constexpr - для дескрипторів StateKey обчислюється на етапі компіляції.
+ */
+constexpr uint32_t state_key_hash(const char* name) {
+    uint32_t h = 2166136261u;
+    while (name && *name) {
+        h ^= static_cast<uint8_t>(*name++);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Типізований дескриптор ключа, оголошується один раз як constexpr.
+ *
+ * Тип значення - частина дескриптора, тож get/set з іншим типом не
+ * скомпілюються. Мертва зона задається тут же, при оголошенні.
+ */
+template <typename T>
+struct StateKey {
+    using value_type = T;
+
+    const char* name;
+    float deadband;  ///< Мертва зона сповіщень (див. SharedState::key)
+    uint32_t hash;
+
+    explicit constexpr StateKey(const char* key_name, float key_deadband = 0.0f)
+        : name(key_name), deadband(key_deadband), hash(state_key_hash(key_name)) {}
+};
+
+/**
+ * @brief Типізований хендл ключа - результат SharedState::key(StateKey<T>).
+ */
+template <typename T>
+struct StateRef {
+    using value_type = T;
+
+    StateHandle handle = STATE_HANDLE_INVALID;
+};
+
+// Відвідувач змін: назва ключа, значення і версія останньої зміни
+using StateVisitor = InplaceFunction<void(const char* key, const ValueType& value, uint32_t version)>;
+
+// Обчислення похідного значення з поточних значень джерел
+using StateDeriveFunc = InplaceFunction<ValueType()>;
+
+/**
+ * @brief Налаштування відкладеного збереження persistent-ключів у NVS.
+ */
+struct StatePersistConfig {
+    uint32_t flush_interval_ms;  ///< Період перевірки брудних ключів задачею збереження
+    uint32_t max_dirty_age_ms;   ///< Скільки зміна може лишатись незбереженою; задає бюджет записів у flash
+};
+
+/**
+ * @brief Лічильники записів у NVS для контролю зносу flash.
+ */
+struct StatePersistStats {
+    uint32_t batches;        ///< Пакетних записів (nvs_commit)
+    uint32_t keys_written;   ///< Записаних значень
+    uint32_t bytes_written;  ///< Байт корисного навантаження
+    uint32_t restored;       ///< Ключів, відновлених з NVS
+    uint32_t errors;         ///< Невдалих пакетів
+};
+
+/**
+ * @brief Спосіб доставки сповіщень підписнику.
+ */
+enum class StateDelivery : uint8_t {
+    SYNC,   ///< Callback у потоці, що викликав set()
+    ASYNC,  ///< Callback у задачі-нотифікаторі; проміжні значення зливаються в останнє
+};
+
+// Запис підписки. Callback move-only, тож списки тримають вказівники на запис
+struct StateSubscriber {
+    SubscriptionHandle handle;
+    StateCallback callback;
+    StateDelivery delivery;
+};
+using StateSubscriberPtr = std::shared_ptr<StateSubscriber>;
+
 class SharedState {
 public:
+    // Слоти виділяються блоками, щоб адреса слота не змінювалась після створення
+    static constexpr size_t SLOT_CHUNK_SIZE = 16;
+    static constexpr size_t MAX_SLOT_CHUNKS = 16;
+    static constexpr size_t MAX_KEYS = SLOT_CHUNK_SIZE * MAX_SLOT_CHUNKS;
+    // Похідних ключів небагато: query/changes_since перевіряють лише їх
+    static constexpr size_t MAX_DERIVED_KEYS = 16;
+
+    // Задача доставки ASYNC-сповіщень
+    static constexpr uint32_t NOTIFIER_TASK_STACK_SIZE = 4096;
+    static constexpr UBaseType_t NOTIFIER_TASK_PRIORITY = 4;
+    // Задача пакетного запису persistent-ключів у NVS
+    static constexpr uint32_t PERSIST_TASK_STACK_SIZE = 4096;
+    static constexpr UBaseType_t PERSIST_TASK_PRIORITY = 2;
+
     static void init();
 
+    /**
+     * @brief Повертає хендл ключа, створюючи слот за потреби.
+     * @param deadband Мертва зона для числових значень: підписників сповіщаємо,
+     * лише коли значення відійшло від останнього сповіщеного щонайменше на неї.
+     * 0 - сповіщати про кожну зміну. Для існуючого ключа додатне значення її оновлює.
+     * @return STATE_HANDLE_INVALID, якщо таблиця слотів заповнена.
+     */
+    static StateHandle key(const std::string& name, float deadband = 0.0f);
+
+    /**
+     * @brief Резолвить типізований дескриптор у хендл (з його мертвою зоною).
+     *
+     * Викликається один раз при ініціалізації модуля; далі get/set за
+     * StateRef йдуть прямо в слот.
+     */
+    template <typename T>
+    static StateRef<T> key(const StateKey<T>& descriptor) {
+        static_assert(type_index<T>() < std::variant_size_v<ValueType>, "Тип не підтримується ValueType");
+        return StateRef<T>{key(descriptor.name, descriptor.deadband)};
+    }
+
+    /**
+     * @brief Шукає хендл існуючого ключа, слот не створюється.
+     *
+     * Пошук за хешем назви без м'ютекса.
+     * @return STATE_HANDLE_INVALID, якщо ключ ще не оголошено.
+     */
+    static StateHandle find(const std::string& name);
+
+    /**
+     * @brief Назва ключа за хендлом (nullptr для невалідного хендла).
+     */
+    static const char* name_of(StateHandle handle);
+
     // --- Шаблонний метод Set ---
     template <typename T>
-    static void set(const std::string& key, T value) {
-        // Створюємо ValueType з переданого значення
-        // Потребує перевірки, чи тип T взагалі підтримується у ValueType
-        ValueType new_value = value;
-
-        std::vector<std::pair<SubscriptionHandle, StateCallback>> callbacks_to_call;
-
-        if (xSemaphoreTake(get_mutex(), portMAX_DELAY) == pdTRUE) {
-            // Оновлюємо або додаємо значення
-            state_map[key] = new_value;
-
-            // Отримуємо список підписників для цього ключа (якщо є)
-            auto it = subscribers.find(key);
-            if (it != subscribers.end()) {
-                // Копіюємо список callback'ів, щоб викликати їх *після* звільнення м'ютекса
-                callbacks_to_call = it->second;
-            }
-            xSemaphoreGive(get_mutex());
+    static void set(StateHandle handle, T value) {
+        if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>) {
+            write_value(handle, ValueType(std::in_place_type<std::string>, value));
         } else {
-             ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для set(%s)", key.c_str());
-             return;
+            static_assert(type_index<T>() < std::variant_size_v<ValueType>, "Тип не підтримується ValueType");
+            write_value(handle, ValueType(std::in_place_type<T>, std::move(value)));
         }
+    }
 
-        // Викликаємо callback'и поза м'ютексом
-        // ESP_LOGD(TAG, "Виклик %d callback'ів для ключа %s", callbacks_to_call.size(), key.c_str());
-        for (const auto& [handle, cb] : callbacks_to_call) {
-            if (cb) {
-                // TODO: Розглянути можливість виклику callback'ів в окремій задачі,
-                // щоб уникнути блокування потоку, що викликав set,
-                // особливо якщо callback'и можуть бути тривалими.
-                // Для початку - прямий виклик.
-                cb(new_value);
-            }
-        }
+    template <typename T>
+    static void set(const std::string& key_name, T value) {
+        set<T>(key(key_name), std::move(value));
     }
 
-    // --- Шаблонний метод Get ---
+    // Типізований запис: тип значення задає дескриптор
     template <typename T>
-    static T get(const std::string& key, T default_value) {
-        if (xSemaphoreTake(get_mutex(), portMAX_DELAY) != pdTRUE) {
-             ESP_LOGE(TAG, "Не вдалося захопити м'ютекс для get(%s)", key.c_str());
-            return default_value;
-        }
+    static void set(StateRef<T> ref, typename StateRef<T>::value_type value) {
+        set<T>(ref.handle, std::move(value));
+    }
+
+    template <typename T>
+    static void set(const StateKey<T>& descriptor, typename StateKey<T>::value_type value) {
+        StateHandle handle = lookup(descriptor.name, descriptor.hash);
+        set<T>(handle != STATE_HANDLE_INVALID ? handle : key(descriptor).handle, std::move(value));
+    }
 
-        T result = default_value;
-        auto it = state_map.find(key);
-        if (it != state_map.end()) {
-            // Намагаємось отримати значення потрібного типу з варіанту
-            try {
-                 if constexpr (std::is_convertible_v<T, ValueType> || std::is_same_v<T, int> || std::is_same_v<T, float> || std::is_same_v<T, bool> || std::is_same_v<T, std::string>) {
-                    result = std::get<T>(it->second);
-                 } else {
-                     // Тип не підтримується варіантом напряму
-                     // Можна додати обробку або логування
-                 }
-
-            } catch (const std::bad_variant_access& ex) {
-                // Тип у варіанті не збігається з запитуваним типом T
-                ESP_LOGW(TAG, "Невідповідність типу для ключа '%s'. Запитуваний тип не відповідає збереженому.", key.c_str());
+    // --- Шаблонний метод Get ---
+    // Числові значення читаються без м'ютекса (seqlock слота), рядки - під м'ютексом
+    template <typename T>
+    static T get(StateHandle handle, T default_value) {
+        static_assert(type_index<T>() < std::variant_size_v<ValueType>, "Тип не підтримується ValueType");
+        if constexpr (std::is_same_v<T, std::string>) {
+            std::string result;
+            return read_string(handle, result) ? result : default_value;
+        } else {
+            uint64_t bits = 0;
+            if (!read_scalar(handle, static_cast<uint8_t>(type_index<T>()), bits)) {
+                return default_value;
             }
+            T result;
+            std::memcpy(&result, &bits, sizeof(T));
+            return result;
         }
+    }
 
-        xSemaphoreGive(get_mutex());
-        return result;
+    template <typename T>
+    static T get(const std::string& key_name, T default_value) {
+        return get<T>(find(key_name), std::move(default_value));
+    }
+
+    // Типізоване читання: тип значення задає дескриптор
+    template <typename T>
+    static T get(StateRef<T> ref, typename StateRef<T>::value_type default_value) {
+        return get<T>(ref.handle, std::move(default_value));
+    }
+
+    template <typename T>
+    static T get(const StateKey<T>& descriptor, typename StateKey<T>::value_type default_value) {
+        return get<T>(lookup(descriptor.name, descriptor.hash), std::move(default_value));
+    }
+
+    /**
+     * @brief Оголошує ключ target похідним від ключів sources.
+     *
+     * Зміна джерела лише позначає target застарілим. Функція викликається,
+     * коли target читають (get, query, changes_since) або одразу, якщо на
+     * target є підписники; результат запам'ятовується до наступної зміни
+     * джерел. Функція читає джерела через get(). Цикли не підтримуються.
+     *
+     * Кількість викликів залежить від читачів, тому функція має бути чистою
+     * функцією поточних значень джерел. Накопичувальні значення (середні,
+     * лічильники) оновлюйте через set/Transaction на кожну вибірку.
+     * @return ESP_ERR_NO_MEM - вже оголошено MAX_DERIVED_KEYS похідних ключів.
+     */
+    static esp_err_t derive(StateHandle target, std::initializer_list<StateHandle> sources,
+                            StateDeriveFunc compute);
+
+    // Типізований варіант: compute має вигляд T()
+    template <typename T, typename F>
+    static esp_err_t derive(StateRef<T> target, std::initializer_list<StateHandle> sources, F compute) {
+        return derive(target.handle, sources, StateDeriveFunc([compute]() mutable {
+            return ValueType(std::in_place_type<T>, compute());
+        }));
+    }
+
+    /**
+     * @brief Поточна глобальна версія стану.
+     *
+     * Зростає на кожну фактичну зміну значення будь-якого ключа.
+     */
+    static uint32_t version();
+
+    /**
+     * @brief Епоха версій: випадковий ненульовий ідентифікатор, новий на кожен init().
+     *
+     * Після перезавантаження версії починаються з нуля, тож версія має сенс
+     * лише разом з епохою, в якій її отримано.
+     */
+    static uint32_t epoch();
+
+    /**
+     * @brief Обходить ключі, змінені після версії since_version.
+     *
+     * Для повного знімка передайте 0. Якщо since_epoch не збігається з
+     * epoch() (пристрій перезавантажився, версії - з іншої історії) або
+     * версія більша за поточну, теж віддається повний знімок.
+     * @param visitor Викликається поза м'ютексом для кожного зміненого ключа.
+     * @return Поточна версія - її клієнт передає в наступному запиті разом з epoch().
+     */
+    static uint32_t changes_since(uint32_t since_version, uint32_t since_epoch, const StateVisitor& visitor);
+
+    /**
+     * @brief Обходить усі ключі з назвою, що починається з prefix (напр. "cooling/").
+     *
+     * Ключі впорядковані за назвою, тож пошук - прохід по діапазону, а не
+     * по всій таблиці. Порожній prefix - усі ключі.
+     * @param visitor Викликається поза м'ютексом, у порядку назв.
+     * @return Поточна версія - для подальших запитів changes_since().
+     */
+    static uint32_t query(const std::string& prefix, const StateVisitor& visitor);
+
+    /**
+     * @brief Робить ключ persistent: його зміни записуються в NVS.
+     *
+     * Якщо ключ ще не має значення, а в NVS є збережене з попереднього
+     * запуску (прочитане в init()), воно відновлюється.
+     * Зміни пишуться задачею у фоні пакетами: не частіше ніж раз на
+     * max_dirty_age_ms (див. set_persist_config()).
+     */
+    static esp_err_t set_persistent(StateHandle handle);
+
+    template <typename T>
+    static esp_err_t set_persistent(StateRef<T> ref) {
+        return set_persistent(ref.handle);
     }
 
-    // Методи підписки/відписки
-    static SubscriptionHandle subscribe(const std::string& key, StateCallback callback);
+    static void set_persist_config(const StatePersistConfig& config);
+
+    /**
+     * @brief Негайно записує всі незбережені зміни (напр. перед перезавантаженням).
+     */
+    static esp_err_t flush();
+
+    static StatePersistStats get_persist_stats();
+
+    /**
+     * @brief Кількість set(), що не викликали підписників: значення не змінилось
+     * або зміна в межах мертвої зони.
+     */
+    static uint32_t get_suppressed_count();
+
+    /**
+     * @brief Пакет записів, що застосовуються під одним захопленням м'ютекса.
+     *
+     * Підписники викликаються лише після того, як видимі всі записи пакета,
+     * тож не бачать напівоновленого стану. Повторні записи одного ключа
+     * зливаються (перемагає останній), тож кожен підписник отримує одне
+     * сповіщення на commit(). Записи зберігаються в самому об'єкті, без купи.
+     */
+    class Transaction {
+    public:
+        static constexpr size_t MAX_WRITES = 16;
+
+        template <typename T>
+        Transaction& set(StateRef<T> ref, typename StateRef<T>::value_type value) {
+            return stage(ref.handle, ValueType(std::in_place_type<T>, std::move(value)));
+        }
+
+        /**
+         * @brief Застосовує всі записи і сповіщає підписників.
+         * @return ESP_ERR_NO_MEM, якщо записів більше за MAX_WRITES (нічого не застосовано);
+         * ESP_ERR_INVALID_ARG, якщо були невалідні хендли (решту застосовано).
+         */
+        esp_err_t commit();
+
+    private:
+        struct Write {
+            StateHandle handle = STATE_HANDLE_INVALID;
+            ValueType value;
+        };
+
+        Transaction& stage(StateHandle handle, ValueType value);
+
+        Write writes_[MAX_WRITES];
+        size_t count_ = 0;
+        bool overflow_ = false;
+    };
+
+    // Методи підписки/відписки.
+    // Підписник отримує поточне значення одразу, далі - лише фактичні зміни.
+    // ASYNC: set() лише позначає ключ брудним, задача-нотифікатор доставляє
+    // останнє значення один раз на ключ - повільний підписник не гальмує записувача
+    static SubscriptionHandle subscribe(StateHandle handle, StateCallback callback,
+                                        StateDelivery delivery = StateDelivery::SYNC);
+    static SubscriptionHandle subscribe(const std::string& key_name, StateCallback callback,
+                                        StateDelivery delivery = StateDelivery::SYNC);
+
+    template <typename T>
+    static SubscriptionHandle subscribe(StateRef<T> ref, StateCallback callback,
+                                        StateDelivery delivery = StateDelivery::SYNC) {
+        return subscribe(ref.handle, std::move(callback), delivery);
+    }
     static void unsubscribe(SubscriptionHandle handle);
 
+    // Індекс типу T у ValueType (variant_size, якщо тип не підтримується)
+    template <typename T>
+    static constexpr size_t type_index() {
+        return type_index_in<T>(static_cast<ValueType*>(nullptr));
+    }
+
+    template <typename T, typename... Ts>
+    static constexpr size_t type_index_in(std::variant<Ts...>*) {
+        constexpr bool matches[] = {std::is_same_v<T, Ts>...};
+        for (size_t i = 0; i < sizeof...(Ts); ++i) {
+            if (matches[i]) return i;
+        }
+        return sizeof...(Ts);
+    }
+
 private:
-    // Приватні статичні члени
-    static std::map<std::string, ValueType> state_map;
-    // Ключ -> Вектор пар {Хендл, Callback}
-    static std::map<std::string, std::vector<std::pair<SubscriptionHandle, StateCallback>>> subscribers;
-    // Хендл -> Ключ (для швидкої відписки)
-    static std::map<SubscriptionHandle, std::string> handle_to_key;
-    // М'ютекс для захисту доступу
+    // М'ютекс для захисту записів, створення слотів і списків підписників
     static SemaphoreHandle_t state_mutex_handle;
     // Лічильник для генерації унікальних хендлів
     static std::atomic<uint32_t> next_handle;
@@ -111,6 +396,29 @@ private:
     // Доступ до м'ютекса
     static SemaphoreHandle_t get_mutex() { return state_mutex_handle; }
 
+    // Пошук слота за хешем назви без м'ютекса
+    static StateHandle lookup(const char* name, uint32_t hash);
+
+    // Задача-нотифікатор і доставка брудного ключа ASYNC-підписникам
+    static void notifier_task(void* arg);
+    static void deliver_async(StateHandle handle);
+
+    // Перерахунок застарілих похідних ключів
+    static void evaluate_derived(StateHandle handle);
+    static void refresh_if_stale(StateHandle handle);
+    static void refresh_all_stale();
+
+    // Задача збереження і пакетний запис брудних ключів (force - не чекати max_dirty_age)
+    static void persist_task(void* arg);
+    static esp_err_t flush_persistent(bool force);
+
+    // Запис значення в слот і виклик підписників
+    static void write_value(StateHandle handle, ValueType value, bool mark_persist_dirty = true);
+    // Читання числового значення через seqlock; false - немає значення або інший тип
+    static bool read_scalar(StateHandle handle, uint8_t type, uint64_t& bits);
+    // Читання рядка під м'ютексом
+    static bool read_string(StateHandle handle, std::string& out);
+
     // Забороняємо створення екземплярів
     SharedState() = delete;
     ~SharedState() = delete;
@@ -118,4 +426,4 @@ private:
     SharedState& operator=(const SharedState&) = delete;
 };
 
-#endif // CORE_SHARED_STATE_H
\ No newline at end of file
+#endif // CORE_SHARED_STATE_H
@@ -1,5 +1,5 @@
 #include "wifi_manager.h"
-#include "config.h" // Потрібно для доступу до ConfigLoader
+#include "config_defaults.h" // ConfigLoader і типізовані поля конфігурації
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
@@ -676,8 +676,8 @@ esp_err_t WiFiManager::init() {
     }
 
     // Завантаження конфігурації
-    std::string ssid_str = ConfigLoader::get<std::string>("/wifi/ssid", "");
-    std::string pass_str = ConfigLoader::get<std::string>("/wifi/pass", "");
+    std::string ssid_str = ConfigLoader::get(config_defaults::WIFI_SSID);
+    std::string pass_str = ConfigLoader::get(config_defaults::WIFI_PASS);
 
     if (!ssid_str.empty()) {
         ESP_LOGI(TAG, "Знайдено конфігурацію Wi-Fi: SSID='%s'", ssid_str.c_str());
@@ -694,8 +694,8 @@ esp_err_t WiFiManager::init() {
 // Метод для підключення до WiFi
 esp_err_t WiFiManager::connect() {
     // Завантаження конфігурації
-    std::string ssid_str = ConfigLoader::get<std::string>("/wifi/ssid", "");
-    std::string pass_str = ConfigLoader::get<std::string>("/wifi/pass", "");
+    std::string ssid_str = ConfigLoader::get(config_defaults::WIFI_SSID);
+    std::string pass_str = ConfigLoader::get(config_defaults::WIFI_PASS);
     
     if (ssid_str.empty()) {
         ESP_LOGE(TAG, "Не знайдено SSID для підключення!");
@@ -942,11 +942,14 @@ esp_err_t WiFiManager::setCredentials(const std::string& ssid, const std::string
         return ESP_ERR_INVALID_ARG;
     }
     
-    // Зберігаємо налаштування
-    bool saved_ssid = ConfigLoader::set<const char*>("/wifi/ssid", ssid.c_str());
-    bool saved_pass = ConfigLoader::set<const char*>("/wifi/pass", password.c_str());
+    // Зберігаємо налаштування одним записом; одразу у файл - далі може бути перезавантаження
+    bool saved = false;
+    {
+        ConfigLoader::Edit edit;
+        saved = edit.set(config_defaults::WIFI_SSID.path, ssid.c_str()).set(config_defaults::WIFI_PASS.path, password.c_str()).ok();
+    }
     
-    if (!saved_ssid || !saved_pass) {
+    if (!saved || ConfigLoader::flush() != ESP_OK) {
         ESP_LOGE(TAG, "Помилка збереження конфігурації!");
         return ESP_FAIL;
     }
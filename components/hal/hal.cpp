@@ -5,10 +5,34 @@
 
 #include "hal.h"
 #include "esp_log.h"
-#include "config.h"
+#include "config_defaults.h" // ConfigLoader і типізовані поля конфігурації
+#include "event_bus.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include <algorithm>
 
 static const char* TAG = "HAL";
 
+namespace {
+    static constexpr size_t BUTTON_COUNT = 5;
+    static gpio_num_t s_button_pins[BUTTON_COUNT] = {};
+    static EventId s_evt_button_changed = EVENT_ID_INVALID;
+    static StateRef<bool> s_button_keys[BUTTON_COUNT];
+
+    static_assert(sizeof(hal_state::KEY_BUTTON_PRESSED) / sizeof(hal_state::KEY_BUTTON_PRESSED[0]) == BUTTON_COUNT,
+                  "Ключ стану потрібен для кожної кнопки");
+
+    // Обробник переривання кнопки: лише зчитує рівень і кладе подію в ISR-буфер шини
+    void IRAM_ATTR button_isr_handler(void* arg) {
+        const size_t index = reinterpret_cast<uintptr_t>(arg);
+        ButtonChangedEvent event;
+        event.button = static_cast<uint8_t>(index + 1);
+        event.level = static_cast<uint8_t>(gpio_get_level(s_button_pins[index]));
+        event.timestamp_us = esp_timer_get_time();
+        EventBus::publish_from_isr(s_evt_button_changed, event);
+    }
+}
+
 // Ініціалізація статичних членів
 std::map<std::string, gpio_num_t> HAL::component_to_pin_map;
 std::map<hal_component_type_t, std::vector<std::string>> HAL::component_type_map;
@@ -55,6 +79,11 @@ esp_err_t HAL::init() {
     };
     ESP_ERROR_CHECK(gpio_config(&button_config));
     
+    esp_err_t isr_result = init_button_interrupts();
+    if (isr_result != ESP_OK) {
+        ESP_LOGW(TAG, "Переривання кнопок не встановлено: %s", esp_err_to_name(isr_result));
+    }
+    
     // Початковий стан: всі реле вимкнені
     gpio_set_level(BOARD_PINS_CONFIG.relay1_pin, 0);
     gpio_set_level(BOARD_PINS_CONFIG.relay2_pin, 0);
@@ -65,10 +94,10 @@ esp_err_t HAL::init() {
     // Наприклад, rel1 -> "компресор", rel2 -> "вентилятор", тощо
     
     // Зазвичай ця інформація зберігається в конфігурації системи
-    std::string relay1_logical_name = ConfigLoader::get<std::string>("/hardware/relay1_name", "relay1");
-    std::string relay2_logical_name = ConfigLoader::get<std::string>("/hardware/relay2_name", "relay2");
-    std::string relay3_logical_name = ConfigLoader::get<std::string>("/hardware/relay3_name", "relay3");
-    std::string relay4_logical_name = ConfigLoader::get<std::string>("/hardware/relay4_name", "relay4");
+    std::string relay1_logical_name = ConfigLoader::get(config_defaults::HARDWARE_RELAY1_NAME);
+    std::string relay2_logical_name = ConfigLoader::get(config_defaults::HARDWARE_RELAY2_NAME);
+    std::string relay3_logical_name = ConfigLoader::get(config_defaults::HARDWARE_RELAY3_NAME);
+    std::string relay4_logical_name = ConfigLoader::get(config_defaults::HARDWARE_RELAY4_NAME);
     
     // Зіставлення логічних імен з фізичними пінами
     component_to_pin_map[relay1_logical_name] = BOARD_PINS_CONFIG.relay1_pin;
@@ -86,6 +115,48 @@ esp_err_t HAL::init() {
     return ESP_OK;
 }
 
+esp_err_t HAL::init_button_interrupts() {
+    // Ім'я реєструємо заздалегідь: intern() бере м'ютекс і не можна викликати з ISR
+    s_evt_button_changed = EventBus::intern(hal_events::EVENT_BUTTON_CHANGED);
+    if (s_evt_button_changed == EVENT_ID_INVALID) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_button_pins[0] = BOARD_PINS_CONFIG.button1_pin;
+    s_button_pins[1] = BOARD_PINS_CONFIG.button2_pin;
+    s_button_pins[2] = BOARD_PINS_CONFIG.button3_pin;
+    s_button_pins[3] = BOARD_PINS_CONFIG.button4_pin;
+    s_button_pins[4] = BOARD_PINS_CONFIG.button5_pin;
+
+    // Споживач на смузі CONTROL: диспетчер забирає запис прямо з ISR-буфера і
+    // переносить рівень у SharedState, де його бачать модулі й веб-інтерфейс
+    for (size_t i = 0; i < BUTTON_COUNT; ++i) {
+        s_button_keys[i] = SharedState::key(hal_state::KEY_BUTTON_PRESSED[i]);
+        SharedState::set(s_button_keys[i], gpio_get_level(s_button_pins[i]) == 0);
+    }
+    EventBus::subscribe(s_evt_button_changed, [](const std::string& event_name, const void* data) {
+        const ButtonChangedEvent* event = static_cast<const ButtonChangedEvent*>(data);
+        if (!event || event->button == 0 || event->button > BUTTON_COUNT) {
+            return;
+        }
+        SharedState::set(s_button_keys[event->button - 1], event->level == 0);
+    }, EventLane::CONTROL);
+
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) { // INVALID_STATE - сервіс вже встановлено
+        return err;
+    }
+
+    for (size_t i = 0; i < BUTTON_COUNT; ++i) {
+        err = gpio_isr_handler_add(s_button_pins[i], button_isr_handler, reinterpret_cast<void*>(i));
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Не вдалося додати обробник кнопки %u: %s", (unsigned)(i + 1), esp_err_to_name(err));
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
 gpio_num_t HAL::get_pin_for_component(const std::string& logical_name, hal_component_type_t component_type) {
     if (!initialized) {
         ESP_LOGW(TAG, "HAL не ініціалізовано при запиті піна для %s", logical_name.c_str());
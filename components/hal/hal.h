@@ -13,8 +13,36 @@
 #include "esp_err.h"
 #include "driver/gpio.h"
 #include "board_config.h"
+#include "shared_state.h"
 #include <string>
 #include <map>
+#include <vector>
+#include <cstdint>
+
+namespace hal_events {
+    // Публікується з переривання GPIO через EventBus::publish_from_isr
+    constexpr const char* EVENT_BUTTON_CHANGED = "hal.button_changed";
+}
+
+namespace hal_state {
+    // Чи натиснута кнопка; оновлює HAL з події hal.button_changed (смуга CONTROL)
+    static constexpr StateKey<bool> KEY_BUTTON_PRESSED[] = {
+        StateKey<bool>{"hal/buttons/1/pressed"},
+        StateKey<bool>{"hal/buttons/2/pressed"},
+        StateKey<bool>{"hal/buttons/3/pressed"},
+        StateKey<bool>{"hal/buttons/4/pressed"},
+        StateKey<bool>{"hal/buttons/5/pressed"},
+    };
+}
+
+/**
+ * @brief Подія зміни стану кнопки
+ */
+struct ButtonChangedEvent {
+    uint8_t button;        ///< Номер кнопки (1..5)
+    uint8_t level;         ///< Рівень на піні (0 = натиснута, підтяжка до живлення)
+    int64_t timestamp_us;  ///< Час переривання (esp_timer_get_time, мкс)
+};
 
 /**
  * @brief Типи апаратних компонентів
@@ -70,6 +98,11 @@ private:
     
     // Флаг ініціалізації
     static bool initialized;
+
+    /**
+     * @brief Встановлює обробники переривань кнопок
+     */
+    static esp_err_t init_button_interrupts();
 };
 
 // Інтерфейси для конкретних компонентів
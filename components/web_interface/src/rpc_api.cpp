@@ -11,6 +11,7 @@
 // --- Додані залежності для обробників ---
 #include "core/config.h"
 #include "core/shared_state.h"
+#include "core/event_bus.h"
 #include "core/wifi_manager.h"
 #include "esp_system.h"       // Для esp_chip_info, esp_get_free_heap_size, esp_restart
 #include "esp_chip_info.h"    // Для esp_chip_info
@@ -56,6 +57,18 @@ namespace {
      struct cJSONDeleter { void operator()(cJSON* ptr) const { if (ptr) cJSON_Delete(ptr); } };
      using cJSONUniquePtr = std::unique_ptr<cJSON, cJSONDeleter>;
 
+     // Значення SharedState як JSON рідного типу
+     cJSON* state_value_to_json(const ValueType& value) {
+         if (auto v = std::get_if<int>(&value)) return cJSON_CreateNumber(*v);
+         if (auto v = std::get_if<float>(&value)) return cJSON_CreateNumber(*v);
+         if (auto v = std::get_if<bool>(&value)) return cJSON_CreateBool(*v);
+         if (auto v = std::get_if<std::string>(&value)) return cJSON_CreateString(v->c_str());
+         if (auto v = std::get_if<uint32_t>(&value)) return cJSON_CreateNumber(*v);
+         if (auto v = std::get_if<int64_t>(&value)) return cJSON_CreateNumber(static_cast<double>(*v));
+         if (auto v = std::get_if<double>(&value)) return cJSON_CreateNumber(*v);
+         return cJSON_CreateNull();
+     }
+
     // --- Функції-обробники для RPC-методів ---
 
     /**
@@ -186,6 +199,96 @@ namespace {
          return cJSON_CreateString(value.c_str());
     }
 
+    /**
+     * @brief Обробник для SharedState.GetChanges
+     *
+     * Параметри: {"since": <версія>, "epoch": <епоха>} з попередньої відповіді
+     * (без since або з іншою епохою, напр. після перезавантаження - повний знімок).
+     * Результат: {"version": <поточна версія>, "epoch": <епоха>, "changes": {"<ключ>": <значення>, ...}}
+     */
+    cJSON* handle_sharedstate_get_changes(const cJSON* params) {
+         ESP_LOGD(TAG, "Виклик handle_sharedstate_get_changes");
+         uint32_t since = 0;
+         uint32_t since_epoch = 0;
+         if (cJSON_IsObject(params)) {
+             cJSON* since_item = cJSON_GetObjectItemCaseSensitive(params, "since");
+             if (cJSON_IsNumber(since_item) && since_item->valuedouble > 0) {
+                 since = static_cast<uint32_t>(since_item->valuedouble);
+             }
+             cJSON* epoch_item = cJSON_GetObjectItemCaseSensitive(params, "epoch");
+             if (cJSON_IsNumber(epoch_item) && epoch_item->valuedouble > 0) {
+                 since_epoch = static_cast<uint32_t>(epoch_item->valuedouble);
+             }
+         }
+
+         cJSONUniquePtr result(cJSON_CreateObject());
+         cJSON* changes = cJSON_AddObjectToObject(result.get(), "changes");
+         if (!changes) return nullptr;
+
+         uint32_t version = SharedState::changes_since(since, since_epoch, [changes](const char* key, const ValueType& value, uint32_t) {
+             cJSON_AddItemToObject(changes, key, state_value_to_json(value));
+         });
+         cJSON_AddNumberToObject(result.get(), "version", version);
+         cJSON_AddNumberToObject(result.get(), "epoch", SharedState::epoch());
+         return result.release();
+    }
+
+    /**
+     * @brief Обробник для SharedState.Query
+     *
+     * Параметри: {"prefix": "cooling/"} (без prefix - усі ключі).
+     * Результат: {"version": <поточна версія>, "values": {"<ключ>": <значення>, ...}}
+     */
+    cJSON* handle_sharedstate_query(const cJSON* params) {
+         ESP_LOGD(TAG, "Виклик handle_sharedstate_query");
+         const char* prefix = "";
+         if (cJSON_IsObject(params)) {
+             cJSON* prefix_item = cJSON_GetObjectItemCaseSensitive(params, "prefix");
+             if (cJSON_IsString(prefix_item) && prefix_item->valuestring) {
+                 prefix = prefix_item->valuestring;
+             }
+         }
+
+         cJSONUniquePtr result(cJSON_CreateObject());
+         cJSON* values = cJSON_AddObjectToObject(result.get(), "values");
+         if (!values) return nullptr;
+
+         uint32_t version = SharedState::query(prefix, [values](const char* key, const ValueType& value, uint32_t) {
+             cJSON_AddItemToObject(values, key, state_value_to_json(value));
+         });
+         cJSON_AddNumberToObject(result.get(), "version", version);
+         return result.release();
+    }
+
+    /**
+     * @brief Обробник для EventBus.GetStats
+     */
+    cJSON* handle_eventbus_get_stats(const cJSON* params) {
+         ESP_LOGD(TAG, "Виклик handle_eventbus_get_stats");
+         return EventBus::stats_to_json(); // NULL при нестачі пам'яті -> Internal error
+    }
+
+    /**
+     * @brief Обробник для Config.Reload
+     *
+     * Перечитує user_config.json; підписники ConfigLoader отримують змінені піддерева.
+     */
+    cJSON* handle_config_reload(const cJSON* params) {
+         ESP_LOGD(TAG, "Виклик handle_config_reload");
+         if (ConfigLoader::reload() != ESP_OK) {
+              return nullptr; // Internal error
+         }
+         return cJSON_CreateTrue();
+    }
+
+    /**
+     * @brief Обробник для Config.GetStats
+     */
+    cJSON* handle_config_get_stats(const cJSON* params) {
+         ESP_LOGD(TAG, "Виклик handle_config_get_stats");
+         return ConfigLoader::stats_to_json(); // NULL при нестачі пам'яті -> Internal error
+    }
+
     // --- Інші обробники (за потреби) ---
     // cJSON* handle_restart_device(const cJSON* params) {
     //      ESP_LOGW(TAG, "Отримано команду перезавантаження через RPC!");
@@ -210,7 +313,12 @@ esp_err_t rpc_api_init() {
     rpc_api_register_handler("System.GetStatus", handle_system_get_status);
     rpc_api_register_handler("Config.GetValue", handle_config_get_value);
     rpc_api_register_handler("Config.SetValue", handle_config_set_value);
+    rpc_api_register_handler("Config.Reload", handle_config_reload);
+    rpc_api_register_handler("Config.GetStats", handle_config_get_stats);
     rpc_api_register_handler("SharedState.GetValue", handle_sharedstate_get_value);
+    rpc_api_register_handler("SharedState.GetChanges", handle_sharedstate_get_changes);
+    rpc_api_register_handler("SharedState.Query", handle_sharedstate_query);
+    rpc_api_register_handler("EventBus.GetStats", handle_eventbus_get_stats);
     // rpc_api_register_handler("System.Restart", handle_restart_device);
 
     // TODO: Дозволити модулям реєструвати власні RPC-методи,
@@ -235,7 +343,7 @@ esp_err_t rpc_api_register_handler(const char* method_name, rpc_handler_func_t h
     } else {
         ESP_LOGI(TAG, "Реєстрація RPC-методу: %s", method_name);
     }
-    s_rpc_handlers[method_name] = handler;
+    s_rpc_handlers[method_name] = std::move(handler);
     return ESP_OK;
 }
 
@@ -292,7 +400,7 @@ char* rpc_api_handle_request_str(const char* request_body, size_t body_len) {
         std::lock_guard<std::mutex> lock(s_handler_mutex);
         auto it = s_rpc_handlers.find(method->valuestring);
         if (it != s_rpc_handlers.end()) {
-            rpc_handler_func_t handler = it->second;
+            const rpc_handler_func_t& handler = it->second; // Викликаємо під s_handler_mutex
             ESP_LOGD(TAG, "Виклик обробника для методу '%s'", method->valuestring);
             result_json = handler(params_json); // Обробник повертає NULL при помилці
             if (!result_json) {
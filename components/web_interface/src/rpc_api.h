@@ -3,6 +3,7 @@
 
 #include "esp_err.h"
 #include "cJSON.h" // Потрібен для типів у сигнатурах функцій
+#include "inplace_function.h"
 
 /**
  * @brief Тип функції-обробника для RPC методу.
@@ -13,8 +14,11 @@
  * стає власником цього об'єкта і має його видалити (через cJSON_Delete).
  * Поверніть NULL, якщо сталася внутрішня помилка обробки (це призведе
  * до формування JSON-RPC помилки -32603 Internal error).
+ *
+ * Підходить і звичайна функція, і лямбда із захопленням (напр. [this] модуля),
+ * якщо захоплення влазить у буфер InplaceFunction - без алокацій у купі.
  */
-typedef cJSON* (*rpc_handler_func_t)(const cJSON* params);
+using rpc_handler_func_t = InplaceFunction<cJSON*(const cJSON* params)>;
 
 /**
  * @brief Ініціалізує систему обробки RPC API.
@@ -29,7 +33,7 @@ esp_err_t rpc_api_init();
  * @brief Реєструє функцію-обробник для конкретного RPC методу.
  *
  * @param method_name Назва RPC методу (наприклад, "System.GetInfo", "Relay.SetState").
- * @param handler Вказівник на функцію типу rpc_handler_func_t.
+ * @param handler Обробник типу rpc_handler_func_t (переміщується в реєстр).
  * @return esp_err_t ESP_OK при успіху, ESP_ERR_INVALID_ARG якщо параметри невірні.
  */
 esp_err_t rpc_api_register_handler(const char* method_name, rpc_handler_func_t handler);
@@ -8,6 +8,7 @@
 #include <set>     // Використовуємо set для автоматичного уникнення дублікатів та швидкого пошуку/видалення
 #include <mutex>   // Використаємо std::mutex для простоти в цьому модулі
 #include <vector>  // Для копіювання списку клієнтів перед розсилкою
+#include <cstring> // strlen
 
 static const char *TAG = "WebSocketManager";
 
@@ -18,7 +19,7 @@ namespace {
     static std::mutex s_clients_mutex;
 
     // Обробник подій від EventBus
-    static void websocket_event_handler(const std::string& event_name, void* event_data) {
+    static void websocket_event_handler(const std::string& event_name, const void* event_data) {
         ESP_LOGD(TAG, "Отримано подію '%s' від EventBus для WebSocket", event_name.c_str());
 
         // Формуємо JSON повідомлення на основі події
@@ -33,7 +34,7 @@ namespace {
         if (event_name == "temperature_update" && event_data) {
             // Припускаємо, що event_data це вказівник на структуру
             // typedef struct { const char* id; float value; } TempData;
-            // TempData* data = static_cast<TempData*>(event_data);
+            // const TempData* data = static_cast<const TempData*>(event_data);
             cJSON* data_obj = cJSON_CreateObject();
             // cJSON_AddStringToObject(data_obj, "sensorId", data->id);
             // cJSON_AddNumberToObject(data_obj, "value", data->value);
@@ -45,6 +46,11 @@ namespace {
              cJSON_AddNullToObject(payload, "data");
         }
         // ... інші обробники подій ...
+        // Події підсистем, на які підписано шаблоном: клієнту достатньо імені,
+        // актуальні значення він дочитує через RPC
+        else if (event_name.compare(0, 8, "cooling.") == 0 || event_name.compare(0, 5, "wifi.") == 0) {
+             cJSON_AddNullToObject(payload, "data");
+        }
         else {
              // Подія невідома або не має даних для WS
              cJSON_Delete(payload);
@@ -74,10 +80,15 @@ esp_err_t websocket_manager_init() {
 
     // Підписуємось на системні події, які хочемо транслювати
     // TODO: Замініть "some_event", "temperature_update" на реальні імена ваших подій
-    EventBus::subscribe("some_event", websocket_event_handler);
-    EventBus::subscribe("temperature_update", websocket_event_handler);
-    EventBus::subscribe("relay_toggled", websocket_event_handler);
-     EventBus::subscribe("SystemStarted", websocket_event_handler); // Наприклад
+    // Серіалізація JSON та mg_ws_send повільні - працюємо в смузі телеметрії,
+    // щоб не затримувати події керування
+    EventBus::subscribe("some_event", websocket_event_handler, EventLane::TELEMETRY);
+    EventBus::subscribe("temperature_update", websocket_event_handler, EventLane::TELEMETRY);
+    EventBus::subscribe("relay_toggled", websocket_event_handler, EventLane::TELEMETRY);
+     EventBus::subscribe("SystemStarted", websocket_event_handler, EventLane::TELEMETRY); // Наприклад
+    // Цілі підсистеми - одним шаблоном замість підписки на кожне ім'я
+    EventBus::subscribe("cooling.*", websocket_event_handler, EventLane::TELEMETRY);
+    EventBus::subscribe("wifi.*", websocket_event_handler, EventLane::TELEMETRY);
 
     ESP_LOGI(TAG, "Підписано на події EventBus для трансляції WebSocket.");
 
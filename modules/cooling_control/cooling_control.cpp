@@ -8,11 +8,41 @@
 #include "cooling_control_state.h"
 #include "esp_log.h"
 #include "shared_state.h"
+#include "config_defaults.h"
 #include "event_bus.h"
+#include <cmath>
 #include <ctime>
 
 static const char* TAG = "CoolingControl";
 
+namespace {
+    // Ідентифікатори подій модуля, отримуються один раз в init()
+    EventId s_evt_temperature_changed = EVENT_ID_INVALID;
+    EventId s_evt_compressor_state_changed = EVENT_ID_INVALID;
+    EventId s_evt_fan_state_changed = EVENT_ID_INVALID;
+    EventId s_evt_target_temperature_changed = EVENT_ID_INVALID;
+    EventId s_evt_mode_changed = EVENT_ID_INVALID;
+
+    // Хендли ключів SharedState, також отримуються в init()
+    StateRef<float> s_key_temp_chamber;
+    StateRef<float> s_key_temp_target;
+    StateRef<float> s_key_temp_hysteresis;
+    StateRef<bool> s_key_compressor_state;
+    StateRef<bool> s_key_fan_state;
+    StateRef<int> s_key_operation_mode;
+    StateRef<uint32_t> s_key_stats_compressor_cycles;
+    StateRef<uint32_t> s_key_stats_compressor_runtime;
+    StateRef<float> s_key_stats_avg_temperature;
+    StateRef<float> s_key_stats_avg_cycle_runtime;
+
+    ConfigSubscriptionHandle s_hysteresis_subscription = 0;
+
+    // Допустимий діапазон гістерезису, як у слайдері UI
+    bool is_valid_hysteresis(float hysteresis_c) {
+        return hysteresis_c >= 0.5f && hysteresis_c <= 3.0f;
+    }
+}
+
 // Конструктор модуля
 CoolingControlModule::CoolingControlModule()
     : chamber_temp_sensor_(nullptr),
@@ -23,6 +53,7 @@ CoolingControlModule::CoolingControlModule()
       mode_(OperationMode::AUTO),
       min_compressor_off_time_sec_(300), // 5 хвилин за замовчуванням
       current_chamber_temp_c_(0.0f),
+      avg_chamber_temp_c_(NAN),
       compressor_running_(false),
       fan_running_(false),
       last_compressor_stop_time_(0),
@@ -65,35 +96,91 @@ esp_err_t CoolingControlModule::init()
         return actuator_result;
     }
     
+    // Реєстрація імен подій у шині (далі публікуємо лише за EventId)
+    s_evt_temperature_changed = EventBus::intern(cooling_events::EVENT_TEMPERATURE_CHANGED);
+    s_evt_compressor_state_changed = EventBus::intern(cooling_events::EVENT_COMPRESSOR_STATE_CHANGED);
+    s_evt_fan_state_changed = EventBus::intern(cooling_events::EVENT_FAN_STATE_CHANGED);
+    s_evt_target_temperature_changed = EventBus::intern(cooling_events::EVENT_TARGET_TEMPERATURE_CHANGED);
+    s_evt_mode_changed = EventBus::intern(cooling_events::EVENT_MODE_CHANGED);
+
+    // Температуру споживачам потрібно лише останню, а зміни стану обладнання губити не можна
+    EventBus::set_policy(s_evt_temperature_changed, EventPolicy::COALESCE);
+    EventBus::set_policy(s_evt_compressor_state_changed, EventPolicy::MUST_DELIVER);
+    EventBus::set_policy(s_evt_fan_state_changed, EventPolicy::MUST_DELIVER);
+    EventBus::set_policy(s_evt_target_temperature_changed, EventPolicy::MUST_DELIVER);
+    EventBus::set_policy(s_evt_mode_changed, EventPolicy::MUST_DELIVER);
+
+    // Ключі стану резолвляться один раз, далі get/set йдуть прямо в слот
+    s_key_temp_chamber = SharedState::key(cooling_state::KEY_TEMP_CHAMBER);
+    s_key_temp_target = SharedState::key(cooling_state::KEY_TEMP_TARGET);
+    s_key_temp_hysteresis = SharedState::key(cooling_state::KEY_TEMP_HYSTERESIS);
+    s_key_compressor_state = SharedState::key(cooling_state::KEY_COMPRESSOR_STATE);
+    s_key_fan_state = SharedState::key(cooling_state::KEY_FAN_STATE);
+    s_key_operation_mode = SharedState::key(cooling_state::KEY_OPERATION_MODE);
+    s_key_stats_compressor_cycles = SharedState::key(cooling_state::KEY_STATS_COMPRESSOR_CYCLES);
+    s_key_stats_compressor_runtime = SharedState::key(cooling_state::KEY_STATS_COMPRESSOR_RUNTIME);
+    s_key_stats_avg_temperature = SharedState::key(cooling_state::KEY_STATS_AVG_TEMPERATURE);
+    s_key_stats_avg_cycle_runtime = SharedState::key(cooling_state::KEY_STATS_AVG_CYCLE_RUNTIME);
+
+    // Уставка і статистика компресора мають пережити перезавантаження
+    SharedState::set_persistent(s_key_temp_target);
+    SharedState::set_persistent(s_key_stats_compressor_cycles);
+    SharedState::set_persistent(s_key_stats_compressor_runtime);
+
+    // Середня тривалість циклу рахується лише при читанні (веб, Query RPC), не на такті
+    SharedState::derive(s_key_stats_avg_cycle_runtime,
+                        {s_key_stats_compressor_runtime.handle, s_key_stats_compressor_cycles.handle}, [] {
+        uint32_t cycles = SharedState::get(s_key_stats_compressor_cycles, 0);
+        uint32_t runtime = SharedState::get(s_key_stats_compressor_runtime, 0);
+        return cycles > 0 ? static_cast<float>(runtime) / cycles : 0.0f;
+    });
+
     // Завантаження конфігурації
-    target_temp_c_ = SharedState::get<float>(cooling_state::KEY_TEMP_TARGET, 4.0f);
-    hysteresis_c_ = SharedState::get<float>(cooling_state::KEY_TEMP_HYSTERESIS, 1.0f);
-    mode_ = static_cast<OperationMode>(SharedState::get<int>(cooling_state::KEY_OPERATION_MODE, static_cast<int>(OperationMode::AUTO)));
+    target_temp_c_ = SharedState::get(s_key_temp_target, 4.0f);
+    // Гістерезис - з конфігурації; зміни (Config.SetValue, reload) приходять підпискою
+    // Callback виконується в потоці писача конфігурації (httpd, RPC), тому
+    // гістерезис - атомарний: задача керування читає його без блокувань
+    const float configured_hysteresis = ConfigLoader::get(config_defaults::CONTROL_HYSTERESIS);
+    if (is_valid_hysteresis(configured_hysteresis)) {
+        hysteresis_c_.store(configured_hysteresis);
+    } else {
+        ESP_LOGW(TAG, "Гістерезис %.2f°C у конфігурації поза діапазоном 0.5-3.0, використовується %.1f°C",
+                 configured_hysteresis, hysteresis_c_.load());
+    }
+    s_hysteresis_subscription = ConfigLoader::subscribe(config_defaults::CONTROL_HYSTERESIS.path, [this](const char* path, const cJSON* value) {
+        if (!cJSON_IsNumber(value) || set_hysteresis(static_cast<float>(value->valuedouble)) != ESP_OK) {
+            ESP_LOGW(TAG, "Некоректне значення %s у конфігурації, гістерезис не змінено", path);
+        }
+    });
+    mode_ = static_cast<OperationMode>(SharedState::get(s_key_operation_mode, static_cast<int>(OperationMode::AUTO)));
     
     // Завантаження статистики, якщо є в SharedState
-    compressor_cycles_ = SharedState::get<uint32_t>(cooling_state::KEY_STATS_COMPRESSOR_CYCLES, 0);
-    compressor_on_time_ = SharedState::get<uint32_t>(cooling_state::KEY_STATS_COMPRESSOR_RUNTIME, 0);
+    compressor_cycles_ = SharedState::get(s_key_stats_compressor_cycles, 0);
+    compressor_on_time_ = SharedState::get(s_key_stats_compressor_runtime, 0);
+    avg_chamber_temp_c_ = SharedState::get(s_key_stats_avg_temperature, NAN);
     
     // Збереження початкового стану в SharedState
-    SharedState::set<float>(cooling_state::KEY_TEMP_TARGET, target_temp_c_);
-    SharedState::set<float>(cooling_state::KEY_TEMP_HYSTERESIS, hysteresis_c_);
-    SharedState::set<int>(cooling_state::KEY_OPERATION_MODE, static_cast<int>(mode_));
-    SharedState::set<bool>(cooling_state::KEY_COMPRESSOR_STATE, compressor_running_);
-    SharedState::set<bool>(cooling_state::KEY_FAN_STATE, fan_running_);
+    SharedState::Transaction initial_state;
+    initial_state.set(s_key_temp_target, target_temp_c_)
+                 .set(s_key_temp_hysteresis, hysteresis_c_.load())
+                 .set(s_key_operation_mode, static_cast<int>(mode_))
+                 .set(s_key_compressor_state, compressor_running_)
+                 .set(s_key_fan_state, fan_running_);
+    initial_state.commit();
     
     // Підписка на події
-    EventBus::subscribe("SystemStarted", [this](const void* data) {
+    EventBus::subscribe("SystemStarted", [this](const std::string& event_name, const void* data) {
         ESP_LOGI(TAG, "Отримано подію SystemStarted");
     });
     
     // Підписка на події про зміну режиму від інших модулів
     // Наприклад, коли модуль розморожування вмикається, треба зупинити компресор
-    EventBus::subscribe("defrost.started", [this](const void* data) {
+    EventBus::subscribe("defrost.started", [this](const std::string& event_name, const void* data) {
         ESP_LOGI(TAG, "Отримано подію defrost.started - зупиняємо охолодження");
         if (compressor_running_) {
             set_compressor_state(false);
         }
-    });
+    }, EventLane::CONTROL);
     
     // Початкове зчитування температури
     read_temperatures();
@@ -138,8 +225,15 @@ void CoolingControlModule::stop()
     }
     
     // Збереження статистики в SharedState
-    SharedState::set<uint32_t>(cooling_state::KEY_STATS_COMPRESSOR_CYCLES, compressor_cycles_);
-    SharedState::set<uint32_t>(cooling_state::KEY_STATS_COMPRESSOR_RUNTIME, compressor_on_time_);
+    SharedState::Transaction stats;
+    stats.set(s_key_stats_compressor_cycles, compressor_cycles_)
+         .set(s_key_stats_compressor_runtime, compressor_on_time_);
+    stats.commit();
+    SharedState::flush();
+
+    // Після unsubscribe() callback з this гарантовано не виконується
+    ConfigLoader::unsubscribe(s_hysteresis_subscription);
+    s_hysteresis_subscription = 0;
     
     ESP_LOGI(TAG, "Модуль зупинено");
 }
@@ -176,7 +270,7 @@ esp_err_t CoolingControlModule::get_ui_schema(cJSON* module_schema_parent)
                 cJSON_AddStringToObject(temp_item, "type", "value");
                 cJSON_AddStringToObject(temp_item, "name", "chamber_temp");
                 cJSON_AddStringToObject(temp_item, "label", "Температура камери");
-                cJSON_AddStringToObject(temp_item, "value_key", cooling_state::KEY_TEMP_CHAMBER);
+                cJSON_AddStringToObject(temp_item, "value_key", cooling_state::KEY_TEMP_CHAMBER.name);
                 cJSON_AddStringToObject(temp_item, "unit", "°C");
                 cJSON_AddNumberToObject(temp_item, "precision", 1);
                 cJSON_AddItemToArray(status_items, temp_item);
@@ -188,7 +282,7 @@ esp_err_t CoolingControlModule::get_ui_schema(cJSON* module_schema_parent)
                 cJSON_AddStringToObject(compressor_item, "type", "indicator");
                 cJSON_AddStringToObject(compressor_item, "name", "compressor");
                 cJSON_AddStringToObject(compressor_item, "label", "Компресор");
-                cJSON_AddStringToObject(compressor_item, "value_key", cooling_state::KEY_COMPRESSOR_STATE);
+                cJSON_AddStringToObject(compressor_item, "value_key", cooling_state::KEY_COMPRESSOR_STATE.name);
                 cJSON_AddItemToArray(status_items, compressor_item);
             }
             
@@ -254,7 +348,7 @@ esp_err_t CoolingControlModule::get_ui_schema(cJSON* module_schema_parent)
                 cJSON_AddStringToObject(mode_select, "type", "select");
                 cJSON_AddStringToObject(mode_select, "name", "mode");
                 cJSON_AddStringToObject(mode_select, "label", "Режим роботи");
-                cJSON_AddStringToObject(mode_select, "value_key", cooling_state::KEY_OPERATION_MODE);
+                cJSON_AddStringToObject(mode_select, "value_key", cooling_state::KEY_OPERATION_MODE.name);
                 cJSON_AddStringToObject(mode_select, "action", "cooling.set_mode");
                 
                 // Варіанти вибору
@@ -293,7 +387,7 @@ esp_err_t CoolingControlModule::get_ui_schema(cJSON* module_schema_parent)
                 cJSON_AddStringToObject(compressor_btn, "type", "toggle");
                 cJSON_AddStringToObject(compressor_btn, "name", "compressor_control");
                 cJSON_AddStringToObject(compressor_btn, "label", "Компресор");
-                cJSON_AddStringToObject(compressor_btn, "value_key", cooling_state::KEY_COMPRESSOR_STATE);
+                cJSON_AddStringToObject(compressor_btn, "value_key", cooling_state::KEY_COMPRESSOR_STATE.name);
                 cJSON_AddStringToObject(compressor_btn, "action", "cooling.set_compressor");
                 cJSON_AddStringToObject(compressor_btn, "condition", "mode==1"); // Доступно тільки в ручному режимі
                 
@@ -306,7 +400,7 @@ esp_err_t CoolingControlModule::get_ui_schema(cJSON* module_schema_parent)
                 cJSON_AddStringToObject(fan_btn, "type", "toggle");
                 cJSON_AddStringToObject(fan_btn, "name", "fan_control");
                 cJSON_AddStringToObject(fan_btn, "label", "Вентилятор");
-                cJSON_AddStringToObject(fan_btn, "value_key", cooling_state::KEY_FAN_STATE);
+                cJSON_AddStringToObject(fan_btn, "value_key", cooling_state::KEY_FAN_STATE.name);
                 cJSON_AddStringToObject(fan_btn, "action", "cooling.set_fan");
                 cJSON_AddStringToObject(fan_btn, "condition", "mode==1"); // Доступно тільки в ручному режимі
                 
@@ -339,7 +433,7 @@ esp_err_t CoolingControlModule::set_target_temperature(float temp_c)
     target_temp_c_ = temp_c;
     
     // Оновлення в SharedState
-    SharedState::set<float>(cooling_state::KEY_TEMP_TARGET, target_temp_c_);
+    SharedState::set(s_key_temp_target, target_temp_c_);
     
     // Публікація події
     cooling_events::TargetTemperatureChangedEvent event = {
@@ -349,7 +443,7 @@ esp_err_t CoolingControlModule::set_target_temperature(float temp_c)
         .is_manual = true
     };
     
-    EventBus::publish(cooling_events::EVENT_TARGET_TEMPERATURE_CHANGED, &event);
+    EventBus::publish(s_evt_target_temperature_changed, event);
     
     ESP_LOGI(TAG, "Встановлено цільову температуру: %.1f°C", target_temp_c_);
     return ESP_OK;
@@ -364,23 +458,23 @@ float CoolingControlModule::get_target_temperature() const
 // Встановлення гістерезису
 esp_err_t CoolingControlModule::set_hysteresis(float hysteresis_c)
 {
-    if (hysteresis_c < 0.5f || hysteresis_c > 3.0f) {
+    if (!is_valid_hysteresis(hysteresis_c)) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    hysteresis_c_ = hysteresis_c;
+    hysteresis_c_.store(hysteresis_c);
     
     // Оновлення в SharedState
-    SharedState::set<float>(cooling_state::KEY_TEMP_HYSTERESIS, hysteresis_c_);
+    SharedState::set(s_key_temp_hysteresis, hysteresis_c);
     
-    ESP_LOGI(TAG, "Встановлено гістерезис: %.1f°C", hysteresis_c_);
+    ESP_LOGI(TAG, "Встановлено гістерезис: %.1f°C", hysteresis_c);
     return ESP_OK;
 }
 
 // Отримання поточного гістерезису
 float CoolingControlModule::get_hysteresis() const
 {
-    return hysteresis_c_;
+    return hysteresis_c_.load();
 }
 
 // Встановлення режиму роботи
@@ -397,7 +491,7 @@ esp_err_t CoolingControlModule::set_mode(OperationMode mode)
     mode_ = mode;
     
     // Оновлення в SharedState
-    SharedState::set<int>(cooling_state::KEY_OPERATION_MODE, static_cast<int>(mode_));
+    SharedState::set(s_key_operation_mode, static_cast<int>(mode_));
     
     // При переході в режим OFF, вимкнути компресор і вентилятор
     if (mode_ == OperationMode::OFF) {
@@ -418,7 +512,7 @@ esp_err_t CoolingControlModule::set_mode(OperationMode mode)
         .is_manual = true
     };
     
-    EventBus::publish(cooling_events::EVENT_MODE_CHANGED, &event);
+    EventBus::publish(s_evt_mode_changed, event);
     
     ESP_LOGI(TAG, "Встановлено режим роботи: %d", static_cast<int>(mode_));
     return ESP_OK;
@@ -474,8 +568,12 @@ esp_err_t CoolingControlModule::set_compressor_state(bool state)
         }
     }
     
-    // Оновлення стану в SharedState
-    SharedState::set<bool>(cooling_state::KEY_COMPRESSOR_STATE, compressor_running_);
+    // Оновлення стану в SharedState: стан і статистика видимі разом
+    SharedState::Transaction update;
+    update.set(s_key_compressor_state, compressor_running_)
+          .set(s_key_stats_compressor_cycles, compressor_cycles_)
+          .set(s_key_stats_compressor_runtime, compressor_on_time_);
+    update.commit();
     
     // Публікація події про зміну стану компресора
     cooling_events::CompressorStateChangedEvent event = {
@@ -484,7 +582,7 @@ esp_err_t CoolingControlModule::set_compressor_state(bool state)
         .runtime_sec = (state && compressor_start_time_ > 0) ? 0 : (current_time - compressor_start_time_)
     };
     
-    EventBus::publish(cooling_events::EVENT_COMPRESSOR_STATE_CHANGED, &event);
+    EventBus::publish(s_evt_compressor_state_changed, event);
     
     ESP_LOGI(TAG, "Компресор %s", state ? "увімкнено" : "вимкнено");
     return ESP_OK;
@@ -520,7 +618,7 @@ esp_err_t CoolingControlModule::set_fan_state(bool state)
     fan_running_ = state;
     
     // Оновлення стану в SharedState
-    SharedState::set<bool>(cooling_state::KEY_FAN_STATE, fan_running_);
+    SharedState::set(s_key_fan_state, fan_running_);
     
     // Публікація події про зміну стану вентилятора
     cooling_events::FanStateChangedEvent event = {
@@ -528,7 +626,7 @@ esp_err_t CoolingControlModule::set_fan_state(bool state)
         .timestamp = static_cast<uint64_t>(time(nullptr) * 1000)
     };
     
-    EventBus::publish(cooling_events::EVENT_FAN_STATE_CHANGED, &event);
+    EventBus::publish(s_evt_fan_state_changed, event);
     
     ESP_LOGI(TAG, "Вентилятор %s", state ? "увімкнено" : "вимкнено");
     return ESP_OK;
@@ -570,27 +668,33 @@ esp_err_t CoolingControlModule::read_temperatures()
     // Оновлення внутрішнього стану
     current_chamber_temp_c_ = chamber_temp;
     
-    // Оновлення SharedState
-    SharedState::set<float>(cooling_state::KEY_TEMP_CHAMBER, chamber_temp);
+    // Якщо температура змінилася суттєво (більше 0.1°C), оновлюємо середню і публікуємо подію
+    bool significant = std::abs(prev_temp - chamber_temp) > 0.1f;
     
-    // Якщо температура змінилася суттєво (більше 0.1°C), публікуємо подію
-    if (std::abs(prev_temp - chamber_temp) > 0.1f) {
+    // Оновлення SharedState: середня рахується на кожну вибірку і видима разом з температурою
+    SharedState::Transaction sample;
+    sample.set(s_key_temp_chamber, chamber_temp);
+    if (significant) {
+        // Середня тримається в полі модуля: такт не читає SharedState
+        avg_chamber_temp_c_ = std::isnan(avg_chamber_temp_c_)
+            ? chamber_temp
+            : (avg_chamber_temp_c_ * 0.9f) + (chamber_temp * 0.1f); // Просте згладжування
+        sample.set(s_key_stats_avg_temperature, avg_chamber_temp_c_);
+    }
+    sample.commit();
+    
+    if (significant) {
         cooling_events::TemperatureChangedEvent event = {
             .temperature = chamber_temp,
             .timestamp = static_cast<uint64_t>(time(nullptr) * 1000)
         };
         
-        EventBus::publish(cooling_events::EVENT_TEMPERATURE_CHANGED, &event);
+        EventBus::publish(s_evt_temperature_changed, event);
         
         // Логування при значній зміні (більше 0.5°C)
         if (std::abs(prev_temp - chamber_temp) > 0.5f) {
             ESP_LOGI(TAG, "Температура камери: %.1f°C", chamber_temp);
         }
-        
-        // Оновлення середньої температури
-        float avg_temp = SharedState::get<float>(cooling_state::KEY_STATS_AVG_TEMPERATURE, chamber_temp);
-        avg_temp = (avg_temp * 0.9f) + (chamber_temp * 0.1f); // Просте згладжування
-        SharedState::set<float>(cooling_state::KEY_STATS_AVG_TEMPERATURE, avg_temp);
     }
     
     return ESP_OK;
@@ -620,16 +724,18 @@ esp_err_t CoolingControlModule::run_thermostat_logic()
             
             // Збільшуємо лічильник циклів компресора
             compressor_cycles_++;
-            SharedState::set<uint32_t>(cooling_state::KEY_STATS_COMPRESSOR_CYCLES, compressor_cycles_);
+            SharedState::set(s_key_stats_compressor_cycles, compressor_cycles_);
         }
     } else {
         // Компресор вимкнений, перевіряємо, чи треба увімкнути
-        if (current_chamber_temp_c_ >= (target_temp_c_ + hysteresis_c_)) {
+        // Одне читання на такт: поріг у перевірці й у журналі однаковий
+        const float hysteresis_c = hysteresis_c_.load();
+        if (current_chamber_temp_c_ >= (target_temp_c_ + hysteresis_c)) {
             // Перевіряємо, чи минув мінімальний час вимкнення компресора
             if (is_min_compressor_off_time_elapsed()) {
                 // Температура вище цільової + гістерезис, вмикаємо компресор
                 ESP_LOGI(TAG, "Температура %.1f°C перевищує поріг %.1f°C, вмикаємо компресор",
-                         current_chamber_temp_c_, target_temp_c_ + hysteresis_c_);
+                         current_chamber_temp_c_, target_temp_c_ + hysteresis_c);
                 
                 set_compressor_state(true);
                 
@@ -745,8 +851,10 @@ void CoolingControlModule::update_compressor_statistics()
         
         // Оновлюємо статистику в SharedState кожні 60 секунд
         if (current_time % 60 == 0) {
-            SharedState::set<uint32_t>(cooling_state::KEY_STATS_COMPRESSOR_RUNTIME, current_runtime);
-            SharedState::set<uint32_t>(cooling_state::KEY_STATS_COMPRESSOR_CYCLES, compressor_cycles_);
+            SharedState::Transaction stats;
+            stats.set(s_key_stats_compressor_runtime, current_runtime)
+                 .set(s_key_stats_compressor_cycles, compressor_cycles_);
+            stats.commit();
         }
     }
 }
@@ -10,6 +10,7 @@
 #include "hal.h"
 #include "ds18b20.h"
 #include "relay.h"
+#include <atomic>
 #include <memory>
 #include <string>
 #include <cJSON.h>
@@ -171,12 +172,13 @@ private:
     
     // Параметри керування
     float target_temp_c_;        ///< Цільова температура в °C
-    float hysteresis_c_;         ///< Гістерезис в °C
+    std::atomic<float> hysteresis_c_; ///< Гістерезис в °C (змінюється з потоку писача конфігурації)
     OperationMode mode_;         ///< Поточний режим роботи
     uint32_t min_compressor_off_time_sec_; ///< Мінімальний час вимкнення компресора в секундах
     
     // Змінні стану
     float current_chamber_temp_c_;    ///< Поточна температура камери
+    float avg_chamber_temp_c_;        ///< Згладжена температура камери (NAN до першої вибірки)
     bool compressor_running_;         ///< Флаг роботи компресора
     bool fan_running_;                ///< Флаг роботи вентилятора
     uint32_t last_compressor_stop_time_; ///< Час останньої зупинки компресора
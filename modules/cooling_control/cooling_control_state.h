@@ -7,19 +7,26 @@
 #define MODULES_COOLING_CONTROL_STATE_H
 
 #include <string>
+#include <cstdint>
+#include "shared_state.h"
 
 namespace cooling_state {
 
-// Ключі для SharedState
-static const char* const KEY_TEMP_CHAMBER = "cooling/temperature/chamber";
-static const char* const KEY_TEMP_TARGET = "cooling/temperature/target";
-static const char* const KEY_TEMP_HYSTERESIS = "cooling/temperature/hysteresis";
-static const char* const KEY_COMPRESSOR_STATE = "cooling/actuator/compressor";
-static const char* const KEY_FAN_STATE = "cooling/actuator/fan";
-static const char* const KEY_OPERATION_MODE = "cooling/mode";
-static const char* const KEY_STATS_COMPRESSOR_CYCLES = "cooling/stats/compressor_cycles";
-static const char* const KEY_STATS_COMPRESSOR_RUNTIME = "cooling/stats/compressor_runtime";
-static const char* const KEY_STATS_AVG_TEMPERATURE = "cooling/stats/avg_temperature";
+// Мертва зона сповіщень для температур (°C): дрібніші коливання підписникам не шлемо
+static constexpr float TEMP_DEADBAND_C = 0.05f;
+
+// Ключі для SharedState: назва, тип значення і мертва зона оголошуються тут один раз
+static constexpr StateKey<float> KEY_TEMP_CHAMBER{"cooling/temperature/chamber", TEMP_DEADBAND_C};
+static constexpr StateKey<float> KEY_TEMP_TARGET{"cooling/temperature/target"};
+static constexpr StateKey<float> KEY_TEMP_HYSTERESIS{"cooling/temperature/hysteresis"};
+static constexpr StateKey<bool> KEY_COMPRESSOR_STATE{"cooling/actuator/compressor"};
+static constexpr StateKey<bool> KEY_FAN_STATE{"cooling/actuator/fan"};
+static constexpr StateKey<int> KEY_OPERATION_MODE{"cooling/mode"};
+static constexpr StateKey<uint32_t> KEY_STATS_COMPRESSOR_CYCLES{"cooling/stats/compressor_cycles"};
+static constexpr StateKey<uint32_t> KEY_STATS_COMPRESSOR_RUNTIME{"cooling/stats/compressor_runtime"};
+static constexpr StateKey<float> KEY_STATS_AVG_TEMPERATURE{"cooling/stats/avg_temperature", TEMP_DEADBAND_C};
+// Похідний ключ: середня тривалість циклу компресора (с) = час роботи / кількість циклів
+static constexpr StateKey<float> KEY_STATS_AVG_CYCLE_RUNTIME{"cooling/stats/avg_cycle_runtime"};
 
 /**
  * @brief Повний стан холодильника для API
@@ -10,6 +10,8 @@
 #define MODULES_FRIDGE_CONTROLLER_STATE_H
 
 #include <string>
+#include <cstdint>
+#include "shared_state.h"
 
 namespace fridge_state {
 
@@ -17,39 +19,39 @@ namespace fridge_state {
 // Формат: fridge/{група}/{ключ}
 
 // Температура
-static const char* const KEY_TEMP_CHAMBER = "fridge/temperature/chamber";  // Поточна температура камери
-static const char* const KEY_TEMP_EVAPORATOR = "fridge/temperature/evaporator";  // Поточна температура випарника
-static const char* const KEY_TEMP_TARGET = "fridge/temperature/target";  // Цільова температура
-static const char* const KEY_TEMP_HYSTERESIS = "fridge/temperature/hysteresis";  // Гістерезис
+static constexpr StateKey<float> KEY_TEMP_CHAMBER{"fridge/temperature/chamber"};  // Поточна температура камери
+static constexpr StateKey<float> KEY_TEMP_EVAPORATOR{"fridge/temperature/evaporator"};  // Поточна температура випарника
+static constexpr StateKey<float> KEY_TEMP_TARGET{"fridge/temperature/target"};  // Цільова температура
+static constexpr StateKey<float> KEY_TEMP_HYSTERESIS{"fridge/temperature/hysteresis"};  // Гістерезис
 
 // Стан актуаторів
-static const char* const KEY_COMPRESSOR_STATE = "fridge/actuator/compressor";  // Стан компресора
-static const char* const KEY_FAN_STATE = "fridge/actuator/fan";  // Стан вентилятора
-static const char* const KEY_DEFROST_STATE = "fridge/actuator/defrost";  // Стан нагрівача розморожування
-static const char* const KEY_LIGHT_STATE = "fridge/actuator/light";  // Стан освітлення
+static constexpr StateKey<bool> KEY_COMPRESSOR_STATE{"fridge/actuator/compressor"};  // Стан компресора
+static constexpr StateKey<bool> KEY_FAN_STATE{"fridge/actuator/fan"};  // Стан вентилятора
+static constexpr StateKey<bool> KEY_DEFROST_STATE{"fridge/actuator/defrost"};  // Стан нагрівача розморожування
+static constexpr StateKey<bool> KEY_LIGHT_STATE{"fridge/actuator/light"};  // Стан освітлення
 
 // Режим роботи
-static const char* const KEY_OPERATION_MODE = "fridge/mode";  // Поточний режим роботи
+static constexpr StateKey<int> KEY_OPERATION_MODE{"fridge/mode"};  // Поточний режим роботи
 
 // Стан розморожування
-static const char* const KEY_DEFROST_ACTIVE = "fridge/defrost/active";  // Чи активне розморожування
-static const char* const KEY_DEFROST_PROGRESS = "fridge/defrost/progress";  // Прогрес розморожування (%)
-static const char* const KEY_LAST_DEFROST_TIME = "fridge/defrost/last_time";  // Час останнього розморожування
-static const char* const KEY_NEXT_DEFROST_TIME = "fridge/defrost/next_time";  // Час наступного розморожування
+static constexpr StateKey<bool> KEY_DEFROST_ACTIVE{"fridge/defrost/active"};  // Чи активне розморожування
+static constexpr StateKey<int> KEY_DEFROST_PROGRESS{"fridge/defrost/progress"};  // Прогрес розморожування (%)
+static constexpr StateKey<uint32_t> KEY_LAST_DEFROST_TIME{"fridge/defrost/last_time"};  // Час останнього розморожування
+static constexpr StateKey<uint32_t> KEY_NEXT_DEFROST_TIME{"fridge/defrost/next_time"};  // Час наступного розморожування
 
 // Стан дверей
-static const char* const KEY_DOOR_STATE = "fridge/door/state";  // Стан дверей (відкриті/закриті)
-static const char* const KEY_DOOR_OPEN_TIME = "fridge/door/open_time";  // Час відкриття дверей
+static constexpr StateKey<bool> KEY_DOOR_STATE{"fridge/door/state"};  // Стан дверей (відкриті/закриті)
+static constexpr StateKey<uint32_t> KEY_DOOR_OPEN_TIME{"fridge/door/open_time"};  // Час відкриття дверей
 
 // Статистика
-static const char* const KEY_STATS_COMPRESSOR_CYCLES = "fridge/stats/compressor_cycles";  // Кількість циклів компресора
-static const char* const KEY_STATS_COMPRESSOR_RUNTIME = "fridge/stats/compressor_runtime";  // Загальний час роботи компресора
-static const char* const KEY_STATS_DEFROST_COUNT = "fridge/stats/defrost_count";  // Кількість розморожувань
-static const char* const KEY_STATS_AVG_TEMPERATURE = "fridge/stats/avg_temperature";  // Середня температура
+static constexpr StateKey<uint32_t> KEY_STATS_COMPRESSOR_CYCLES{"fridge/stats/compressor_cycles"};  // Кількість циклів компресора
+static constexpr StateKey<uint32_t> KEY_STATS_COMPRESSOR_RUNTIME{"fridge/stats/compressor_runtime"};  // Загальний час роботи компресора
+static constexpr StateKey<uint32_t> KEY_STATS_DEFROST_COUNT{"fridge/stats/defrost_count"};  // Кількість розморожувань
+static constexpr StateKey<float> KEY_STATS_AVG_TEMPERATURE{"fridge/stats/avg_temperature"};  // Середня температура
 
 // Помилки
-static const char* const KEY_ERROR_CODE = "fridge/error/code";  // Код останньої помилки
-static const char* const KEY_ERROR_DESCRIPTION = "fridge/error/description";  // Опис останньої помилки
+static constexpr StateKey<int> KEY_ERROR_CODE{"fridge/error/code"};  // Код останньої помилки
+static constexpr StateKey<std::string> KEY_ERROR_DESCRIPTION{"fridge/error/description"};  // Опис останньої помилки
 
 // === Структури даних для SharedState ===
 
@@ -0,0 +1,46 @@
+#ifndef TEST_BUS_TEST_UTIL_H
+#define TEST_BUS_TEST_UTIL_H
+
+#include "event_bus.h"
+#include "host_test.h"
+#include <atomic>
+
+/**
+ * @brief Шлюз, що тримає задачу-диспетчер смуги.
+ *
+ * Callback події шлюзу блокує диспетчер, доки тест не викличе release():
+ * черги, пул payload і кільця ISR заповнюються детерміновано, без гонок
+ * із диспетчером. Створюється після EventBus::init() і живе до кінця процесу.
+ */
+class LaneGate {
+public:
+    LaneGate(const char* event_name, EventLane lane) : id_(EventBus::intern(event_name)) {
+        EventBus::subscribe(id_, [this](const std::string&, const void*) {
+            entered_.store(true);
+            while (!open_.load()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            entered_.store(false);
+        }, lane);
+    }
+
+    // Публікує подію шлюзу і чекає, поки диспетчер у нього зайде
+    bool hold() {
+        open_.store(false);
+        if (EventBus::publish(id_) != ESP_OK) return false;
+        return wait_for([this] { return entered_.load(); });
+    }
+
+    // Відкриває шлюз і чекає, поки диспетчер з нього вийде
+    bool release() {
+        open_.store(true);
+        return wait_for([this] { return !entered_.load(); });
+    }
+
+private:
+    EventId id_;
+    std::atomic<bool> entered_{false};
+    std::atomic<bool> open_{false};
+};
+
+#endif // TEST_BUS_TEST_UTIL_H
@@ -0,0 +1,116 @@
+#include "host_test.h"
+#include "esp_log.h"
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+    struct TestEntry {
+        const char* name;
+        HostTestFunc func;
+    };
+
+    // Статичний масив: реєстрація відбувається до main, без алокацій
+    constexpr size_t MAX_TESTS = 64;
+    TestEntry tests[MAX_TESTS];
+    size_t test_count = 0;
+
+    std::atomic<uint32_t> failures{0};
+    std::atomic<uint64_t> allocations{0};
+
+    void* counted_alloc(size_t size) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return malloc(size ? size : 1);
+    }
+
+    void* counted_aligned_alloc(size_t size, std::align_val_t align) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        void* ptr = nullptr;
+        const size_t alignment = static_cast<size_t>(align) < sizeof(void*) ? sizeof(void*) : static_cast<size_t>(align);
+        return posix_memalign(&ptr, alignment, size ? size : 1) == 0 ? ptr : nullptr;
+    }
+}
+
+// --- Підрахунок алокацій (-fno-exceptions: при нестачі пам'яті - nullptr) ---
+
+void* operator new(size_t size) { return counted_alloc(size); }
+void* operator new[](size_t size) { return counted_alloc(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size); }
+void* operator new(size_t size, std::align_val_t align) { return counted_aligned_alloc(size, align); }
+void* operator new[](size_t size, std::align_val_t align) { return counted_aligned_alloc(size, align); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { free(ptr); }
+
+HostTestRegistrar::HostTestRegistrar(const char* name, HostTestFunc func) {
+    if (test_count < MAX_TESTS) {
+        tests[test_count++] = TestEntry{name, func};
+    } else {
+        fprintf(stderr, "Забагато тестів, '%s' пропущено\n", name);
+        failures++;
+    }
+}
+
+void host_test_fail(const char* file, int line, const char* expr) {
+    fprintf(stderr, "  FAIL %s:%d: %s\n", file, line, expr);
+    failures++;
+}
+
+void host_test_fail_eq(const char* file, int line, const char* lhs, const char* rhs,
+                       long long lhs_value, long long rhs_value) {
+    fprintf(stderr, "  FAIL %s:%d: %s == %s (%lld != %lld)\n", file, line, lhs, rhs, lhs_value, rhs_value);
+    failures++;
+}
+
+uint64_t host_alloc_count() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t host_now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void host_bench(const char* name, const char* format, ...) {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    printf("[bench] %s: %s\n", name, text);
+}
+
+// Аргумент - підрядок назви: запускаються лише тести, що його містять
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    size_t ran = 0;
+    for (size_t i = 0; i < test_count; ++i) {
+        if (filter && !strstr(tests[i].name, filter)) continue;
+        const uint32_t before = failures.load();
+        printf("[ RUN  ] %s\n", tests[i].name);
+        fflush(stdout);
+        tests[i].func();
+        printf("[ %s ] %s\n", failures.load() == before ? " OK " : "FAIL", tests[i].name);
+        fflush(stdout);
+        ran++;
+    }
+
+    const uint32_t failed = failures.load();
+    printf("%u тестів, помилок: %u\n", (unsigned)ran, (unsigned)failed);
+    fflush(stdout);
+    fflush(stderr);
+    // Задачі-диспетчери - нескінченні потоки: виходимо без статичних деструкторів,
+    // які інакше руйнували б стан, з яким ті ще працюють
+    std::_Exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
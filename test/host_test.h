@@ -0,0 +1,78 @@
+#ifndef TEST_HOST_TEST_H
+#define TEST_HOST_TEST_H
+
+// Мінімальний раннер хост-тестів: TEST реєструє функцію, CHECK фіксує
+// помилку і продовжує, REQUIRE - фіксує і виходить з тесту.
+// Кожен test_*.cpp - окремий виконуваний файл: статичний стан компонентів
+// (EventBus, SharedState) живе один раз на процес.
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+using HostTestFunc = void (*)();
+
+struct HostTestRegistrar {
+    HostTestRegistrar(const char* name, HostTestFunc func);
+};
+
+#define TEST(name)                                                  \
+    static void name();                                             \
+    static HostTestRegistrar name##_registrar(#name, name);         \
+    static void name()
+
+void host_test_fail(const char* file, int line, const char* expr);
+void host_test_fail_eq(const char* file, int line, const char* lhs, const char* rhs,
+                       long long lhs_value, long long rhs_value);
+
+#define CHECK(cond)                                                 \
+    do {                                                            \
+        if (!(cond)) host_test_fail(__FILE__, __LINE__, #cond);     \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                      \
+    do {                                                                                    \
+        const long long check_lhs_ = static_cast<long long>(a);                             \
+        const long long check_rhs_ = static_cast<long long>(b);                             \
+        if (check_lhs_ != check_rhs_) {                                                     \
+            host_test_fail_eq(__FILE__, __LINE__, #a, #b, check_lhs_, check_rhs_);          \
+        }                                                                                   \
+    } while (0)
+
+#define REQUIRE(cond)                                               \
+    do {                                                            \
+        if (!(cond)) {                                              \
+            host_test_fail(__FILE__, __LINE__, #cond);              \
+            return;                                                 \
+        }                                                           \
+    } while (0)
+
+/**
+ * @brief Кількість викликів глобального operator new з початку процесу.
+ *
+ * Рахуються алокації всіх потоків, тож різниця до і після ділянки коду
+ * включає і роботу задач-диспетчерів.
+ */
+uint64_t host_alloc_count();
+
+// Монотонний час у наносекундах для бенчмарків
+uint64_t host_now_ns();
+
+// Рядок звіту бенчмарку: "[bench] <name>: <text>"
+void host_bench(const char* name, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Чекає, доки ready() не поверне true, опитуючи кожні 100 мкс.
+ * @return false - не дочекались за timeout_ms
+ */
+template <typename Predicate>
+bool wait_for(Predicate ready, uint32_t timeout_ms = 2000) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!ready()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return true;
+}
+
+#endif // TEST_HOST_TEST_H
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Купа хоста не обліковується: вільна пам'ять стала, пік завантаження - 0
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps);
+void heap_caps_monitor_local_minimum_free_size_start(void);
+void heap_caps_monitor_local_minimum_free_size_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,3 @@
+#pragma once
+
+// Монтування LittleFS на хості не потрібне (див. esp_vfs.h)
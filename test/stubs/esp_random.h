@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Випадкове 32-бітне число (std::random_device замість апаратного ГВЧ)
+uint32_t esp_random(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,4 @@
+#pragma once
+
+// Файли /littlefs/... відкриваються звичайним fopen(): на хості їх немає,
+// тож ConfigLoader працює з дефолтами, а flush() завершується помилкою
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+typedef struct SemaphoreDefinition* SemaphoreHandle_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+#ifdef __cplusplus
+}
+#endif
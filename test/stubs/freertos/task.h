@@ -0,0 +1,31 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct tskTaskControlBlock* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Задача - відокремлений потік; стек і пріоритет ігноруються
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stack_depth,
+                                   void* param, UBaseType_t priority, TaskHandle_t* created,
+                                   BaseType_t core_id);
+BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stack_depth,
+                       void* param, UBaseType_t priority, TaskHandle_t* created);
+
+// Для потоків, створених не через xTaskCreate, хендл створюється при першому виклику
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higher_priority_task_woken);
+
+#ifdef __cplusplus
+}
+#endif
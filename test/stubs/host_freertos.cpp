@@ -0,0 +1,333 @@
+#include "host_freertos.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <random>
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+struct tskTaskControlBlock {
+    std::mutex lock;
+    std::condition_variable notified;
+    uint32_t notify_count = 0;
+    int core_id = 0;
+};
+
+struct QueueDefinition {
+    std::mutex lock;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::vector<uint8_t> storage;   // Виділяється один раз у xQueueCreate
+    size_t item_size = 0;
+    size_t length = 0;
+    size_t head = 0;
+    size_t count = 0;
+};
+
+struct SemaphoreDefinition {
+    std::timed_mutex mutex;
+};
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::time_point process_start = Clock::now();
+    // Умовний обсяг вільної купи, як у ESP32 після старту
+    constexpr size_t HOST_HEAP_FREE = 200 * 1024;
+
+    thread_local TaskHandle_t current_task = nullptr;
+    thread_local int current_core = 0;
+
+    std::atomic<uint64_t> mutex_takes{0};
+    std::atomic<int> log_level{ESP_LOG_WARN};
+
+    // Чекає на умову з таймаутом у тіках; portMAX_DELAY - без обмеження
+    template <typename Predicate>
+    bool wait_ticks(std::condition_variable& cv, std::unique_lock<std::mutex>& lock,
+                    TickType_t ticks, Predicate ready) {
+        if (ticks == portMAX_DELAY) {
+            cv.wait(lock, ready);
+            return true;
+        }
+        return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+    }
+
+    BaseType_t queue_send(QueueHandle_t queue, const void* item, TickType_t ticks, bool to_front) {
+        if (!queue) return pdFALSE;
+        std::unique_lock<std::mutex> lock(queue->lock);
+        if (!wait_ticks(queue->not_full, lock, ticks, [queue] { return queue->count < queue->length; })) {
+            return pdFALSE;
+        }
+        size_t pos;
+        if (to_front) {
+            queue->head = (queue->head + queue->length - 1) % queue->length;
+            pos = queue->head;
+        } else {
+            pos = (queue->head + queue->count) % queue->length;
+        }
+        memcpy(&queue->storage[pos * queue->item_size], item, queue->item_size);
+        queue->count++;
+        lock.unlock();
+        queue->not_empty.notify_one();
+        return pdTRUE;
+    }
+
+    struct TaskStart {
+        TaskFunction_t function;
+        void* param;
+        TaskHandle_t handle;
+    };
+}
+
+void host_set_core_id(int core_id) {
+    current_core = core_id;
+}
+
+uint64_t host_mutex_takes() {
+    return mutex_takes.load(std::memory_order_relaxed);
+}
+
+// --- Критичні секції та ядра ---
+
+void vPortEnterCritical(portMUX_TYPE* mux) {
+    while (__atomic_exchange_n(&mux->owner, 1, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+}
+
+void vPortExitCritical(portMUX_TYPE* mux) {
+    __atomic_store_n(&mux->owner, 0, __ATOMIC_RELEASE);
+}
+
+BaseType_t xPortGetCoreID(void) {
+    return current_core;
+}
+
+// --- Задачі ---
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* /*name*/, uint32_t /*stack_depth*/,
+                                   void* param, UBaseType_t /*priority*/, TaskHandle_t* created,
+                                   BaseType_t core_id) {
+    TaskHandle_t handle = new (std::nothrow) tskTaskControlBlock();
+    if (!handle) return pdFAIL;
+    handle->core_id = (core_id >= 0 && core_id < portNUM_PROCESSORS) ? core_id : 0;
+    if (created) *created = handle;
+
+    // Задачі FreeRTOS не завершуються: потік відокремлений, процес закінчує тест
+    std::thread([start = TaskStart{task, param, handle}] {
+        current_task = start.handle;
+        current_core = start.handle->core_id;
+        start.function(start.param);
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stack_depth,
+                       void* param, UBaseType_t priority, TaskHandle_t* created) {
+    return xTaskCreatePinnedToCore(task, name, stack_depth, param, priority, created, tskNO_AFFINITY);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (!current_task) {
+        // Потік тесту: хендл живе до кінця процесу
+        current_task = new tskTaskControlBlock();
+        current_task->core_id = current_core;
+    }
+    return current_task;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return static_cast<TickType_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - process_start).count());
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(self->lock);
+    wait_ticks(self->notified, lock, ticks_to_wait, [self] { return self->notify_count > 0; });
+    const uint32_t value = self->notify_count;
+    if (value) self->notify_count = clear_on_exit ? 0 : value - 1;
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    if (!task) return pdFAIL;
+    {
+        std::lock_guard<std::mutex> lock(task->lock);
+        task->notify_count++;
+    }
+    task->notified.notify_one();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higher_priority_task_woken) {
+    xTaskNotifyGive(task);
+    if (higher_priority_task_woken) *higher_priority_task_woken = pdTRUE;
+}
+
+// --- Черги ---
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    if (length == 0 || item_size == 0) return nullptr;
+    QueueHandle_t queue = new (std::nothrow) QueueDefinition();
+    if (!queue) return nullptr;
+    queue->storage.resize(static_cast<size_t>(length) * item_size);
+    queue->item_size = item_size;
+    queue->length = length;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    return queue_send(queue, item, ticks_to_wait, false);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    return queue_send(queue, item, ticks_to_wait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    return queue_send(queue, item, ticks_to_wait, true);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* higher_priority_task_woken) {
+    const BaseType_t sent = queue_send(queue, item, 0, false);
+    if (higher_priority_task_woken) *higher_priority_task_woken = sent;
+    return sent;
+}
+
+BaseType_t xQueueSendToFrontFromISR(QueueHandle_t queue, const void* item, BaseType_t* higher_priority_task_woken) {
+    const BaseType_t sent = queue_send(queue, item, 0, true);
+    if (higher_priority_task_woken) *higher_priority_task_woken = sent;
+    return sent;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait) {
+    if (!queue) return pdFALSE;
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!wait_ticks(queue->not_empty, lock, ticks_to_wait, [queue] { return queue->count > 0; })) {
+        return pdFALSE;
+    }
+    memcpy(buffer, &queue->storage[queue->head * queue->item_size], queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    lock.unlock();
+    queue->not_full.notify_one();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->lock);
+    return static_cast<UBaseType_t>(queue->count);
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->lock);
+    return static_cast<UBaseType_t>(queue->length - queue->count);
+}
+
+// --- М'ютекси ---
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return new (std::nothrow) SemaphoreDefinition();
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+    if (!semaphore) return pdFALSE;
+    if (ticks_to_wait == portMAX_DELAY) {
+        semaphore->mutex.lock();
+    } else if (!semaphore->mutex.try_lock_for(std::chrono::milliseconds(ticks_to_wait))) {
+        return pdFALSE;
+    }
+    mutex_takes.fetch_add(1, std::memory_order_relaxed);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    if (!semaphore) return pdFALSE;
+    semaphore->mutex.unlock();
+    return pdTRUE;
+}
+
+// --- esp_timer, heap_caps, esp_random, esp_err, esp_log ---
+
+int64_t esp_timer_get_time(void) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - process_start).count();
+}
+
+size_t heap_caps_get_free_size(uint32_t /*caps*/) {
+    return HOST_HEAP_FREE;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t /*caps*/) {
+    return HOST_HEAP_FREE;
+}
+
+void heap_caps_monitor_local_minimum_free_size_start(void) {
+}
+
+void heap_caps_monitor_local_minimum_free_size_stop(void) {
+}
+
+uint32_t esp_random(void) {
+    static std::mutex random_mutex;
+    static std::random_device device;
+    std::lock_guard<std::mutex> lock(random_mutex);
+    return device();
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        default: return "ERROR";
+    }
+}
+
+void esp_log_level_set(const char* /*tag*/, esp_log_level_t level) {
+    log_level.store(level, std::memory_order_relaxed);
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+    if (level > log_level.load(std::memory_order_relaxed)) return;
+    static const char LETTERS[] = "NEWIDV";
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    fprintf(stderr, "%c (%s) %s\n", LETTERS[level], tag, line);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// Керування заглушками з тестів (на пристрої цих функцій немає)
+
+#include <stdint.h>
+
+// Ядро, яке бачить xPortGetCoreID() у поточному потоці: так потік тесту
+// імітує переривання конкретного ядра
+void host_set_core_id(int core_id);
+
+// Кількість успішних xSemaphoreTake() з початку процесу
+uint64_t host_mutex_takes();
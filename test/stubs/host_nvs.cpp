@@ -0,0 +1,138 @@
+#include "nvs.h"
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct nvs_opaque_iterator_t {
+    std::string namespace_name;
+    std::vector<std::string> keys;
+    size_t position = 0;
+};
+
+namespace {
+    struct OpenHandle {
+        std::string namespace_name;
+        bool writable;
+    };
+
+    std::mutex nvs_lock;
+    std::map<std::string, std::map<std::string, std::vector<uint8_t>>> storage;
+    std::map<nvs_handle_t, OpenHandle> open_handles;
+    nvs_handle_t next_handle = 1;
+
+    // Викликається під nvs_lock
+    std::map<std::string, std::vector<uint8_t>>* namespace_of(nvs_handle_t handle, bool for_write, esp_err_t& err) {
+        auto it = open_handles.find(handle);
+        if (it == open_handles.end()) {
+            err = ESP_ERR_NVS_INVALID_HANDLE;
+            return nullptr;
+        }
+        if (for_write && !it->second.writable) {
+            err = ESP_ERR_NVS_READ_ONLY;
+            return nullptr;
+        }
+        err = ESP_OK;
+        return &storage[it->second.namespace_name];
+    }
+}
+
+esp_err_t nvs_open(const char* namespace_name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    if (!namespace_name || !out_handle || strlen(namespace_name) >= NVS_NS_NAME_MAX_SIZE) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(nvs_lock);
+    if (open_mode == NVS_READONLY && storage.find(namespace_name) == storage.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    storage[namespace_name];
+    *out_handle = next_handle++;
+    open_handles[*out_handle] = OpenHandle{namespace_name, open_mode == NVS_READWRITE};
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(nvs_lock);
+    open_handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(nvs_lock);
+    return open_handles.count(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    if (!key || strlen(key) >= NVS_KEY_NAME_MAX_SIZE || (!value && length)) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(nvs_lock);
+    esp_err_t err;
+    auto* entries = namespace_of(handle, true, err);
+    if (!entries) return err;
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    (*entries)[key].assign(bytes, bytes + length);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length) {
+    if (!key || !length) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(nvs_lock);
+    esp_err_t err;
+    auto* entries = namespace_of(handle, false, err);
+    if (!entries) return err;
+    auto it = entries->find(key);
+    if (it == entries->end()) return ESP_ERR_NVS_NOT_FOUND;
+    if (out_value) {
+        if (*length < it->second.size()) return ESP_ERR_NVS_INVALID_LENGTH;
+        memcpy(out_value, it->second.data(), it->second.size());
+    }
+    *length = it->second.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    if (!key) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(nvs_lock);
+    esp_err_t err;
+    auto* entries = namespace_of(handle, true, err);
+    if (!entries) return err;
+    return entries->erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_entry_find(const char* /*part_name*/, const char* namespace_name, nvs_type_t type,
+                         nvs_iterator_t* output_iterator) {
+    if (!output_iterator) return ESP_ERR_INVALID_ARG;
+    *output_iterator = nullptr;
+    // Заглушка зберігає лише blob
+    if (type != NVS_TYPE_BLOB && type != NVS_TYPE_ANY) return ESP_ERR_NVS_NOT_FOUND;
+
+    std::lock_guard<std::mutex> lock(nvs_lock);
+    auto ns = storage.find(namespace_name ? namespace_name : "");
+    if (ns == storage.end() || ns->second.empty()) return ESP_ERR_NVS_NOT_FOUND;
+
+    auto* iterator = new nvs_opaque_iterator_t();
+    iterator->namespace_name = ns->first;
+    for (const auto& entry : ns->second) {
+        iterator->keys.push_back(entry.first);
+    }
+    *output_iterator = iterator;
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t* iterator) {
+    if (!iterator || !*iterator) return ESP_ERR_INVALID_ARG;
+    if (++(*iterator)->position < (*iterator)->keys.size()) return ESP_OK;
+    nvs_release_iterator(*iterator);
+    *iterator = nullptr;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_entry_info(const nvs_iterator_t iterator, nvs_entry_info_t* out_info) {
+    if (!iterator || !out_info) return ESP_ERR_INVALID_ARG;
+    memset(out_info, 0, sizeof(*out_info));
+    strncpy(out_info->namespace_name, iterator->namespace_name.c_str(), sizeof(out_info->namespace_name) - 1);
+    strncpy(out_info->key, iterator->keys[iterator->position].c_str(), sizeof(out_info->key) - 1);
+    out_info->type = NVS_TYPE_BLOB;
+    return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t iterator) {
+    delete iterator;
+}
@@ -0,0 +1,697 @@
+// ConfigLoader: читання за рядком шляху, ConfigPath і ConfigField (пропускна
+// здатність і алокації), видимість Edit у знімках, порядок сповіщень, різниця
+// знімків після reload() і unsubscribe() під час доставки, пакетування Edit,
+// debounce і верхня межа затримки задачі збереження, повтор після збою запису;
+// бінарний формат config_codec: round trip, обрізані й пошкоджені дані,
+// merge patch відносно дефолтів і переписування старих форматів.
+// Замість /littlefs - USER_CONFIG_DIR у каталозі збірки; перед init() він очищається.
+
+#include "config.h"
+#include "config_codec.h"
+#include "config_defaults.h"
+#include "host_test.h"
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    constexpr int BENCH_READS = 200000;
+
+    std::string config_file(const char* name) {
+        return std::string(USER_CONFIG_DIR) + "/" + name;
+    }
+
+    void remove_config_files() {
+        for (const char* name : {"user_config.bin", "user_config.bin.tmp", "user_config.json"}) {
+            unlink(config_file(name).c_str());
+        }
+    }
+
+    bool write_file(const std::string& path, const void* data, size_t len) {
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) return false;
+        bool ok = fwrite(data, 1, len, f) == len;
+        return fclose(f) == 0 && ok;
+    }
+
+    std::vector<uint8_t> read_file(const std::string& path) {
+        std::vector<uint8_t> data;
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) return data;
+        uint8_t buffer[256];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) data.insert(data.end(), buffer, buffer + n);
+        fclose(f);
+        return data;
+    }
+
+    bool file_exists(const std::string& path) {
+        return access(path.c_str(), F_OK) == 0;
+    }
+
+    void ensure_config() {
+        static bool ready = false;
+        if (ready) return;
+        // Файли попереднього запуску не мають впливати на дефолти
+        remove_config_files();
+        ConfigLoader::init();
+        ready = true;
+    }
+
+    // Чистий стан: незбережене скинуто у файл (фонова задача далі нічого не пише),
+    // файлів немає, конфігурація - дефолти
+    void reset_to_defaults() {
+        ConfigLoader::flush();
+        remove_config_files();
+        ConfigLoader::reload();
+    }
+
+    // Доставлені підписнику зміни: шлях і значення у JSON ("null" - видалено)
+    struct ChangeLog {
+        std::mutex mutex;
+        std::vector<std::pair<std::string, std::string>> entries;
+
+        ConfigCallback callback() {
+            return [this](const char* path, const cJSON* value) {
+                std::string text = "null";
+                if (value) {
+                    char* printed = cJSON_PrintUnformatted(value);
+                    text = printed;
+                    cJSON_free(printed);
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                entries.emplace_back(path, text);
+            };
+        }
+
+        std::vector<std::pair<std::string, std::string>> take() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return std::move(entries);
+        }
+    };
+
+    // Чекає, поки фонова задача збереження відпрацює сповіщення попередніх тестів
+    void settle_flush_task() {
+        ConfigLoader::flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(ConfigLoader::FLUSH_DEBOUNCE_MS + 200));
+    }
+
+    uint32_t flush_attempts() {
+        const ConfigPersistStats stats = ConfigLoader::get_persist_stats();
+        return stats.flushes + stats.errors;
+    }
+
+    using JsonPtr = std::unique_ptr<cJSON, void (*)(cJSON*)>;
+
+    JsonPtr json(const char* text) {
+        return JsonPtr(cJSON_Parse(text), cJSON_Delete);
+    }
+
+    JsonPtr empty_object() {
+        return JsonPtr(cJSON_CreateObject(), cJSON_Delete);
+    }
+
+    // Декодування з буфера точно потрібного розміру: вихід за межі видно під ASan
+    bool decode_exact(const std::vector<uint8_t>& data, size_t len, cJSON* target) {
+        std::unique_ptr<uint8_t[]> copy(new uint8_t[len ? len : 1]);
+        std::copy(data.begin(), data.begin() + len, copy.get());
+        return config_codec::decode_merge(copy.get(), len, target);
+    }
+
+    // Об'єкт з depth рівнями вкладеності: {"n":{"n":...{}}}
+    JsonPtr nested(int depth) {
+        JsonPtr root = empty_object();
+        cJSON* node = root.get();
+        for (int i = 0; i < depth; ++i) {
+            node = cJSON_AddObjectToObject(node, "n");
+        }
+        return root;
+    }
+
+    const char* const CODEC_SAMPLE = R"({
+        "int": 42, "negative": -7, "zero": 0, "big": 3000000000, "double": 3.25, "tiny": -0.001,
+        "text": "Камера", "empty": "", "on": true, "off": false,
+        "list": [1, 2.5, "x", null, true, {"inner": [ ]}, [ ]],
+        "control": {"set_temp": 4.5, "mode": {"name": "auto", "pins": [4, 5]}},
+        "nothing": {}
+    })";
+
+    // Значення /control/set_temp у порядку доставки
+    std::mutex observed_mutex;
+    std::vector<float> observed;
+    std::atomic<uint32_t> control_calls{0};
+}
+
+TEST(read_throughput_string_path_handle_field) {
+    ensure_config();
+    const ConfigPath handle = ConfigLoader::path("/control/set_temp");
+    REQUIRE(handle.valid());
+    // Шлях таблиці дефолтів - той самий хендл, що й у ConfigField
+    CHECK_EQ(handle.index, config_defaults::CONTROL_SET_TEMP.index);
+
+    auto measure = [](const char* label, auto read) {
+        float sum = 0.0f;
+        const uint64_t allocs_before = host_alloc_count();
+        const uint64_t started = host_now_ns();
+        for (int i = 0; i < BENCH_READS; ++i) {
+            sum += read();
+        }
+        const uint64_t elapsed = host_now_ns() - started;
+        const uint64_t allocs = host_alloc_count() - allocs_before;
+        host_bench(label, "%.1f нс/читання, %.0f читань/с, %.2f алокацій/читання",
+                   static_cast<double>(elapsed) / BENCH_READS, BENCH_READS * 1e9 / elapsed,
+                   static_cast<double>(allocs) / BENCH_READS);
+        CHECK(sum == 4.0f * BENCH_READS);
+        return allocs;
+    };
+
+    measure("get(const char*)", [] { return ConfigLoader::get("/control/set_temp", 0.0f); });
+    const uint64_t handle_allocs = measure("get(ConfigPath)", [handle] { return ConfigLoader::get(handle, 0.0f); });
+    const uint64_t field_allocs = measure("get(ConfigField)", [] { return ConfigLoader::get(config_defaults::CONTROL_SET_TEMP); });
+    CHECK_EQ(handle_allocs, 0);
+    CHECK_EQ(field_allocs, 0);
+
+    // Кілька узгоджених читань з одного знімка
+    ConfigSnapshotPtr snap = ConfigLoader::snapshot();
+    REQUIRE(snap != nullptr);
+    measure("snapshot->get(ConfigPath)", [&snap, handle] { return snap->get(handle, 0.0f); });
+}
+
+TEST(edit_is_visible_through_handles_and_snapshots) {
+    ensure_config();
+    const ConfigPath set_temp = ConfigLoader::path("/control/set_temp");
+    // Шлях, якого ще немає в конфігурації: default, доки значення не з'явиться
+    const ConfigPath pending = ConfigLoader::path("/test/pending/value");
+    REQUIRE(pending.valid());
+    CHECK_EQ(ConfigLoader::path("/test/pending/value").index, pending.index);
+    CHECK_EQ(ConfigLoader::get(pending, -1), -1);
+
+    ConfigSnapshotPtr before = ConfigLoader::snapshot();
+    {
+        ConfigLoader::Edit edit;
+        edit.set("/control/set_temp", 6.5f).set("/control/hysteresis", 2.0f).set("/test/pending/value", 17);
+        CHECK(edit.ok());
+        // До кінця Edit читачі бачать попередній знімок
+        CHECK(ConfigLoader::get(set_temp, 0.0f) == 4.0f);
+    }
+    CHECK(ConfigLoader::get(set_temp, 0.0f) == 6.5f);
+    CHECK(ConfigLoader::get(config_defaults::CONTROL_HYSTERESIS) == 2.0f);
+    CHECK(ConfigLoader::get("/control/hysteresis", 0.0f) == 2.0f);
+    CHECK_EQ(ConfigLoader::get(pending, -1), 17);
+    CHECK_EQ(ConfigLoader::snapshot()->version(), before->version() + 1);
+
+    // Старий знімок незмінний
+    CHECK(before->get(set_temp, 0.0f) == 4.0f);
+    CHECK_EQ(before->get(pending, -1), -1);
+
+    // Число читається й як int; рядок з числового вузла - значення за замовчуванням
+    CHECK_EQ(ConfigLoader::get(set_temp, -1), 6);
+    CHECK(ConfigLoader::get(set_temp, std::string("none")) == "none");
+    CHECK(ConfigLoader::set("/control/set_temp", 4.0f));
+}
+
+TEST(subscribers_see_changes_in_version_order) {
+    ensure_config();
+    const ConfigSubscriptionHandle sub = ConfigLoader::subscribe("/control/set_temp", [](const char*, const cJSON* value) {
+        control_calls.fetch_add(1);
+        if (cJSON_IsNumber(value)) {
+            std::lock_guard<std::mutex> lock(observed_mutex);
+            observed.push_back(static_cast<float>(value->valuedouble));
+        }
+    });
+    REQUIRE(sub != 0);
+
+    // Другий писач змінює сусідній ключ: доставку може вести будь-який з потоків
+    constexpr int WRITES = 500;
+    std::atomic<bool> done{false};
+    std::thread neighbour([&] {
+        float value = 1.0f;
+        while (!done.load()) {
+            ConfigLoader::set("/control/hysteresis", value);
+            value = value > 3.0f ? 1.0f : value + 0.5f;
+            std::this_thread::yield();
+        }
+    });
+    for (int i = 1; i <= WRITES; ++i) {
+        ConfigLoader::set("/control/set_temp", static_cast<float>(i));
+    }
+    done.store(true);
+    neighbour.join();
+
+    // set() повертається після доставки, яку веде: після join() жодна не триває
+    std::vector<float> seen;
+    {
+        std::lock_guard<std::mutex> lock(observed_mutex);
+        seen = observed;
+    }
+    REQUIRE(!seen.empty());
+    int backwards = 0;
+    for (size_t i = 1; i < seen.size(); ++i) {
+        if (seen[i] <= seen[i - 1]) backwards++;
+    }
+    CHECK_EQ(backwards, 0);
+    CHECK(seen.back() == static_cast<float>(WRITES));
+    // Зміни сусіднього ключа підписнику на /control/set_temp не доставляються
+    CHECK(control_calls.load() <= static_cast<uint32_t>(WRITES));
+    host_bench("config notify", "%d записів, доставлено %u змін set_temp", WRITES, control_calls.load());
+
+    ConfigLoader::unsubscribe(sub);
+    const uint32_t calls = control_calls.load();
+    ConfigLoader::set("/control/set_temp", 4.0f);
+    CHECK_EQ(control_calls.load(), calls);
+}
+
+TEST(codec_round_trip_preserves_values) {
+    JsonPtr source = json(CODEC_SAMPLE);
+    REQUIRE(source != nullptr);
+    std::vector<uint8_t> encoded;
+    REQUIRE(config_codec::encode(source.get(), encoded));
+    CHECK(config_codec::is_binary(encoded.data(), encoded.size()));
+    CHECK_EQ(config_codec::format_version(encoded.data(), encoded.size()), config_codec::FORMAT_VERSION);
+
+    JsonPtr decoded = empty_object();
+    CHECK(config_codec::decode_merge(encoded.data(), encoded.size(), decoded.get()));
+    CHECK(cJSON_Compare(source.get(), decoded.get(), true));
+    // Цілі - 4 байти, дробові й великі - double
+    CHECK(cJSON_GetObjectItemCaseSensitive(decoded.get(), "big")->valuedouble == 3000000000.0);
+    CHECK(cJSON_GetObjectItemCaseSensitive(decoded.get(), "tiny")->valuedouble == -0.001);
+
+    // Корінь - лише об'єкт; Raw не кодується
+    JsonPtr array = json("[1, 2]");
+    CHECK(!config_codec::encode(array.get(), encoded));
+    JsonPtr raw = empty_object();
+    cJSON_AddItemToObject(raw.get(), "raw", cJSON_CreateRaw("1"));
+    CHECK(!config_codec::encode(raw.get(), encoded));
+}
+
+TEST(codec_rejects_truncated_and_survives_corrupt_input) {
+    JsonPtr source = json(CODEC_SAMPLE);
+    REQUIRE(source != nullptr);
+    std::vector<uint8_t> encoded;
+    REQUIRE(config_codec::encode(source.get(), encoded));
+
+    // Будь-яке обрізання - помилка
+    int truncated_accepted = 0;
+    for (size_t len = 0; len < encoded.size(); ++len) {
+        JsonPtr target = empty_object();
+        if (decode_exact(encoded, len, target.get())) truncated_accepted++;
+    }
+    CHECK_EQ(truncated_accepted, 0);
+
+    // Зайві байти після кореня - теж
+    std::vector<uint8_t> padded = encoded;
+    padded.push_back(0);
+    JsonPtr padded_target = empty_object();
+    CHECK(!decode_exact(padded, padded.size(), padded_target.get()));
+
+    // Пошкодження кожного байта: без виходу за межі; прийняте - валідне дерево
+    int corrupt_accepted = 0;
+    for (size_t offset = 0; offset < encoded.size(); ++offset) {
+        for (uint8_t mask : {0x01, 0x80, 0xFF}) {
+            std::vector<uint8_t> corrupt = encoded;
+            corrupt[offset] ^= mask;
+            JsonPtr target = empty_object();
+            if (decode_exact(corrupt, corrupt.size(), target.get())) {
+                corrupt_accepted++;
+                std::vector<uint8_t> again;
+                CHECK(config_codec::encode(target.get(), again));
+            }
+        }
+    }
+    // Заголовок і невідома версія
+    std::vector<uint8_t> future = encoded;
+    future[4] = config_codec::FORMAT_VERSION + 1;
+    JsonPtr future_target = empty_object();
+    CHECK(!decode_exact(future, future.size(), future_target.get()));
+    const char text[] = "{\"control\":{}}";
+    CHECK(!config_codec::is_binary(reinterpret_cast<const uint8_t*>(text), sizeof(text) - 1));
+    host_bench("codec corrupt", "%u байт, прийнято %d з %u пошкоджених варіантів",
+               static_cast<unsigned>(encoded.size()), corrupt_accepted, static_cast<unsigned>(encoded.size() * 3));
+}
+
+TEST(codec_limits_nesting_depth) {
+    std::vector<uint8_t> encoded;
+    JsonPtr deepest = nested(config_codec::MAX_DEPTH);
+    REQUIRE(config_codec::encode(deepest.get(), encoded));
+    JsonPtr decoded = empty_object();
+    CHECK(config_codec::decode_merge(encoded.data(), encoded.size(), decoded.get()));
+    CHECK(cJSON_Compare(deepest.get(), decoded.get(), true));
+
+    JsonPtr too_deep = nested(config_codec::MAX_DEPTH + 1);
+    CHECK(!config_codec::encode(too_deep.get(), encoded));
+
+    // Файл з надто глибоким деревом, записаний вручну: {"n":{"n":...}}
+    std::vector<uint8_t> crafted = {'M', 'C', 'F', 'G', config_codec::FORMAT_VERSION};
+    for (int i = 0; i <= config_codec::MAX_DEPTH + 1; ++i) {
+        crafted.insert(crafted.end(), {6, 1, 0, 1, 'n'});
+    }
+    crafted.insert(crafted.end(), {6, 0, 0});
+    JsonPtr target = empty_object();
+    CHECK(!decode_exact(crafted, crafted.size(), target.get()));
+}
+
+TEST(codec_merge_null_deletes_key) {
+    JsonPtr target = json(R"({"a": 1, "b": {"c": 2, "d": 3}, "e": [1]})");
+    JsonPtr patch = json(R"({"b": {"c": null, "f": "new"}, "e": null, "a": 5})");
+    REQUIRE(target != nullptr && patch != nullptr);
+    std::vector<uint8_t> encoded;
+    REQUIRE(config_codec::encode(patch.get(), encoded));
+    CHECK(config_codec::decode_merge(encoded.data(), encoded.size(), target.get()));
+
+    JsonPtr expected = json(R"({"a": 5, "b": {"d": 3, "f": "new"}})");
+    CHECK(cJSON_Compare(expected.get(), target.get(), true));
+}
+
+TEST(merge_patch_records_only_changes) {
+    JsonPtr defaults = json(R"({"control": {"set_temp": 4.0, "hysteresis": 1.0}, "web": {"port": 80, "user": "admin"},
+                                "pins": [4, 5]})");
+    REQUIRE(defaults != nullptr);
+
+    // Без змін - порожній патч
+    CHECK(config_codec::make_merge_patch(defaults.get(), defaults.get()) == nullptr);
+
+    // Змінений лист, видалений відносно дефолтів ключ, новий ключ, замінений масив
+    JsonPtr tree = json(R"({"control": {"set_temp": 6.5, "hysteresis": 1.0}, "web": {"user": "admin"},
+                            "pins": [4, 6], "extra": {"flag": true}})");
+    JsonPtr patch(config_codec::make_merge_patch(defaults.get(), tree.get()), cJSON_Delete);
+    REQUIRE(patch != nullptr);
+    JsonPtr expected = json(R"({"control": {"set_temp": 6.5}, "web": {"port": null}, "pins": [4, 6],
+                                "extra": {"flag": true}})");
+    CHECK(cJSON_Compare(expected.get(), patch.get(), true));
+
+    // Патч, збережений у файл і накладений на дефолти, відтворює дерево
+    std::vector<uint8_t> encoded;
+    REQUIRE(config_codec::encode(patch.get(), encoded));
+    JsonPtr restored(cJSON_Duplicate(defaults.get(), true), cJSON_Delete);
+    CHECK(config_codec::decode_merge(encoded.data(), encoded.size(), restored.get()));
+    CHECK(cJSON_Compare(tree.get(), restored.get(), true));
+}
+
+TEST(full_tree_v1_file_is_rewritten_as_v2_patch) {
+    ensure_config();
+    reset_to_defaults();
+    const ConfigPath set_temp = ConfigLoader::path("/control/set_temp");
+
+    // Файл формату 1: повне дерево (дефолти + одна зміна)
+    JsonPtr full(ConfigLoader::getConfigJson(), cJSON_Delete);
+    REQUIRE(full != nullptr);
+    cJSON_ReplaceItemInObjectCaseSensitive(cJSON_GetObjectItemCaseSensitive(full.get(), "control"), "set_temp",
+                                           cJSON_CreateNumber(7.5));
+    std::vector<uint8_t> v1;
+    REQUIRE(config_codec::encode(full.get(), v1));
+    v1[4] = 1;
+    REQUIRE(write_file(config_file("user_config.bin"), v1.data(), v1.size()));
+
+    REQUIRE(ConfigLoader::reload() == ESP_OK);
+    CHECK(ConfigLoader::get(set_temp, 0.0f) == 7.5f);
+    CHECK(ConfigLoader::get_persist_stats().load_binary);
+
+    // Після завантаження повне дерево переписується як merge patch (версія 2)
+    REQUIRE(ConfigLoader::flush() == ESP_OK);
+    const std::vector<uint8_t> v2 = read_file(config_file("user_config.bin"));
+    CHECK_EQ(config_codec::format_version(v2.data(), v2.size()), 2);
+    CHECK(v2.size() < v1.size() / 4);
+    JsonPtr patch = empty_object();
+    CHECK(config_codec::decode_merge(v2.data(), v2.size(), patch.get()));
+    JsonPtr expected = json(R"({"control": {"set_temp": 7.5}})");
+    CHECK(cJSON_Compare(expected.get(), patch.get(), true));
+
+    // Переписаний файл завантажується в той самий стан
+    REQUIRE(ConfigLoader::reload() == ESP_OK);
+    CHECK(ConfigLoader::get(set_temp, 0.0f) == 7.5f);
+    host_bench("config file", "v1 (повне дерево) %u байт -> v2 (patch) %u байт",
+               static_cast<unsigned>(v1.size()), static_cast<unsigned>(v2.size()));
+    reset_to_defaults();
+}
+
+TEST(legacy_json_is_imported_and_replaced) {
+    ensure_config();
+    reset_to_defaults();
+    const char legacy[] = R"({"control": {"set_temp": 6.0, "hysteresis": 1.5}, "web": {"port": 8080}})";
+    REQUIRE(write_file(config_file("user_config.json"), legacy, sizeof(legacy) - 1));
+
+    // JSON попереднього формату зливається з дефолтами
+    REQUIRE(ConfigLoader::reload() == ESP_OK);
+    CHECK(ConfigLoader::get(config_defaults::CONTROL_SET_TEMP) == 6.0f);
+    CHECK(ConfigLoader::get(config_defaults::CONTROL_HYSTERESIS) == 1.5f);
+    CHECK_EQ(ConfigLoader::get(config_defaults::WEB_PORT), 8080);
+    CHECK(ConfigLoader::get(config_defaults::WEB_USERNAME) == "admin");
+    CHECK(!ConfigLoader::get_persist_stats().load_binary);
+
+    // Перший запис - бінарний patch, JSON видаляється
+    REQUIRE(ConfigLoader::flush() == ESP_OK);
+    CHECK(!file_exists(config_file("user_config.json")));
+    const std::vector<uint8_t> binary = read_file(config_file("user_config.bin"));
+    CHECK_EQ(config_codec::format_version(binary.data(), binary.size()), 2);
+    REQUIRE(ConfigLoader::reload() == ESP_OK);
+    CHECK_EQ(ConfigLoader::get(config_defaults::WEB_PORT), 8080);
+    reset_to_defaults();
+}
+
+TEST(reload_delivers_changed_and_removed_keys) {
+    ensure_config();
+    reset_to_defaults();
+    ChangeLog control, web;
+    const ConfigSubscriptionHandle control_sub = ConfigLoader::subscribe("/control/set_temp", control.callback());
+    const ConfigSubscriptionHandle web_sub = ConfigLoader::subscribe("/web", web.callback());
+    REQUIRE(control_sub != 0);
+    REQUIRE(web_sub != 0);
+
+    // Файл змінює set_temp і видаляє /web/port відносно дефолтів
+    JsonPtr patch = json(R"({"control": {"set_temp": 5.5}, "web": {"port": null}})");
+    std::vector<uint8_t> encoded;
+    REQUIRE(config_codec::encode(patch.get(), encoded));
+    REQUIRE(write_file(config_file("user_config.bin"), encoded.data(), encoded.size()));
+    REQUIRE(ConfigLoader::reload() == ESP_OK);
+
+    auto control_changes = control.take();
+    REQUIRE(control_changes.size() == 1);
+    CHECK(control_changes[0].first == "/control/set_temp");
+    CHECK(control_changes[0].second == "5.5");
+    // Видалений ключ приходить з value == nullptr, незмінені сусіди - ні
+    auto web_changes = web.take();
+    REQUIRE(web_changes.size() == 1);
+    CHECK(web_changes[0].first == "/web/port");
+    CHECK(web_changes[0].second == "null");
+    CHECK_EQ(ConfigLoader::get(config_defaults::WEB_PORT), config_defaults::WEB_PORT.default_value);
+
+    // Повернення до дефолтів: ключ з'являється знову
+    ConfigLoader::flush();
+    remove_config_files();
+    REQUIRE(ConfigLoader::reload() == ESP_OK);
+    web_changes = web.take();
+    REQUIRE(web_changes.size() == 1);
+    CHECK(web_changes[0].first == "/web/port");
+    CHECK(web_changes[0].second == "80");
+    CHECK(control.take().size() == 1);
+
+    ConfigLoader::unsubscribe(control_sub);
+    ConfigLoader::unsubscribe(web_sub);
+}
+
+TEST(replaced_ancestor_delivers_subscriber_subtree) {
+    ensure_config();
+    reset_to_defaults();
+    ChangeLog log;
+    const ConfigSubscriptionHandle sub = ConfigLoader::subscribe("/test/node/value", log.callback());
+    REQUIRE(sub != 0);
+
+    // /test ще немає: різниця - один новий вузол /test, а підписник отримує
+    // саме своє піддерево
+    REQUIRE(ConfigLoader::set("/test/node/value", 12));
+    auto changes = log.take();
+    REQUIRE(changes.size() == 1);
+    CHECK(changes[0].first == "/test/node/value");
+    CHECK(changes[0].second == "12");
+
+    // Зміна сусіда всередині того самого предка підписнику не доставляється
+    REQUIRE(ConfigLoader::set("/test/node/other", 1));
+    CHECK(log.take().empty());
+
+    // Файл замінює предка числом: підписник отримує свій шлях без значення
+    ConfigLoader::flush();
+    JsonPtr patch = json(R"({"test": {"node": 3}})");
+    std::vector<uint8_t> encoded;
+    REQUIRE(config_codec::encode(patch.get(), encoded));
+    REQUIRE(write_file(config_file("user_config.bin"), encoded.data(), encoded.size()));
+    REQUIRE(ConfigLoader::reload() == ESP_OK);
+    changes = log.take();
+    REQUIRE(changes.size() == 1);
+    CHECK(changes[0].first == "/test/node/value");
+    CHECK(changes[0].second == "null");
+
+    ConfigLoader::unsubscribe(sub);
+    reset_to_defaults();
+}
+
+TEST(unsubscribe_waits_for_running_callback) {
+    ensure_config();
+    // Callback захоплює лише вказівник: буфер ConfigCallback невеликий
+    struct Gate {
+        std::atomic<bool> entered{false};
+        std::atomic<bool> release{false};
+        std::atomic<bool> finished{false};
+        std::atomic<uint32_t> calls{0};
+        ConfigSubscriptionHandle handle = 0;
+    };
+    Gate gate;
+    gate.handle = ConfigLoader::subscribe("/control/set_temp", [g = &gate](const char*, const cJSON*) {
+        g->calls.fetch_add(1);
+        g->entered.store(true);
+        wait_for([g] { return g->release.load(); });
+        g->finished.store(true);
+    });
+    REQUIRE(gate.handle != 0);
+
+    // Писач (як httpd) веде доставку і застрягає в callback
+    std::thread writer([] { ConfigLoader::set("/control/set_temp", 5.0f); });
+    REQUIRE(wait_for([&] { return gate.entered.load(); }));
+
+    std::atomic<bool> unsubscribed{false};
+    std::atomic<bool> finished_before_return{false};
+    std::thread stopper([&] {
+        ConfigLoader::unsubscribe(gate.handle);
+        finished_before_return.store(gate.finished.load());
+        unsubscribed.store(true);
+    });
+    CHECK(!wait_for([&] { return unsubscribed.load(); }, 50));
+    gate.release.store(true);
+    stopper.join();
+    writer.join();
+    // Після повернення unsubscribe() callback уже завершився
+    CHECK(finished_before_return.load());
+
+    // Далі callback не викликається
+    ConfigLoader::set("/control/set_temp", 4.0f);
+    CHECK_EQ(gate.calls.load(), 1);
+
+    // Відписка з власного callback не блокує доставку
+    Gate self;
+    self.handle = ConfigLoader::subscribe("/control/set_temp", [g = &self](const char*, const cJSON*) {
+        g->calls.fetch_add(1);
+        ConfigLoader::unsubscribe(g->handle);
+    });
+    ConfigLoader::set("/control/set_temp", 4.5f);
+    ConfigLoader::set("/control/set_temp", 4.0f);
+    CHECK_EQ(self.calls.load(), 1);
+}
+
+TEST(edit_batches_changes_into_one_flush) {
+    ensure_config();
+    reset_to_defaults();
+    settle_flush_task();
+    constexpr int CHANGES = 5;
+    const ConfigPersistStats before = ConfigLoader::get_persist_stats();
+    const uint32_t attempts_before = flush_attempts();
+    const uint32_t version_before = ConfigLoader::snapshot()->version();
+
+    {
+        ConfigLoader::Edit edit;
+        for (int i = 0; i < CHANGES; ++i) {
+            edit.set(("/test/batch/k" + std::to_string(i)).c_str(), i);
+        }
+        CHECK(edit.ok());
+    }
+    // N логічних змін - один знімок, одне захоплення м'ютекса, запис відкладено
+    ConfigPersistStats after = ConfigLoader::get_persist_stats();
+    CHECK_EQ(after.writes - before.writes, CHANGES);
+    CHECK_EQ(ConfigLoader::snapshot()->version(), version_before + 1);
+    CHECK_EQ(after.lock_holds - before.lock_holds, 1);
+    CHECK_EQ(flush_attempts(), attempts_before);
+
+    // Один запис файлу після паузи debounce
+    CHECK(wait_for([&] { return flush_attempts() == attempts_before + 1; }, ConfigLoader::FLUSH_DEBOUNCE_MS + 2000));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    after = ConfigLoader::get_persist_stats();
+    CHECK_EQ(after.flushes - before.flushes, 1);
+    CHECK_EQ(after.errors - before.errors, 0);
+
+    // Файл - merge patch з усіма змінами, записаний через тимчасовий
+    const std::vector<uint8_t> stored = read_file(config_file("user_config.bin"));
+    CHECK_EQ(after.bytes_written - before.bytes_written, stored.size());
+    CHECK(!file_exists(config_file("user_config.bin.tmp")));
+    JsonPtr patch = empty_object();
+    CHECK(config_codec::decode_merge(stored.data(), stored.size(), patch.get()));
+    JsonPtr expected = json(R"({"test": {"batch": {"k0": 0, "k1": 1, "k2": 2, "k3": 3, "k4": 4}}})");
+    CHECK(cJSON_Compare(expected.get(), patch.get(), true));
+
+    // Похідні метрики в stats_to_json() узгоджені з лічильниками
+    JsonPtr stats(ConfigLoader::stats_to_json(), cJSON_Delete);
+    REQUIRE(stats != nullptr);
+    const cJSON* bytes_per_write = cJSON_GetObjectItemCaseSensitive(stats.get(), "bytesPerWrite");
+    const cJSON* lock_hold_avg = cJSON_GetObjectItemCaseSensitive(stats.get(), "lockHoldAvgUs");
+    REQUIRE(cJSON_IsNumber(bytes_per_write));
+    REQUIRE(cJSON_IsNumber(lock_hold_avg));
+    CHECK(bytes_per_write->valuedouble == static_cast<double>(after.bytes_written) / after.writes);
+    CHECK(lock_hold_avg->valuedouble == static_cast<double>(after.lock_hold_total_us) / after.lock_holds);
+    CHECK(lock_hold_avg->valuedouble <= after.lock_hold_max_us);
+    host_bench("config persist", "%u змін, %u записів файлу, %.1f байт/зміну, м'ютекс сер. %.1f мкс, макс. %u мкс",
+               after.writes, after.flushes, bytes_per_write->valuedouble, lock_hold_avg->valuedouble,
+               after.lock_hold_max_us);
+    reset_to_defaults();
+}
+
+TEST(flush_task_debounces_and_caps_delay) {
+    ensure_config();
+    reset_to_defaults();
+    settle_flush_task();
+    const ConfigPath value = ConfigLoader::path("/test/debounce/value");
+
+    // Зміни частіше за FLUSH_DEBOUNCE_MS: поки вони йдуть, запису немає
+    uint32_t attempts = flush_attempts();
+    for (int i = 1; i <= 4; ++i) {
+        ConfigLoader::set("/test/debounce/value", i);
+        std::this_thread::sleep_for(std::chrono::milliseconds(ConfigLoader::FLUSH_DEBOUNCE_MS / 2));
+    }
+    CHECK_EQ(flush_attempts(), attempts);
+    CHECK(wait_for([&] { return flush_attempts() == attempts + 1; }, ConfigLoader::FLUSH_DEBOUNCE_MS + 1000));
+
+    // Безперервні зміни: запис усе одно відбувається через FLUSH_MAX_DELAY_MS
+    attempts = flush_attempts();
+    const uint64_t started = host_now_ns();
+    uint64_t flushed_after_ms = 0;
+    for (int i = 100; flushed_after_ms == 0; ++i) {
+        ConfigLoader::set("/test/debounce/value", i);
+        std::this_thread::sleep_for(std::chrono::milliseconds(ConfigLoader::FLUSH_DEBOUNCE_MS / 4));
+        const uint64_t elapsed_ms = (host_now_ns() - started) / 1000000;
+        if (flush_attempts() != attempts) {
+            flushed_after_ms = elapsed_ms;
+        } else if (elapsed_ms > 2 * ConfigLoader::FLUSH_MAX_DELAY_MS) {
+            break;
+        }
+    }
+    CHECK(flushed_after_ms >= ConfigLoader::FLUSH_MAX_DELAY_MS * 9 / 10);
+    CHECK(flushed_after_ms <= ConfigLoader::FLUSH_MAX_DELAY_MS + ConfigLoader::FLUSH_DEBOUNCE_MS);
+    host_bench("config flush", "безперервні зміни: перший запис через %u мс", static_cast<unsigned>(flushed_after_ms));
+    CHECK(ConfigLoader::get(value, 0) >= 100);
+    reset_to_defaults();
+}
+
+TEST(failed_flush_keeps_changes_for_next_attempt) {
+    ensure_config();
+    reset_to_defaults();
+    // Каталог на місці тимчасового файлу: fopen() не вдається
+    const std::string tmp_path = config_file("user_config.bin.tmp");
+    REQUIRE(mkdir(tmp_path.c_str(), 0700) == 0);
+    const uint32_t errors_before = ConfigLoader::get_persist_stats().errors;
+    REQUIRE(ConfigLoader::set("/control/set_temp", 5.5f));
+    CHECK(ConfigLoader::flush() != ESP_OK);
+    CHECK(ConfigLoader::get_persist_stats().errors > errors_before);
+    CHECK(!file_exists(config_file("user_config.bin")));
+
+    // Незбережену версію записує наступна спроба
+    REQUIRE(rmdir(tmp_path.c_str()) == 0);
+    CHECK_EQ(ConfigLoader::flush(), ESP_OK);
+    const std::vector<uint8_t> stored = read_file(config_file("user_config.bin"));
+    JsonPtr patch = empty_object();
+    CHECK(config_codec::decode_merge(stored.data(), stored.size(), patch.get()));
+    JsonPtr expected = json(R"({"control": {"set_temp": 5.5}})");
+    CHECK(cJSON_Compare(expected.get(), patch.get(), true));
+    reset_to_defaults();
+}
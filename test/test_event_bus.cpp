@@ -0,0 +1,339 @@
+// EventBus: затримка публікація -> callback і алокації на подію (за EventId
+// і за іменем), вичерпання і звільнення пулу payload, політики переповнення
+// черги смуги (COALESCE, DROP_OLDEST, MUST_DELIVER) і їхні лічильники.
+
+#include "event_bus.h"
+#include "bus_test_util.h"
+#include "host_test.h"
+#include "cJSON.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace {
+    constexpr int BENCH_EVENTS = 20000;
+    constexpr int WARMUP_EVENTS = 200;
+
+    struct PingPayload {
+        uint32_t seq;
+        uint64_t sent_ns;
+    };
+
+    // Payload, що не влазить в inline-слот і йде через блок пулу
+    struct LargePayload {
+        uint32_t seq;
+        uint8_t fill[60];
+    };
+    static_assert(sizeof(LargePayload) > EventBus::INLINE_PAYLOAD_SIZE, "Payload має йти через пул");
+
+    std::atomic<uint32_t> ping_received{0};
+    std::atomic<uint64_t> ping_latency_total_ns{0};
+    std::atomic<uint64_t> ping_latency_max_ns{0};
+
+    std::atomic<uint32_t> large_received{0};
+    std::atomic<uint32_t> large_corrupted{0};
+
+    LaneGate* normal_gate = nullptr;
+    // Глибина черги NORMAL у конфігурації смуг за замовчуванням
+    constexpr uint32_t NORMAL_QUEUE_SIZE = 10;
+
+    // Значення подій політик у порядку доставки
+    std::mutex values_mutex;
+    std::vector<uint32_t> values;
+
+    void on_value(const std::string&, const void* data) {
+        std::lock_guard<std::mutex> lock(values_mutex);
+        values.push_back(*static_cast<const uint32_t*>(data));
+    }
+
+    size_t values_count() {
+        std::lock_guard<std::mutex> lock(values_mutex);
+        return values.size();
+    }
+
+    std::vector<uint32_t> take_values() {
+        std::lock_guard<std::mutex> lock(values_mutex);
+        return std::move(values);
+    }
+
+    void on_ping(const std::string&, const void* data) {
+        const auto* ping = static_cast<const PingPayload*>(data);
+        const uint64_t latency = host_now_ns() - ping->sent_ns;
+        ping_latency_total_ns.fetch_add(latency);
+        uint64_t max = ping_latency_max_ns.load();
+        while (latency > max && !ping_latency_max_ns.compare_exchange_weak(max, latency)) {
+        }
+        ping_received.fetch_add(1);
+    }
+
+    void on_large(const std::string&, const void* data) {
+        const auto* payload = static_cast<const LargePayload*>(data);
+        for (uint8_t byte : payload->fill) {
+            if (byte != static_cast<uint8_t>(payload->seq)) {
+                large_corrupted.fetch_add(1);
+                break;
+            }
+        }
+        large_received.fetch_add(1);
+    }
+
+    LargePayload make_large(uint32_t seq) {
+        LargePayload payload;
+        payload.seq = seq;
+        memset(payload.fill, static_cast<uint8_t>(seq), sizeof(payload.fill));
+        return payload;
+    }
+
+    void ensure_bus() {
+        static bool ready = false;
+        if (ready) return;
+        EventBus::init();
+        normal_gate = new LaneGate("test.gate.normal", EventLane::NORMAL);
+        ready = true;
+    }
+
+    // Публікує по одній події і чекає її callback: час обходу черги і диспетчера.
+    //
+    // Базова лінія - шина c5682ef (std::string в елементі черги, пошук у
+    // std::map<std::string, ...> і копія вектора std::function на кожну подію),
+    // той самий цикл на тому ж хості (одне ядро, RelWithDebInfo). Щоб вона взагалі
+    // працювала, в черзі замість std::string - std::string*: memcpy рядка через
+    // чергу FreeRTOS лишає висячий вказівник.
+    //   c5682ef publish(name): сер. 2.5-3.1 мкс, 2.000 алокацій/подію, 196000-242000 подій/с
+    //   publish(EventId):      сер. 5.1-5.6 мкс, 0.000 алокацій/подію,  94000-108000 подій/с
+    //   publish(name):         сер. 5.0-5.2 мкс, 0.000 алокацій/подію, 107000-110000 подій/с
+    // На хості затримку визначає передача між потоками в заглушці FreeRTOS, і тут
+    // нова шина повільніша (копія payload, гістограма затримок, перевірка кілець
+    // ISR). Виграш, який переноситься на ESP32, - жодної алокації на подію.
+    template <typename Publish>
+    void run_ping_bench(const char* label, Publish publish) {
+        for (int i = 0; i < WARMUP_EVENTS; ++i) {
+            const uint32_t expected = ping_received.load() + 1;
+            publish(PingPayload{static_cast<uint32_t>(i), host_now_ns()});
+            wait_for([expected] { return ping_received.load() >= expected; });
+        }
+
+        ping_latency_total_ns.store(0);
+        ping_latency_max_ns.store(0);
+        const uint32_t received_before = ping_received.load();
+        const uint64_t allocs_before = host_alloc_count();
+        const uint64_t started = host_now_ns();
+        int failed = 0;
+        for (int i = 0; i < BENCH_EVENTS; ++i) {
+            const uint32_t expected = received_before + i + 1;
+            if (publish(PingPayload{static_cast<uint32_t>(i), host_now_ns()}) != ESP_OK) failed++;
+            while (ping_received.load() < expected) {
+                std::this_thread::yield();
+            }
+        }
+        const uint64_t elapsed = host_now_ns() - started;
+        const uint64_t allocs = host_alloc_count() - allocs_before;
+
+        CHECK_EQ(failed, 0);
+        CHECK_EQ(ping_received.load() - received_before, BENCH_EVENTS);
+        // Сталий режим публікації і диспетчеризації - без купи
+        CHECK_EQ(allocs, 0);
+        host_bench(label, "%d подій, publish->callback сер. %.2f мкс, макс. %.2f мкс, %.3f алокацій/подію, %.0f подій/с",
+                   BENCH_EVENTS, ping_latency_total_ns.load() / 1000.0 / BENCH_EVENTS,
+                   ping_latency_max_ns.load() / 1000.0, static_cast<double>(allocs) / BENCH_EVENTS,
+                   BENCH_EVENTS * 1e9 / elapsed);
+    }
+
+    uint32_t dropped_of(const char* event_name) {
+        cJSON* stats = EventBus::stats_to_json();
+        uint32_t dropped = 0;
+        const cJSON* event = nullptr;
+        cJSON_ArrayForEach(event, cJSON_GetObjectItemCaseSensitive(stats, "events")) {
+            const cJSON* name = cJSON_GetObjectItemCaseSensitive(event, "name");
+            if (cJSON_IsString(name) && strcmp(name->valuestring, event_name) == 0) {
+                dropped = static_cast<uint32_t>(cJSON_GetObjectItemCaseSensitive(event, "dropped")->valuedouble);
+            }
+        }
+        cJSON_Delete(stats);
+        return dropped;
+    }
+}
+
+TEST(publish_by_id_latency_and_allocations) {
+    ensure_bus();
+    const EventId id = EventBus::intern("bench.ping_id");
+    REQUIRE(id != EVENT_ID_INVALID);
+    REQUIRE(EventBus::subscribe(id, on_ping, EventLane::CONTROL) != 0);
+    run_ping_bench("publish(EventId)", [id](const PingPayload& ping) {
+        return EventBus::publish(id, ping);
+    });
+}
+
+TEST(publish_by_name_latency_and_allocations) {
+    ensure_bus();
+    REQUIRE(EventBus::subscribe("bench.ping_name", on_ping, EventLane::CONTROL) != 0);
+    // Ім'я резолвиться в EventId на кожній публікації - пошук у таблиці без алокацій
+    run_ping_bench("publish(name)", [](const PingPayload& ping) {
+        return EventBus::publish("bench.ping_name", ping);
+    });
+}
+
+TEST(intern_is_stable_and_rejects_patterns) {
+    ensure_bus();
+    const EventId id = EventBus::intern("test.intern");
+    CHECK(id != EVENT_ID_INVALID);
+    CHECK_EQ(EventBus::intern("test.intern"), id);
+    CHECK(strcmp(EventBus::name_of(id), "test.intern") == 0);
+    CHECK_EQ(EventBus::intern("test.*"), EVENT_ID_INVALID);
+    CHECK_EQ(EventBus::intern(""), EVENT_ID_INVALID);
+    CHECK(EventBus::name_of(EVENT_ID_INVALID) == nullptr);
+}
+
+TEST(pool_exhaustion_and_release) {
+    ensure_bus();
+    const EventId id = EventBus::intern("test.pool.large");
+    REQUIRE(EventBus::subscribe(id, on_large, EventLane::NORMAL) != 0);
+    const uint32_t received_before = large_received.load();
+
+    // Диспетчер тримає шлюз: кожна подія займає блок, доки її не доставлено
+    REQUIRE(normal_gate->hold());
+    for (uint32_t i = 0; i < EventBus::POOL_BLOCK_COUNT; ++i) {
+        CHECK_EQ(EventBus::publish(id, make_large(i)), ESP_OK);
+    }
+    CHECK_EQ(EventBus::publish(id, make_large(0xEE)), ESP_ERR_NO_MEM);
+    CHECK_EQ(dropped_of("test.pool.large"), 1);
+    CHECK_EQ(large_received.load(), received_before);
+
+    REQUIRE(normal_gate->release());
+    CHECK(wait_for([&] { return large_received.load() == received_before + EventBus::POOL_BLOCK_COUNT; }));
+    CHECK_EQ(large_corrupted.load(), 0);
+
+    // Доставлені події повернули блоки: пул знову вміщує POOL_BLOCK_COUNT подій
+    REQUIRE(normal_gate->hold());
+    for (uint32_t i = 0; i < EventBus::POOL_BLOCK_COUNT; ++i) {
+        CHECK_EQ(EventBus::publish(id, make_large(0x40 + i)), ESP_OK);
+    }
+    CHECK_EQ(EventBus::publish(id, make_large(0xEF)), ESP_ERR_NO_MEM);
+    REQUIRE(normal_gate->release());
+    CHECK(wait_for([&] { return large_received.load() == received_before + 2 * EventBus::POOL_BLOCK_COUNT; }));
+    CHECK_EQ(large_corrupted.load(), 0);
+}
+
+TEST(pool_block_released_by_last_lane) {
+    ensure_bus();
+    const EventId id = EventBus::intern("test.pool.shared");
+    REQUIRE(EventBus::subscribe(id, on_large, EventLane::NORMAL) != 0);
+    REQUIRE(EventBus::subscribe(id, on_large, EventLane::TELEMETRY) != 0);
+    const uint32_t received_before = large_received.load();
+
+    // Один блок на подію для обох смуг: TELEMETRY доставляє одразу,
+    // але блок лишається зайнятим, доки його не відпустить і NORMAL
+    REQUIRE(normal_gate->hold());
+    for (uint32_t i = 0; i < EventBus::POOL_BLOCK_COUNT; ++i) {
+        CHECK_EQ(EventBus::publish(id, make_large(0x80 + i)), ESP_OK);
+    }
+    CHECK(wait_for([&] { return large_received.load() == received_before + EventBus::POOL_BLOCK_COUNT; }));
+    CHECK_EQ(EventBus::publish(id, make_large(0xF0)), ESP_ERR_NO_MEM);
+
+    REQUIRE(normal_gate->release());
+    CHECK(wait_for([&] { return large_received.load() == received_before + 2 * EventBus::POOL_BLOCK_COUNT; }));
+    CHECK_EQ(large_corrupted.load(), 0);
+
+    REQUIRE(normal_gate->hold());
+    for (uint32_t i = 0; i < EventBus::POOL_BLOCK_COUNT; ++i) {
+        CHECK_EQ(EventBus::publish(id, make_large(0xC0 + i)), ESP_OK);
+    }
+    REQUIRE(normal_gate->release());
+    CHECK(wait_for([&] { return large_received.load() == received_before + 4 * EventBus::POOL_BLOCK_COUNT; }));
+    CHECK_EQ(large_corrupted.load(), 0);
+}
+
+TEST(overflow_coalesce_keeps_newest_value) {
+    ensure_bus();
+    const EventId id = EventBus::intern("test.policy.coalesce");
+    REQUIRE(EventBus::set_policy(id, EventPolicy::COALESCE) == ESP_OK);
+    REQUIRE(EventBus::subscribe(id, on_value, EventLane::NORMAL) != 0);
+    take_values();
+
+    // Поки диспетчер стоїть, у черзі один маркер; кожне нове значення замінює попереднє
+    constexpr uint32_t PUBLISHED = 100;
+    const EventPolicyStats before = EventBus::get_policy_stats();
+    REQUIRE(normal_gate->hold());
+    for (uint32_t i = 1; i <= PUBLISHED; ++i) {
+        CHECK_EQ(EventBus::publish(id, i), ESP_OK);
+    }
+    const EventPolicyStats held = EventBus::get_policy_stats();
+    REQUIRE(normal_gate->release());
+    CHECK(wait_for([] { return values_count() == 1; }));
+
+    const std::vector<uint32_t> delivered = take_values();
+    REQUIRE(delivered.size() == 1);
+    CHECK_EQ(delivered[0], PUBLISHED);
+    CHECK_EQ(held.coalesced - before.coalesced, PUBLISHED - 1);
+    CHECK_EQ(held.dropped - before.dropped, 0);
+    CHECK_EQ(dropped_of("test.policy.coalesce"), 0);
+
+    // Після доставки наступна публікація ставить новий маркер
+    CHECK_EQ(EventBus::publish(id, PUBLISHED + 1), ESP_OK);
+    CHECK(wait_for([] { return values_count() == 1; }));
+    CHECK_EQ(take_values()[0], PUBLISHED + 1);
+}
+
+TEST(overflow_drop_oldest_evicts_from_queue_head) {
+    ensure_bus();
+    const EventId id = EventBus::intern("test.policy.drop_oldest");
+    REQUIRE(EventBus::set_policy(id, EventPolicy::DROP_OLDEST) == ESP_OK);
+    REQUIRE(EventBus::subscribe(id, on_value, EventLane::NORMAL) != 0);
+    take_values();
+
+    constexpr uint32_t EXTRA = 5;
+    const EventPolicyStats before = EventBus::get_policy_stats();
+    REQUIRE(normal_gate->hold());
+    for (uint32_t i = 0; i < NORMAL_QUEUE_SIZE + EXTRA; ++i) {
+        CHECK_EQ(EventBus::publish(id, i), ESP_OK);
+    }
+    const EventPolicyStats held = EventBus::get_policy_stats();
+    REQUIRE(normal_gate->release());
+    CHECK(wait_for([] { return values_count() == NORMAL_QUEUE_SIZE; }));
+
+    // Витіснено EXTRA найстаріших, решта - у порядку публікації
+    const std::vector<uint32_t> delivered = take_values();
+    REQUIRE(delivered.size() == NORMAL_QUEUE_SIZE);
+    for (uint32_t i = 0; i < NORMAL_QUEUE_SIZE; ++i) {
+        CHECK_EQ(delivered[i], EXTRA + i);
+    }
+    CHECK_EQ(held.evicted - before.evicted, EXTRA);
+    CHECK_EQ(held.dropped - before.dropped, 0);
+    CHECK_EQ(dropped_of("test.policy.drop_oldest"), EXTRA);
+}
+
+TEST(overflow_must_deliver_spills_to_reserve) {
+    ensure_bus();
+    const EventId id = EventBus::intern("test.policy.must_deliver");
+    REQUIRE(EventBus::set_policy(id, EventPolicy::MUST_DELIVER) == ESP_OK);
+    REQUIRE(EventBus::subscribe(id, on_value, EventLane::NORMAL) != 0);
+    take_values();
+
+    // Черга, потім резерв смуги: жодна подія не втрачається
+    constexpr uint32_t ACCEPTED = NORMAL_QUEUE_SIZE + EventBus::RESERVE_SIZE;
+    const EventPolicyStats before = EventBus::get_policy_stats();
+    REQUIRE(normal_gate->hold());
+    for (uint32_t i = 0; i < ACCEPTED; ++i) {
+        CHECK_EQ(EventBus::publish(id, i), ESP_OK);
+    }
+    // Резерв заповнено: звичайна задача чекає MUST_DELIVER_TIMEOUT_MS і втрачає подію
+    const uint64_t started = host_now_ns();
+    CHECK_EQ(EventBus::publish(id, ACCEPTED), ESP_ERR_TIMEOUT);
+    const uint64_t waited_ns = host_now_ns() - started;
+    const EventPolicyStats held = EventBus::get_policy_stats();
+    REQUIRE(normal_gate->release());
+    CHECK(wait_for([] { return values_count() == ACCEPTED; }));
+
+    std::vector<uint32_t> delivered = take_values();
+    REQUIRE(delivered.size() == ACCEPTED);
+    std::sort(delivered.begin(), delivered.end());
+    for (uint32_t i = 0; i < ACCEPTED; ++i) {
+        CHECK_EQ(delivered[i], i);
+    }
+    CHECK_EQ(held.spilled - before.spilled, EventBus::RESERVE_SIZE);
+    CHECK_EQ(held.lost - before.lost, 1);
+    CHECK(waited_ns >= EventBus::MUST_DELIVER_TIMEOUT_MS * 1000000ull * 9 / 10);
+    CHECK_EQ(dropped_of("test.policy.must_deliver"), 1);
+}
@@ -0,0 +1,256 @@
+// Диспетчер EventBus: алокації і пропускна здатність сталого режиму,
+// підписка/відписка під час диспетчеризації (знімки підписників),
+// підписки за шаблоном і вартість диспетчеризації від кількості шаблонів.
+
+#include "event_bus.h"
+#include "host_test.h"
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace {
+    // Глибша черга NORMAL, щоб пачки публікацій не впирались у переповнення
+    constexpr EventLaneConfig BENCH_LANES[EventBus::LANE_COUNT] = {
+        { 8,   4096, 10, 1 },
+        { 256, 4096, 5,  EVENT_LANE_ANY_CORE },
+        { 16,  6144, 3,  0 },
+    };
+
+    constexpr int SUBSCRIBERS = 4;
+    constexpr int BENCH_EVENTS = 100000;
+    constexpr int BURST = 200;
+
+    std::atomic<uint32_t> bench_calls{0};
+    std::atomic<uint32_t> bench_bad_payload{0};
+
+    std::atomic<uint32_t> stable_calls{0};
+    std::atomic<uint32_t> churn_calls{0};
+    std::atomic<uint32_t> probe_stable{0};
+    std::atomic<uint32_t> probe_churn{0};
+
+    // Лічильники підписників шаблонів: [підписник][подія]
+    constexpr int PATTERN_SUBS = 4;
+    constexpr int PATTERN_EVENTS = 6;
+    std::atomic<uint32_t> pattern_calls[PATTERN_SUBS][PATTERN_EVENTS] = {};
+    std::atomic<uint32_t> pattern_total{0};
+    const char* const PATTERN_EVENT_NAMES[PATTERN_EVENTS] = {
+        "cooling.mode_changed",   // Зареєстровано до підписки
+        "cooling.temperature",
+        "heating.mode_changed",
+        "cooling.sensor.fault",   // Зайвий сегмент - "cooling.*" не відповідає
+        "mode_changed",
+        "cooling.defrost",        // Реєструється вже після підписки
+    };
+
+    std::atomic<uint32_t> trie_calls{0};
+
+    void ensure_bus() {
+        static bool ready = false;
+        if (ready) return;
+        EventBus::init(BENCH_LANES);
+        ready = true;
+    }
+
+    void on_bench(const std::string&, const void* data) {
+        if (*static_cast<const uint32_t*>(data) >= BENCH_EVENTS) bench_bad_payload.fetch_add(1);
+        bench_calls.fetch_add(1);
+    }
+
+    // Публікує, доки подія не влізе в чергу смуги
+    void publish_blocking(EventId id, uint32_t value) {
+        while (EventBus::publish(id, value) != ESP_OK) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+TEST(steady_state_dispatch_allocations_and_throughput) {
+    ensure_bus();
+    const EventId id = EventBus::intern("bench.dispatch");
+    for (int i = 0; i < SUBSCRIBERS; ++i) {
+        REQUIRE(EventBus::subscribe(id, on_bench, EventLane::NORMAL) != 0);
+    }
+
+    // Прогрів: перший знімок і лінива ініціалізація в потоках
+    for (uint32_t i = 0; i < BURST; ++i) publish_blocking(id, i);
+    CHECK(wait_for([] { return bench_calls.load() == BURST * SUBSCRIBERS; }));
+
+    bench_calls.store(0);
+    const uint64_t allocs_before = host_alloc_count();
+    const uint64_t started = host_now_ns();
+    for (int sent = 0; sent < BENCH_EVENTS; sent += BURST) {
+        // Пачка подій у черзі: диспетчер розбирає до DISPATCH_BATCH за пробудження
+        for (int i = 0; i < BURST; ++i) {
+            publish_blocking(id, static_cast<uint32_t>(sent + i));
+        }
+        const uint32_t expected = static_cast<uint32_t>(sent + BURST) * SUBSCRIBERS;
+        while (bench_calls.load() < expected) {
+            std::this_thread::yield();
+        }
+    }
+    const uint64_t elapsed = host_now_ns() - started;
+    const uint64_t allocs = host_alloc_count() - allocs_before;
+
+    CHECK_EQ(bench_calls.load(), static_cast<uint32_t>(BENCH_EVENTS) * SUBSCRIBERS);
+    CHECK_EQ(bench_bad_payload.load(), 0);
+    CHECK_EQ(allocs, 0);
+    host_bench("dispatch", "%d подій x %d підписників: %.0f подій/с, %.0f викликів/с, %.3f алокацій/подію",
+               BENCH_EVENTS, SUBSCRIBERS, BENCH_EVENTS * 1e9 / elapsed,
+               static_cast<double>(BENCH_EVENTS) * SUBSCRIBERS * 1e9 / elapsed,
+               static_cast<double>(allocs) / BENCH_EVENTS);
+}
+
+TEST(subscribe_and_unsubscribe_during_dispatch) {
+    ensure_bus();
+    const EventId noise = EventBus::intern("test.churn.noise");
+    const EventId probe = EventBus::intern("test.churn.probe");
+    REQUIRE(EventBus::subscribe(noise, [](const std::string&, const void*) {
+        stable_calls.fetch_add(1);
+    }, EventLane::NORMAL) != 0);
+    REQUIRE(EventBus::subscribe(probe, [](const std::string&, const void*) {
+        probe_stable.fetch_add(1);
+    }, EventLane::NORMAL) != 0);
+
+    // Фонова публікація тримає диспетчер зайнятим, поки змінюються підписки
+    std::atomic<bool> stop{false};
+    std::atomic<uint32_t> noise_sent{0};
+    std::thread publisher([&] {
+        uint32_t value = 0;
+        while (!stop.load()) {
+            if (EventBus::publish(noise, value++) == ESP_OK) noise_sent.fetch_add(1);
+            std::this_thread::yield();
+        }
+    });
+
+    constexpr int CYCLES = 300;
+    int missed = 0;
+    int late = 0;
+    for (int cycle = 0; cycle < CYCLES; ++cycle) {
+        const EventSubscriptionHandle churn = EventBus::subscribe(noise, [](const std::string&, const void*) {
+            churn_calls.fetch_add(1);
+        }, EventLane::NORMAL);
+        REQUIRE(churn != 0);
+        const EventSubscriptionHandle churn_probe = EventBus::subscribe(probe, [](const std::string&, const void*) {
+            probe_churn.fetch_add(1);
+            churn_calls.fetch_add(1);
+        }, EventLane::NORMAL);
+        REQUIRE(churn_probe != 0);
+
+        // Подія, опублікована після subscribe(), доходить і до нового підписника
+        const uint32_t churn_expected = probe_churn.load() + 1;
+        const uint32_t probe_expected = probe_stable.load() + 1;
+        publish_blocking(probe, static_cast<uint32_t>(cycle));
+        CHECK(wait_for([&] { return probe_stable.load() >= probe_expected; }));
+        if (!wait_for([&] { return probe_churn.load() >= churn_expected; })) missed++;
+
+        EventBus::unsubscribe(churn);
+        EventBus::unsubscribe(churn_probe);
+
+        // Після unsubscribe() і доставки наступної події старий підписник мовчить
+        const uint32_t probe_next = probe_stable.load() + 1;
+        publish_blocking(probe, static_cast<uint32_t>(cycle));
+        CHECK(wait_for([&] { return probe_stable.load() >= probe_next; }));
+        const uint32_t churn_after = churn_calls.load();
+        const uint32_t probe_last = probe_stable.load() + 1;
+        publish_blocking(probe, static_cast<uint32_t>(cycle));
+        CHECK(wait_for([&] { return probe_stable.load() >= probe_last; }));
+        if (churn_calls.load() != churn_after) late++;
+    }
+
+    stop.store(true);
+    publisher.join();
+    CHECK(wait_for([&] { return stable_calls.load() == noise_sent.load(); }));
+    CHECK_EQ(missed, 0);
+    CHECK_EQ(late, 0);
+    CHECK_EQ(stable_calls.load(), noise_sent.load());
+}
+
+TEST(pattern_subscriptions_match_one_segment) {
+    ensure_bus();
+    const EventId early = EventBus::intern(PATTERN_EVENT_NAMES[0]);
+    REQUIRE(early != EVENT_ID_INVALID);
+
+    const char* const patterns[PATTERN_SUBS] = {"cooling.*", "*.mode_changed", "*.*", "cooling.mode_changed"};
+    EventSubscriptionHandle handles[PATTERN_SUBS];
+    for (int sub = 0; sub < PATTERN_SUBS; ++sub) {
+        handles[sub] = EventBus::subscribe(patterns[sub], [sub](const std::string& name, const void*) {
+            for (int event = 0; event < PATTERN_EVENTS; ++event) {
+                if (name == PATTERN_EVENT_NAMES[event]) pattern_calls[sub][event].fetch_add(1);
+            }
+            pattern_total.fetch_add(1);
+        }, EventLane::NORMAL);
+        REQUIRE(handles[sub] != 0);
+    }
+    // '*' - лише цілий сегмент; порожні сегменти відхиляються
+    CHECK_EQ(EventBus::subscribe("cool*", [](const std::string&, const void*) {}, EventLane::NORMAL), 0);
+    CHECK_EQ(EventBus::subscribe("cooling..*", [](const std::string&, const void*) {}, EventLane::NORMAL), 0);
+
+    // Очікувана кількість викликів [підписник][подія]; перекриття не дублює виклик
+    const uint32_t expected[PATTERN_SUBS][PATTERN_EVENTS] = {
+        {1, 1, 0, 0, 0, 1},
+        {1, 0, 1, 0, 0, 0},
+        {1, 1, 1, 0, 0, 1},
+        {1, 0, 0, 0, 0, 0},
+    };
+    uint32_t expected_total = 0;
+    for (const auto& row : expected) for (uint32_t calls : row) expected_total += calls;
+
+    for (int event = 0; event < PATTERN_EVENTS; ++event) {
+        publish_blocking(EventBus::intern(PATTERN_EVENT_NAMES[event]), static_cast<uint32_t>(event));
+    }
+    CHECK(wait_for([&] { return pattern_total.load() == expected_total; }));
+    for (int sub = 0; sub < PATTERN_SUBS; ++sub) {
+        for (int event = 0; event < PATTERN_EVENTS; ++event) {
+            CHECK_EQ(pattern_calls[sub][event].load(), expected[sub][event]);
+        }
+    }
+
+    // Відписаний шаблон не отримує ні відомих, ні нових імен; решта працює
+    EventBus::unsubscribe(handles[0]);
+    const uint32_t cooling_before = pattern_calls[0][1].load();
+    const uint32_t any_before = pattern_calls[2][1].load();
+    publish_blocking(EventBus::intern(PATTERN_EVENT_NAMES[1]), 1);
+    publish_blocking(EventBus::intern("cooling.after_unsubscribe"), 0);
+    CHECK(wait_for([&] { return pattern_total.load() == expected_total + 2; }));
+    CHECK_EQ(pattern_calls[0][1].load(), cooling_before);
+    CHECK_EQ(pattern_calls[2][1].load(), any_before + 1);
+
+    for (int sub = 1; sub < PATTERN_SUBS; ++sub) EventBus::unsubscribe(handles[sub]);
+}
+
+TEST(dispatch_cost_independent_of_pattern_count) {
+    ensure_bus();
+    const EventId id = EventBus::intern("bench.trie.value");
+    REQUIRE(EventBus::subscribe(id, [](const std::string&, const void*) { trie_calls.fetch_add(1); },
+                                EventLane::NORMAL) != 0);
+
+    // Шаблони ділять з іменем вузли дерева, але йому не відповідають
+    constexpr int EVENTS = 20000;
+    const int pattern_counts[] = {0, 10, 50};
+    int registered = 0;
+    double ns_per_event[3] = {};
+    for (int step = 0; step < 3; ++step) {
+        for (; registered < pattern_counts[step]; ++registered) {
+            const std::string suffix = std::to_string(registered);
+            const std::string pattern = registered % 2 ? "bench.trie" + suffix + ".*" : "*.trie.x" + suffix;
+            REQUIRE(EventBus::subscribe(pattern.c_str(), [](const std::string&, const void*) {
+                trie_calls.fetch_add(1000000);
+            }, EventLane::NORMAL) != 0);
+        }
+
+        trie_calls.store(0);
+        const uint64_t allocs_before = host_alloc_count();
+        const uint64_t started = host_now_ns();
+        for (int sent = 0; sent < EVENTS; sent += BURST) {
+            for (int i = 0; i < BURST; ++i) publish_blocking(id, static_cast<uint32_t>(sent + i));
+            const uint32_t expected = static_cast<uint32_t>(sent + BURST);
+            while (trie_calls.load() < expected) std::this_thread::yield();
+        }
+        ns_per_event[step] = static_cast<double>(host_now_ns() - started) / EVENTS;
+        CHECK_EQ(trie_calls.load(), static_cast<uint32_t>(EVENTS));
+        CHECK_EQ(host_alloc_count() - allocs_before, 0);
+        host_bench("dispatch vs patterns", "%d шаблонів: %.0f нс/подію", pattern_counts[step], ns_per_event[step]);
+    }
+    // Шаблони розкриваються при реєстрації імені, не на публікації
+    CHECK(ns_per_event[2] < ns_per_event[0] * 2.0);
+}
@@ -0,0 +1,235 @@
+// EventBus::publish_from_isr: переповнення і обхід індексів кільця,
+// стрес-тест з двома імітованими перериваннями (по одному на ядро),
+// пересилання ISR-записів у зайняту смугу без блокування диспетчера CONTROL.
+
+#include "event_bus.h"
+#include "bus_test_util.h"
+#include "host_test.h"
+#include "freertos/FreeRTOS.h"
+#include "host_freertos.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace {
+    struct IsrPayload {
+        uint32_t seq;
+        uint32_t producer;
+        uint32_t check;
+        uint64_t sent_ns;
+    };
+    static_assert(sizeof(IsrPayload) <= EventBus::INLINE_PAYLOAD_SIZE, "ISR payload має бути inline");
+
+    uint32_t checksum(uint32_t seq, uint32_t producer) {
+        return (seq * 2654435761u) ^ (producer + 1) * 0x9E3779B9u;
+    }
+
+    IsrPayload make_payload(uint32_t seq, uint32_t producer) {
+        return IsrPayload{seq, producer, checksum(seq, producer), host_now_ns()};
+    }
+
+    constexpr size_t MAX_RECORDED = 1024;
+
+    // Callback ISR-подій виконує лише диспетчер CONTROL
+    struct Received {
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint32_t> corrupted{0};
+        std::atomic<uint32_t> out_of_order{0};
+        std::atomic<uint32_t> last_seq[portNUM_PROCESSORS] = {};
+        std::atomic<bool> seen[portNUM_PROCESSORS] = {};
+        std::atomic<uint64_t> latency_total_ns{0};
+        // Послідовність seq у порядку доставки (для перевірки порядку)
+        std::atomic<uint32_t> recorded[MAX_RECORDED] = {};
+    };
+    Received received;
+
+    void on_isr_event(const std::string&, const void* data) {
+        const auto* payload = static_cast<const IsrPayload*>(data);
+        const uint32_t index = received.count.load();
+        if (payload->producer >= portNUM_PROCESSORS || payload->check != checksum(payload->seq, payload->producer)) {
+            received.corrupted.fetch_add(1);
+        } else {
+            const uint32_t p = payload->producer;
+            if (received.seen[p].load() && payload->seq <= received.last_seq[p].load()) {
+                received.out_of_order.fetch_add(1);
+            }
+            received.last_seq[p].store(payload->seq);
+            received.seen[p].store(true);
+        }
+        received.latency_total_ns.fetch_add(host_now_ns() - payload->sent_ns);
+        if (index < MAX_RECORDED) received.recorded[index].store(payload->seq);
+        received.count.fetch_add(1);
+    }
+
+    LaneGate* control_gate = nullptr;
+    EventId isr_event = EVENT_ID_INVALID;
+
+    void ensure_bus() {
+        static bool ready = false;
+        if (ready) return;
+        EventBus::init();
+        control_gate = new LaneGate("test.gate.control", EventLane::CONTROL);
+        isr_event = EventBus::intern("test.isr.input");
+        EventBus::subscribe(isr_event, on_isr_event, EventLane::CONTROL);
+        ready = true;
+    }
+}
+
+TEST(isr_rejects_invalid_and_skips_unsubscribed) {
+    ensure_bus();
+    const EventIsrStats before = EventBus::get_isr_stats();
+    CHECK_EQ(EventBus::publish_from_isr(EVENT_ID_INVALID), ESP_ERR_INVALID_ARG);
+    // Без підписників запис у кільце не потрапляє
+    const EventId idle = EventBus::intern("test.isr.idle");
+    CHECK_EQ(EventBus::publish_from_isr(idle, make_payload(1, 0)), ESP_OK);
+    const EventIsrStats after = EventBus::get_isr_stats();
+    CHECK_EQ(after.published, before.published);
+    CHECK_EQ(after.overflowed, before.overflowed);
+}
+
+TEST(isr_ring_wraparound_and_overflow_accounting) {
+    ensure_bus();
+    constexpr uint32_t EXTRA = 3;
+    constexpr uint32_t ROUNDS = 6;
+    received.count.store(0);
+    uint32_t seq = 0;
+    uint32_t delivered = 0;
+
+    // Кожен раунд заповнює кільце повністю: індекси head/tail проходять
+    // по колу кілька разів, по черзі для кілець обох ядер
+    for (uint32_t round = 0; round < ROUNDS; ++round) {
+        const uint32_t core = round % portNUM_PROCESSORS;
+        host_set_core_id(static_cast<int>(core));
+        REQUIRE(control_gate->hold());
+
+        const EventIsrStats before = EventBus::get_isr_stats();
+        const uint32_t first_seq = seq;
+        uint32_t accepted = 0;
+        uint32_t rejected = 0;
+        for (uint32_t i = 0; i < EventBus::ISR_RING_SIZE + EXTRA; ++i) {
+            const esp_err_t err = EventBus::publish_from_isr(isr_event, make_payload(seq++, core));
+            if (err == ESP_OK) {
+                accepted++;
+            } else {
+                CHECK_EQ(err, ESP_ERR_NO_MEM);
+                rejected++;
+            }
+        }
+        const EventIsrStats after = EventBus::get_isr_stats();
+        CHECK_EQ(accepted, EventBus::ISR_RING_SIZE);
+        CHECK_EQ(rejected, EXTRA);
+        CHECK_EQ(after.published - before.published, EventBus::ISR_RING_SIZE);
+        CHECK_EQ(after.overflowed - before.overflowed, EXTRA);
+        // Поки диспетчер зайнятий, нічого не доставлено
+        CHECK_EQ(received.count.load(), delivered);
+
+        REQUIRE(control_gate->release());
+        delivered += EventBus::ISR_RING_SIZE;
+        CHECK(wait_for([&] { return received.count.load() == delivered; }));
+
+        // Доставлено перші ISR_RING_SIZE записів раунду, у порядку публікації
+        for (uint32_t i = 0; i < EventBus::ISR_RING_SIZE; ++i) {
+            CHECK_EQ(received.recorded[delivered - EventBus::ISR_RING_SIZE + i].load(), first_seq + i);
+        }
+    }
+    host_set_core_id(0);
+    CHECK_EQ(received.corrupted.load(), 0);
+}
+
+TEST(isr_stress_two_producers) {
+    ensure_bus();
+    constexpr uint32_t PER_PRODUCER = 20000;
+    // Пауза між перериваннями одного ядра; кожні BURST записів - пачка без пауз
+    constexpr uint32_t INTERRUPT_PERIOD_US = 20;
+    constexpr uint32_t BURST = 64;
+
+    received.count.store(0);
+    received.corrupted.store(0);
+    received.out_of_order.store(0);
+    received.latency_total_ns.store(0);
+    for (auto& seen : received.seen) seen.store(false);
+
+    const EventIsrStats before = EventBus::get_isr_stats();
+    std::atomic<uint32_t> accepted{0};
+    std::atomic<uint32_t> rejected{0};
+
+    // Кожен потік - переривання свого ядра: один виробник на кільце
+    auto producer = [&](uint32_t core) {
+        host_set_core_id(static_cast<int>(core));
+        for (uint32_t seq = 0; seq < PER_PRODUCER; ++seq) {
+            if (seq % BURST >= EventBus::ISR_RING_SIZE) {
+                std::this_thread::sleep_for(std::chrono::microseconds(INTERRUPT_PERIOD_US));
+            }
+            if (EventBus::publish_from_isr(isr_event, make_payload(seq, core)) == ESP_OK) {
+                accepted.fetch_add(1);
+            } else {
+                rejected.fetch_add(1);
+            }
+        }
+    };
+
+    const uint64_t started = host_now_ns();
+    std::thread core0(producer, 0);
+    std::thread core1(producer, 1);
+    core0.join();
+    core1.join();
+    CHECK(wait_for([&] { return received.count.load() == accepted.load(); }, 10000));
+    const uint64_t elapsed = host_now_ns() - started;
+
+    const EventIsrStats after = EventBus::get_isr_stats();
+    CHECK_EQ(accepted.load() + rejected.load(), 2 * PER_PRODUCER);
+    CHECK_EQ(after.published - before.published, accepted.load());
+    CHECK_EQ(after.overflowed - before.overflowed, rejected.load());
+    CHECK_EQ(received.count.load(), accepted.load());
+    CHECK_EQ(received.corrupted.load(), 0);
+    CHECK_EQ(received.out_of_order.load(), 0);
+    CHECK(after.max_latency_us >= after.last_latency_us);
+
+    const uint32_t count = received.count.load();
+    host_bench("publish_from_isr x2", "прийнято %u, переповнень %u, %.0f подій/с, ISR->callback сер. %.2f мкс, макс. %u мкс",
+               accepted.load(), rejected.load(), count * 1e9 / elapsed,
+               count ? received.latency_total_ns.load() / 1000.0 / count : 0.0, after.max_latency_us);
+}
+
+TEST(isr_forwarding_never_blocks_control_dispatcher) {
+    ensure_bus();
+    static LaneGate telemetry_gate("test.gate.telemetry", EventLane::TELEMETRY);
+    static std::atomic<uint32_t> control_calls{0};
+    static std::atomic<uint32_t> telemetry_calls{0};
+    const EventId forwarded = EventBus::intern("test.isr.forwarded");
+    REQUIRE(EventBus::set_policy(forwarded, EventPolicy::MUST_DELIVER) == ESP_OK);
+    EventBus::subscribe(forwarded, [](const std::string&, const void*) { control_calls.fetch_add(1); },
+                        EventLane::CONTROL);
+    EventBus::subscribe(forwarded, [](const std::string&, const void*) { telemetry_calls.fetch_add(1); },
+                        EventLane::TELEMETRY);
+
+    // TELEMETRY стоїть: черга (16) і резерв заповнюються ISR-записами, які
+    // пересилає диспетчер CONTROL; решта мала б чекати MUST_DELIVER_TIMEOUT_MS
+    REQUIRE(telemetry_gate.hold());
+    const EventPolicyStats before = EventBus::get_policy_stats();
+    constexpr uint32_t ROUNDS = 3;
+    uint64_t slowest_round_ns = 0;
+    for (uint32_t round = 0; round < ROUNDS; ++round) {
+        const uint64_t started = host_now_ns();
+        for (uint32_t i = 0; i < EventBus::ISR_RING_SIZE; ++i) {
+            REQUIRE(EventBus::publish_from_isr(forwarded, round * EventBus::ISR_RING_SIZE + i) == ESP_OK);
+        }
+        const uint32_t expected = (round + 1) * EventBus::ISR_RING_SIZE;
+        CHECK(wait_for([&] { return control_calls.load() == expected; }));
+        slowest_round_ns = std::max(slowest_round_ns, host_now_ns() - started);
+    }
+    const EventPolicyStats held = EventBus::get_policy_stats();
+    REQUIRE(telemetry_gate.release());
+
+    // Черга й резерв TELEMETRY доставлені, надлишок - lost без очікування
+    const uint32_t total = ROUNDS * EventBus::ISR_RING_SIZE;
+    constexpr uint32_t TELEMETRY_QUEUE_SIZE = 16; // Смуга за замовчуванням
+    const uint32_t lost = held.lost - before.lost;
+    CHECK_EQ(lost, total - TELEMETRY_QUEUE_SIZE - EventBus::RESERVE_SIZE);
+    CHECK(wait_for([&] { return telemetry_calls.load() == total - lost; }));
+    CHECK_EQ(held.spilled - before.spilled, EventBus::RESERVE_SIZE);
+    // Без винятку для диспетчерів кожна втрачена подія тримала б CONTROL 50 мс
+    CHECK(slowest_round_ns < EventBus::MUST_DELIVER_TIMEOUT_MS * 1000000ull);
+    host_bench("isr -> held TELEMETRY", "%u записів, втрачено %u, найповільніший раунд %.2f мс",
+               total, lost, slowest_round_ns / 1e6);
+}
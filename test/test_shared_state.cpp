@@ -0,0 +1,397 @@
+// SharedState: хендли ключів, seqlock числових слотів під конкурентним
+// записом, пропускна здатність get/set для 200 ключів (хендл vs рядок),
+// мертві зони і лічильник пропущених сповіщень, межі query(prefix).
+
+#include "shared_state.h"
+#include "host_test.h"
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    constexpr size_t BENCH_KEYS = 200;
+    constexpr int BENCH_ROUNDS = 500;
+
+    void ensure_state() {
+        static bool ready = false;
+        if (ready) return;
+        SharedState::init();
+        ready = true;
+    }
+
+    // Значення, у якого старші й молодші 32 біти однакові: розірване
+    // читання (половина старого, половина нового запису) їх розводить
+    int64_t paired(uint32_t n) {
+        return static_cast<int64_t>((static_cast<uint64_t>(n) << 32) | n);
+    }
+
+    bool is_paired(int64_t value) {
+        const uint64_t bits = static_cast<uint64_t>(value);
+        return static_cast<uint32_t>(bits >> 32) == static_cast<uint32_t>(bits);
+    }
+
+    constexpr StateKey<int64_t> KEY_SEQLOCK{"test/seqlock/paired"};
+    constexpr StateKey<float> KEY_DEADBAND{"test/deadband/temperature", 0.5f};
+
+    std::atomic<uint32_t> deadband_notifications{0};
+    std::atomic<float> deadband_notified{0.0f};
+
+    // Похідні ключі: sum = a + b, scaled = sum * 10 (транзитивна залежність)
+    struct DerivedKeys {
+        StateRef<int> a;
+        StateRef<int> b;
+        StateRef<int> sum;
+        StateRef<int> scaled;
+    };
+    DerivedKeys derived;
+    std::atomic<uint32_t> sum_evaluations{0};
+    std::atomic<uint32_t> scaled_evaluations{0};
+    std::atomic<uint32_t> scaled_notifications{0};
+    std::atomic<int> scaled_notified{0};
+
+    void ensure_derived() {
+        static bool ready = false;
+        if (ready) return;
+        derived.a = StateRef<int>{SharedState::key("test/derived/a")};
+        derived.b = StateRef<int>{SharedState::key("test/derived/b")};
+        derived.sum = StateRef<int>{SharedState::key("test/derived/sum")};
+        derived.scaled = StateRef<int>{SharedState::key("test/derived/scaled")};
+        SharedState::derive(derived.sum, {derived.a.handle, derived.b.handle}, [] {
+            sum_evaluations.fetch_add(1);
+            return SharedState::get(derived.a, 0) + SharedState::get(derived.b, 0);
+        });
+        SharedState::derive(derived.scaled, {derived.sum.handle}, [] {
+            scaled_evaluations.fetch_add(1);
+            return SharedState::get(derived.sum, 0) * 10;
+        });
+        ready = true;
+    }
+}
+
+TEST(key_handles_are_stable) {
+    ensure_state();
+    const StateHandle handle = SharedState::key("test/handles/a");
+    CHECK(handle != STATE_HANDLE_INVALID);
+    CHECK_EQ(SharedState::key("test/handles/a"), handle);
+    CHECK_EQ(SharedState::find("test/handles/a"), handle);
+    CHECK_EQ(SharedState::find("test/handles/missing"), STATE_HANDLE_INVALID);
+    CHECK(std::string(SharedState::name_of(handle)) == "test/handles/a");
+
+    SharedState::set(handle, 42);
+    CHECK_EQ(SharedState::get("test/handles/a", 0), 42);
+    // Інший тип - значення за замовчуванням, без перетворення
+    CHECK(SharedState::get(handle, 1.5f) == 1.5f);
+}
+
+TEST(seqlock_readers_never_see_torn_values) {
+    ensure_state();
+    const StateRef<int64_t> ref = SharedState::key(KEY_SEQLOCK);
+    REQUIRE(ref.handle != STATE_HANDLE_INVALID);
+    SharedState::set(ref, paired(0));
+
+    constexpr uint32_t WRITES = 200000;
+    constexpr int READERS = 2;
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> torn{0};
+    std::atomic<uint32_t> backwards{0};
+    std::atomic<uint64_t> reads{0};
+
+    auto reader = [&] {
+        uint32_t last = 0;
+        uint64_t count = 0;
+        while (!done.load(std::memory_order_relaxed)) {
+            const int64_t value = SharedState::get(ref, int64_t{-1});
+            if (!is_paired(value)) {
+                torn.fetch_add(1);
+            } else {
+                // Записувач лише збільшує значення
+                const uint32_t n = static_cast<uint32_t>(value);
+                if (n < last) backwards.fetch_add(1);
+                last = n;
+            }
+            count++;
+        }
+        reads.fetch_add(count);
+    };
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < READERS; ++i) readers.emplace_back(reader);
+    std::thread writer([&] {
+        for (uint32_t n = 1; n <= WRITES; ++n) {
+            SharedState::set(ref, paired(n));
+        }
+        done.store(true);
+    });
+    writer.join();
+    for (auto& t : readers) t.join();
+
+    CHECK_EQ(torn.load(), 0);
+    CHECK_EQ(backwards.load(), 0);
+    CHECK(reads.load() > 0);
+    CHECK(SharedState::get(ref, int64_t{0}) == paired(WRITES));
+    host_bench("seqlock", "%u записів, %llu читань у %d потоках без розірваних значень",
+               WRITES, static_cast<unsigned long long>(reads.load()), READERS);
+}
+
+TEST(get_set_throughput_200_keys) {
+    ensure_state();
+    std::vector<std::string> names;
+    std::vector<StateRef<int>> refs;
+    for (size_t i = 0; i < BENCH_KEYS; ++i) {
+        char name[48];
+        snprintf(name, sizeof(name), "bench/module_%02u/value_%03u", static_cast<unsigned>(i / 10), static_cast<unsigned>(i));
+        names.emplace_back(name);
+        refs.push_back(StateRef<int>{SharedState::key(names.back())});
+        REQUIRE(refs.back().handle != STATE_HANDLE_INVALID);
+    }
+    const int OPS = BENCH_ROUNDS * static_cast<int>(BENCH_KEYS);
+
+    // Кожен раунд пише нові значення: set доходить до запису в слот
+    auto measure = [&](const char* label, auto op) {
+        const uint64_t allocs_before = host_alloc_count();
+        const uint64_t started = host_now_ns();
+        int64_t checksum = 0;
+        for (int round = 0; round < BENCH_ROUNDS; ++round) {
+            for (size_t i = 0; i < BENCH_KEYS; ++i) {
+                checksum += op(round, i);
+            }
+        }
+        const uint64_t elapsed = host_now_ns() - started;
+        const uint64_t allocs = host_alloc_count() - allocs_before;
+        host_bench(label, "%.1f нс/оп, %.0f оп/с, %.2f алокацій/оп",
+                   static_cast<double>(elapsed) / OPS, OPS * 1e9 / elapsed, static_cast<double>(allocs) / OPS);
+        return std::make_pair(checksum, allocs);
+    };
+
+    const auto set_handle = measure("set(StateRef)", [&](int round, size_t i) {
+        SharedState::set(refs[i], round * 1000 + static_cast<int>(i));
+        return 0;
+    });
+    const auto get_handle = measure("get(StateRef)", [&](int, size_t i) {
+        return SharedState::get(refs[i], -1);
+    });
+    const auto set_name = measure("set(const char*)", [&](int round, size_t i) {
+        SharedState::set(names[i].c_str(), round * 1000 + static_cast<int>(i) + 1);
+        return 0;
+    });
+    const auto get_name = measure("get(const char*)", [&](int, size_t i) {
+        return SharedState::get(names[i].c_str(), -1);
+    });
+
+    // Останній раунд set(StateRef) записав round * 1000 + i
+    int64_t expected = 0;
+    for (size_t i = 0; i < BENCH_KEYS; ++i) expected += (BENCH_ROUNDS - 1) * 1000 + static_cast<int64_t>(i);
+    CHECK(get_handle.first == expected * BENCH_ROUNDS);
+    CHECK(get_name.first == (expected + static_cast<int64_t>(BENCH_KEYS)) * BENCH_ROUNDS);
+    // Шлях за хендлом - без купи; за назвою - тимчасовий std::string на виклик
+    CHECK_EQ(set_handle.second, 0);
+    CHECK_EQ(get_handle.second, 0);
+    (void)set_name;
+}
+
+TEST(derived_keys_are_lazy_and_memoized) {
+    ensure_state();
+    ensure_derived();
+    // Без значень джерел обчислювати нічого: get() повертає default
+    CHECK_EQ(SharedState::get(derived.sum, -1), -1);
+    CHECK_EQ(sum_evaluations.load(), 0);
+
+    // Зміна джерел лише позначає ключ застарілим
+    SharedState::set(derived.a, 2);
+    SharedState::set(derived.b, 3);
+    SharedState::set(derived.a, 4);
+    CHECK_EQ(sum_evaluations.load(), 0);
+
+    // Перше читання обчислює, наступні - із запам'ятованого значення
+    CHECK_EQ(SharedState::get(derived.sum, -1), 7);
+    CHECK_EQ(SharedState::get(derived.sum, -1), 7);
+    CHECK_EQ(sum_evaluations.load(), 1);
+
+    // Запис того самого значення джерела не інвалідує
+    SharedState::set(derived.b, 3);
+    CHECK_EQ(SharedState::get(derived.sum, -1), 7);
+    CHECK_EQ(sum_evaluations.load(), 1);
+
+    SharedState::set(derived.b, 5);
+    CHECK_EQ(SharedState::get(derived.sum, -1), 9);
+    CHECK_EQ(sum_evaluations.load(), 2);
+
+    // Повторне оголошення і ключ як власне джерело відхиляються
+    CHECK_EQ(SharedState::derive(derived.sum, {derived.a.handle}, [] { return 0; }), ESP_ERR_INVALID_STATE);
+    const StateRef<int> loop{SharedState::key("test/derived/loop")};
+    CHECK_EQ(SharedState::derive(loop, {loop.handle}, [] { return 0; }), ESP_ERR_INVALID_ARG);
+}
+
+TEST(derived_keys_invalidate_transitively) {
+    ensure_state();
+    ensure_derived();
+    SharedState::set(derived.a, 1);
+    SharedState::set(derived.b, 1);
+    const uint32_t sum_before = sum_evaluations.load();
+    const uint32_t scaled_before = scaled_evaluations.load();
+
+    // scaled залежить від a лише через sum: зміна a має дійти до нього
+    CHECK_EQ(SharedState::get(derived.scaled, -1), 20);
+    CHECK_EQ(sum_evaluations.load() - sum_before, 1);
+    CHECK_EQ(scaled_evaluations.load() - scaled_before, 1);
+    SharedState::set(derived.a, 6);
+    CHECK_EQ(SharedState::get(derived.scaled, -1), 70);
+    CHECK_EQ(SharedState::get(derived.scaled, -1), 70);
+    CHECK_EQ(scaled_evaluations.load() - scaled_before, 2);
+
+    // query() і changes_since() віддають перераховане значення
+    const uint32_t since = SharedState::version();
+    SharedState::set(derived.b, 2);
+    int queried = -1;
+    SharedState::query("test/derived/", [&](const char* key, const ValueType& value, uint32_t) {
+        if (std::string(key) == "test/derived/scaled") queried = std::get<int>(value);
+    });
+    CHECK_EQ(queried, 80);
+    int changed = -1;
+    SharedState::changes_since(since, SharedState::epoch(), [&](const char* key, const ValueType& value, uint32_t) {
+        if (std::string(key) == "test/derived/sum") changed = std::get<int>(value);
+    });
+    CHECK_EQ(changed, 8);
+}
+
+TEST(derived_key_with_subscriber_is_evaluated_eagerly) {
+    ensure_state();
+    ensure_derived();
+    SharedState::set(derived.a, 1);
+    SharedState::set(derived.b, 1);
+    REQUIRE(SharedState::get(derived.scaled, -1) == 20);
+    const SubscriptionHandle sub = SharedState::subscribe(derived.scaled, [](const ValueType& value) {
+        scaled_notifications.fetch_add(1);
+        scaled_notified.store(std::get<int>(value));
+    });
+    REQUIRE(sub != 0);
+    const uint32_t before = scaled_notifications.load();
+
+    // Підписник отримує нове значення без жодного get()
+    SharedState::set(derived.a, 3);
+    CHECK_EQ(scaled_notifications.load() - before, 1);
+    CHECK_EQ(scaled_notified.load(), 40);
+    SharedState::unsubscribe(sub);
+}
+
+TEST(deadband_suppresses_small_changes) {
+    ensure_state();
+    const StateRef<float> temperature = SharedState::key(KEY_DEADBAND);
+    REQUIRE(SharedState::subscribe(temperature, [](const ValueType& value) {
+        deadband_notified.store(std::get<float>(value));
+        deadband_notifications.fetch_add(1);
+    }) != 0);
+
+    SharedState::set(temperature, 4.0f);
+    CHECK_EQ(deadband_notifications.load(), 1);
+    const uint32_t suppressed_before = SharedState::get_suppressed_count();
+    const uint32_t version_before = SharedState::version();
+
+    // Відлік - від останнього сповіщеного значення, не від попереднього запису
+    const float writes[] = {4.2f, 4.4f, 4.6f, 4.3f, 4.3f, 4.2f, 4.0f};
+    const uint32_t notified_after[] = {1, 1, 2, 2, 2, 2, 3};
+    for (size_t i = 0; i < sizeof(writes) / sizeof(writes[0]); ++i) {
+        SharedState::set(temperature, writes[i]);
+        // Значення в слоті оновлюється завжди, мертва зона стосується лише сповіщень
+        CHECK(SharedState::get(temperature, 0.0f) == writes[i]);
+        CHECK_EQ(deadband_notifications.load(), notified_after[i]);
+    }
+    CHECK(deadband_notified.load() == 4.0f);
+    // 4.2, 4.4, 4.3 (двічі), 4.2 - пропущено; повторний 4.3 не змінює й версію
+    CHECK_EQ(SharedState::get_suppressed_count() - suppressed_before, 5);
+    CHECK_EQ(SharedState::version() - version_before, 6);
+
+    // Ключ без мертвої зони: пропускається лише той самий запис
+    const StateRef<int> counter{SharedState::key("test/deadband/none")};
+    SharedState::set(counter, 1);
+    const uint32_t plain_before = SharedState::get_suppressed_count();
+    SharedState::set(counter, 1);
+    SharedState::set(counter, 2);
+    CHECK_EQ(SharedState::get_suppressed_count() - plain_before, 1);
+}
+
+TEST(query_prefix_stays_within_bounds) {
+    ensure_state();
+    // Назви навколо "cooling/" у порядку сортування: '/' < '2' < 'a'
+    const char* const names[] = {"q/cool/z", "q/cooling", "q/cooling/a", "q/cooling/b/c", "q/cooling2/x",
+                                 "q/coolinga", "q/cp"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        SharedState::set(StateRef<int>{SharedState::key(names[i])}, static_cast<int>(i));
+    }
+    // Ключ без значення у відповідь не потрапляє
+    SharedState::key("q/cooling/empty");
+
+    auto collect = [](const char* prefix) {
+        std::string joined;
+        const uint32_t version = SharedState::query(prefix, [&joined](const char* key, const ValueType&, uint32_t) {
+            joined += key;
+            joined += ';';
+        });
+        CHECK_EQ(version, SharedState::version());
+        return joined;
+    };
+    CHECK(collect("q/cooling/") == "q/cooling/a;q/cooling/b/c;");
+    CHECK(collect("q/cooling") == "q/cooling;q/cooling/a;q/cooling/b/c;q/cooling2/x;q/coolinga;");
+    CHECK(collect("q/cooling2/") == "q/cooling2/x;");
+    CHECK(collect("q/cooling/a") == "q/cooling/a;");
+    CHECK(collect("q/cooling/zz").empty());
+    CHECK(collect("q/d").empty());
+
+    // Версія у відповіді - та, що була при запиті значень
+    uint32_t seen_version = 0;
+    SharedState::query("q/cooling/a", [&seen_version](const char*, const ValueType& value, uint32_t version) {
+        CHECK_EQ(std::get<int>(value), 2);
+        seen_version = version;
+    });
+    SharedState::set(StateRef<int>{SharedState::key("q/cooling/a")}, 20);
+    uint32_t updated_version = 0;
+    SharedState::query("q/cooling/a", [&updated_version](const char*, const ValueType&, uint32_t version) {
+        updated_version = version;
+    });
+    CHECK(updated_version > seen_version);
+    CHECK_EQ(updated_version, SharedState::version());
+}
+
+// Останній у файлі: init() скидає таблицю слотів, хендли попередніх тестів недійсні
+TEST(persistent_values_survive_reinit) {
+    ensure_state();
+    const StateRef<float> number{SharedState::key("test/persist/number")};
+    const StateRef<std::string> text{SharedState::key("test/persist/text")};
+    REQUIRE(SharedState::set_persistent(number) == ESP_OK);
+    REQUIRE(SharedState::set_persistent(text) == ESP_OK);
+    SharedState::set(number, 3.25f);
+    SharedState::set(text, std::string("compressor"));
+    SharedState::set(text, std::string(""));
+    SharedState::set(text, std::string("defrost"));
+    CHECK_EQ(SharedState::flush(), ESP_OK);
+    const StatePersistStats stats = SharedState::get_persist_stats();
+    CHECK(stats.keys_written >= 2);
+
+    // Перезапуск: значення повертаються з NVS при повторному set_persistent()
+    const uint32_t old_epoch = SharedState::epoch();
+    SharedState::init();
+    const StateRef<float> restored_number{SharedState::key("test/persist/number")};
+    const StateRef<std::string> restored_text{SharedState::key("test/persist/text")};
+    CHECK(SharedState::get(restored_number, 0.0f) == 0.0f);
+    REQUIRE(SharedState::set_persistent(restored_number) == ESP_OK);
+    REQUIRE(SharedState::set_persistent(restored_text) == ESP_OK);
+    CHECK(SharedState::get(restored_number, 0.0f) == 3.25f);
+    CHECK(SharedState::get(restored_text, std::string()) == "defrost");
+
+    // Версії після init() - з нової історії: стара версія навіть за поточною
+    // не дає дельти, клієнт зі старою епохою отримує повний знімок
+    CHECK(SharedState::epoch() != old_epoch);
+    for (int i = 0; i < 10; ++i) SharedState::set(StateRef<int>{SharedState::key("test/epoch/filler")}, i);
+    REQUIRE(SharedState::version() >= 1);
+    size_t stale_delta = 0;
+    SharedState::changes_since(SharedState::version() - 1, old_epoch, [&](const char*, const ValueType&, uint32_t) { stale_delta++; });
+    size_t full = 0;
+    SharedState::changes_since(0, SharedState::epoch(), [&](const char*, const ValueType&, uint32_t) { full++; });
+    CHECK_EQ(stale_delta, full);
+    CHECK(full >= 3);
+    size_t delta = 0;
+    SharedState::changes_since(SharedState::version() - 1, SharedState::epoch(), [&](const char*, const ValueType&, uint32_t) { delta++; });
+    CHECK_EQ(delta, 1);
+}
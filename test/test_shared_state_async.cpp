@@ -0,0 +1,174 @@
+// SharedState, доставка StateDelivery::ASYNC: злиття проміжних значень,
+// вибір SYNC/ASYNC для кожної підписки, вартість set() при 0/10/50
+// ASYNC-підписниках проти стількох же SYNC.
+
+#include "shared_state.h"
+#include "host_test.h"
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace {
+    constexpr int BENCH_SETS = 20000;
+
+    // Тримає задачу-нотифікатор у callback свого ключа, доки тест не відпустить:
+    // записи тим часом лише позначають ключі брудними
+    struct NotifierGate {
+        StateRef<int> key;
+        std::atomic<bool> entered{false};
+        std::atomic<bool> open{true};
+
+        void hold() {
+            open.store(false);
+            SharedState::set(key, SharedState::get(key, 0) + 1);
+            wait_for([this] { return entered.load(); });
+        }
+
+        void release() {
+            open.store(true);
+            wait_for([this] { return !entered.load(); });
+        }
+    };
+    NotifierGate gate;
+
+    void ensure_state() {
+        static bool ready = false;
+        if (ready) return;
+        SharedState::init();
+        gate.key = StateRef<int>{SharedState::key("test/async/gate")};
+        SharedState::subscribe(gate.key, [](const ValueType&) {
+            gate.entered.store(true);
+            while (!gate.open.load()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            gate.entered.store(false);
+        }, StateDelivery::ASYNC);
+        ready = true;
+    }
+
+    std::atomic<uint32_t> coalesce_calls{0};
+    std::atomic<int> coalesce_last{0};
+
+    std::atomic<uint32_t> sync_calls{0};
+    std::atomic<uint32_t> sync_foreign_thread{0};
+    std::atomic<uint32_t> async_calls{0};
+    std::atomic<uint32_t> async_writer_thread{0};
+    std::atomic<int> async_last{0};
+    std::thread::id writer_thread;
+
+    std::atomic<uint32_t> bench_calls{0};
+
+    struct SetStats {
+        double ns_per_set;
+        double callbacks_per_set;
+    };
+
+    // Ключ з n підписниками; set() міряємо, поки нотифікатор стоїть
+    SetStats run_sets(const char* label, int subscribers, StateDelivery delivery) {
+        const std::string name = std::string("bench/async/") + (delivery == StateDelivery::ASYNC ? "async_" : "sync_") +
+                                 std::to_string(subscribers);
+        const StateRef<int> key{SharedState::key(name)};
+        for (int i = 0; i < subscribers; ++i) {
+            SharedState::subscribe(key, [](const ValueType&) { bench_calls.fetch_add(1); }, delivery);
+        }
+
+        gate.hold();
+        bench_calls.store(0);
+        const uint64_t started = host_now_ns();
+        for (int i = 1; i <= BENCH_SETS; ++i) {
+            SharedState::set(key, i);
+        }
+        const uint64_t elapsed = host_now_ns() - started;
+        gate.release();
+        // ASYNC: після відпускання - одна доставка останнього значення на підписника
+        wait_for([subscribers, delivery] {
+            return delivery == StateDelivery::SYNC || bench_calls.load() >= static_cast<uint32_t>(subscribers);
+        });
+
+        SetStats stats{static_cast<double>(elapsed) / BENCH_SETS,
+                       static_cast<double>(bench_calls.load()) / BENCH_SETS};
+        host_bench(label, "%d підписників: %.0f нс/set, %.4f викликів/set", subscribers, stats.ns_per_set,
+                   stats.callbacks_per_set);
+        return stats;
+    }
+}
+
+TEST(async_subscriber_receives_latest_value_once) {
+    ensure_state();
+    const StateRef<int> key{SharedState::key("test/async/coalesced")};
+    REQUIRE(SharedState::subscribe(key, [](const ValueType& value) {
+        coalesce_last.store(std::get<int>(value));
+        coalesce_calls.fetch_add(1);
+    }, StateDelivery::ASYNC) != 0);
+
+    // Поки нотифікатор зайнятий, 100 записів зливаються в один брудний ключ
+    gate.hold();
+    for (int i = 1; i <= 100; ++i) {
+        SharedState::set(key, i);
+    }
+    CHECK_EQ(coalesce_calls.load(), 0);
+    gate.release();
+    CHECK(wait_for([] { return coalesce_calls.load() >= 1; }));
+    // Друга доставка могла б прийти лише з новим set()
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK_EQ(coalesce_calls.load(), 1);
+    CHECK_EQ(coalesce_last.load(), 100);
+
+    // Значення без змін підписника не будить
+    SharedState::set(key, 100);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK_EQ(coalesce_calls.load(), 1);
+    SharedState::set(key, 101);
+    CHECK(wait_for([] { return coalesce_last.load() == 101; }));
+    CHECK_EQ(coalesce_calls.load(), 2);
+}
+
+TEST(sync_and_async_are_chosen_per_subscription) {
+    ensure_state();
+    const StateRef<int> key{SharedState::key("test/async/mixed")};
+    writer_thread = std::this_thread::get_id();
+    REQUIRE(SharedState::subscribe(key, [](const ValueType&) {
+        if (std::this_thread::get_id() != writer_thread) sync_foreign_thread.fetch_add(1);
+        sync_calls.fetch_add(1);
+    }) != 0);
+    REQUIRE(SharedState::subscribe(key, [](const ValueType& value) {
+        if (std::this_thread::get_id() == writer_thread) async_writer_thread.fetch_add(1);
+        async_last.store(std::get<int>(value));
+        async_calls.fetch_add(1);
+    }, StateDelivery::ASYNC) != 0);
+
+    // Нотифікатор стоїть: SYNC-підписник отримує кожен запис ще до повернення set(),
+    // ASYNC - нічого, і записувач його не чекає
+    constexpr int WRITES = 50;
+    gate.hold();
+    for (int i = 1; i <= WRITES; ++i) {
+        SharedState::set(key, i);
+        CHECK_EQ(sync_calls.load(), static_cast<uint32_t>(i));
+    }
+    CHECK_EQ(async_calls.load(), 0);
+    gate.release();
+
+    CHECK(wait_for([] { return async_last.load() == WRITES; }));
+    CHECK_EQ(async_calls.load(), 1);
+    CHECK_EQ(sync_foreign_thread.load(), 0);
+    CHECK_EQ(async_writer_thread.load(), 0);
+}
+
+TEST(set_cost_with_async_vs_sync_subscribers) {
+    ensure_state();
+    const int counts[] = {0, 10, 50};
+    SetStats async_stats[3];
+    SetStats sync_stats[3];
+    for (int i = 0; i < 3; ++i) {
+        async_stats[i] = run_sets("set() + ASYNC", counts[i], StateDelivery::ASYNC);
+        sync_stats[i] = run_sets("set() + SYNC", counts[i], StateDelivery::SYNC);
+    }
+
+    // ASYNC: set() лише позначає ключ і будить нотифікатор (це й різниця з 0),
+    // вартість не росте з кількістю підписників, а кожен отримує одне злите сповіщення
+    CHECK(async_stats[2].ns_per_set < async_stats[1].ns_per_set * 2.0);
+    CHECK(async_stats[2].callbacks_per_set <= 50.0 / BENCH_SETS);
+    // SYNC: кожен set() викликає всіх у потоці записувача
+    CHECK(sync_stats[2].callbacks_per_set == 50.0);
+    CHECK(sync_stats[2].ns_per_set > async_stats[2].ns_per_set);
+}
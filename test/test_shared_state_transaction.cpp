@@ -0,0 +1,168 @@
+// SharedState::Transaction: захоплення м'ютекса і виклики підписників на такт
+// керування (окремі set() проти одного commit()), узгодженість для спостерігача.
+
+#include "shared_state.h"
+#include "host_test.h"
+#include "host_freertos.h"
+#include <atomic>
+
+namespace {
+    constexpr int TICKS = 20000;
+
+    // Ключі такту CoolingControlModule: вибірка, рішення, статистика
+    constexpr StateKey<float> KEY_TEMP_CHAMBER{"bench/temperature/chamber"};
+    constexpr StateKey<float> KEY_AVG_TEMPERATURE{"bench/stats/avg_temperature"};
+    constexpr StateKey<bool> KEY_COMPRESSOR{"bench/compressor/state"};
+    constexpr StateKey<bool> KEY_FAN{"bench/fan/state"};
+    constexpr StateKey<int> KEY_CYCLES{"bench/stats/compressor_cycles"};
+    constexpr StateKey<int64_t> KEY_RUNTIME{"bench/stats/compressor_runtime"};
+
+    struct TickKeys {
+        StateRef<float> temp_chamber;
+        StateRef<float> avg_temperature;
+        StateRef<bool> compressor;
+        StateRef<bool> fan;
+        StateRef<int> cycles;
+        StateRef<int64_t> runtime;
+    };
+    TickKeys keys;
+
+    std::atomic<uint32_t> callbacks{0};
+    std::atomic<uint32_t> inconsistent{0};
+    // Пусків компресора, відомих спостерігачу
+    int expected_cycles = 0;
+
+    // Модель такту: компресор перемикається щотакту, пуск збільшує лічильник циклів
+    struct TickState {
+        int tick = 0;
+        float chamber = 4.0f;
+        float avg = 4.0f;
+        bool compressor = false;
+        int cycles = 0;
+        int64_t runtime = 0;
+
+        void advance() {
+            tick++;
+            chamber = 4.0f + static_cast<float>(tick % 50) * 0.05f;
+            avg = avg * 0.9f + chamber * 0.1f;
+            compressor = !compressor;
+            if (compressor) cycles++;
+            runtime += 1000;
+        }
+    };
+
+    void setup() {
+        static bool ready = false;
+        if (ready) return;
+        SharedState::init();
+        keys.temp_chamber = SharedState::key(KEY_TEMP_CHAMBER);
+        keys.avg_temperature = SharedState::key(KEY_AVG_TEMPERATURE);
+        keys.compressor = SharedState::key(KEY_COMPRESSOR);
+        keys.fan = SharedState::key(KEY_FAN);
+        keys.cycles = SharedState::key(KEY_CYCLES);
+        keys.runtime = SharedState::key(KEY_RUNTIME);
+
+        auto count = [](const ValueType&) { callbacks.fetch_add(1); };
+        SharedState::subscribe(keys.temp_chamber, count);
+        SharedState::subscribe(keys.avg_temperature, count);
+        SharedState::subscribe(keys.fan, count);
+        SharedState::subscribe(keys.cycles, count);
+        SharedState::subscribe(keys.runtime, count);
+        // Спостерігач пуску читає лічильник циклів: він має вже врахувати цей пуск
+        SharedState::subscribe(keys.compressor, [](const ValueType& value) {
+            callbacks.fetch_add(1);
+            if (std::get<bool>(value)) {
+                expected_cycles++;
+                if (SharedState::get(keys.cycles, -1) != expected_cycles) inconsistent.fetch_add(1);
+            }
+        });
+        ready = true;
+    }
+
+    struct TickStats {
+        double locks_per_tick;
+        double callbacks_per_tick;
+        double ns_per_tick;
+        uint32_t inconsistent;
+    };
+
+    template <typename Tick>
+    TickStats run_ticks(const char* label, Tick tick) {
+        // Початковий стан однаковий для обох варіантів
+        TickState state;
+        SharedState::Transaction reset;
+        reset.set(keys.compressor, false).set(keys.cycles, 0).set(keys.runtime, int64_t{0});
+        reset.commit();
+        expected_cycles = 0;
+        callbacks.store(0);
+        inconsistent.store(0);
+
+        const uint64_t locks_before = host_mutex_takes();
+        const uint64_t started = host_now_ns();
+        for (int i = 0; i < TICKS; ++i) {
+            state.advance();
+            tick(state);
+        }
+        const uint64_t elapsed = host_now_ns() - started;
+        const uint64_t locks = host_mutex_takes() - locks_before;
+
+        TickStats stats{static_cast<double>(locks) / TICKS, static_cast<double>(callbacks.load()) / TICKS,
+                        static_cast<double>(elapsed) / TICKS, inconsistent.load()};
+        host_bench(label, "%.2f захоплень м'ютекса/такт, %.2f викликів підписників/такт, %.0f нс/такт, неузгоджених %u",
+                   stats.locks_per_tick, stats.callbacks_per_tick, stats.ns_per_tick, stats.inconsistent);
+        return stats;
+    }
+}
+
+TEST(control_tick_individual_sets_vs_transaction) {
+    setup();
+
+    // Як до Transaction: кожен ключ окремим set(), статистика - ще раз наприкінці такту
+    const TickStats individual = run_ticks("tick: окремі set()", [](const TickState& s) {
+        SharedState::set(keys.temp_chamber, s.chamber);
+        SharedState::set(keys.avg_temperature, s.avg);
+        SharedState::set(keys.compressor, s.compressor);
+        SharedState::set(keys.fan, s.compressor);
+        SharedState::set(keys.cycles, s.cycles);
+        SharedState::set(keys.runtime, s.runtime - 500);
+        SharedState::set(keys.runtime, s.runtime);
+    });
+
+    const TickStats batched = run_ticks("tick: Transaction", [](const TickState& s) {
+        SharedState::Transaction tick;
+        tick.set(keys.temp_chamber, s.chamber)
+            .set(keys.avg_temperature, s.avg)
+            .set(keys.compressor, s.compressor)
+            .set(keys.fan, s.compressor)
+            .set(keys.cycles, s.cycles)
+            .set(keys.runtime, s.runtime - 500)
+            .set(keys.runtime, s.runtime);
+        tick.commit();
+    });
+
+    // Окремі set(): спостерігач пуску бачить лічильник циклів до оновлення
+    CHECK(individual.inconsistent > 0);
+    CHECK_EQ(batched.inconsistent, 0);
+    // Одне захоплення на commit(); фонова задача збереження може додати поодинокі
+    CHECK(batched.locks_per_tick < 1.01);
+    CHECK(individual.locks_per_tick >= 7.0);
+    // Повторний запис runtime зливається: на один виклик менше
+    CHECK(batched.callbacks_per_tick < individual.callbacks_per_tick);
+}
+
+TEST(transaction_overflow_applies_nothing) {
+    setup();
+    const int cycles_before = SharedState::get(keys.cycles, -1);
+    SharedState::Transaction tx;
+    for (size_t i = 0; i <= SharedState::Transaction::MAX_WRITES; ++i) {
+        tx.set(StateRef<int>{SharedState::key("test/tx/overflow_" + std::to_string(i))}, 1);
+    }
+    tx.set(keys.cycles, cycles_before + 100);
+    CHECK_EQ(tx.commit(), ESP_ERR_NO_MEM);
+    CHECK_EQ(SharedState::get(keys.cycles, -1), cycles_before);
+    CHECK_EQ(SharedState::get("test/tx/overflow_0", -1), -1);
+    // Після відмови транзакція порожня і придатна до повторного використання
+    tx.set(keys.cycles, cycles_before + 1);
+    CHECK_EQ(tx.commit(), ESP_OK);
+    CHECK_EQ(SharedState::get(keys.cycles, -1), cycles_before + 1);
+}